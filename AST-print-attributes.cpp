@@ -24,6 +24,7 @@ string A_exp_::attributes_for_printing()
 {
 	return (AST_node_::attributes_for_printing()
 		+ "my_reg() = " + str(result_reg()) + "; "
+		+ (has_constant_value() ? "constant_value() = " + str(constant_value()) + "; " : "")
 //        + "my_fp() = " + str(this->result_fp_plus()) + "; "
 		// concatenate any other EXP attributes here for printing
 		);
@@ -1,5 +1,6 @@
 #include "AST.h"
 #include "errormsg.h"
+#include "phases.h"
 #include <logic.h>
 
 // Abstract Syntax for Tiger
@@ -18,6 +19,7 @@
 function_type_info::function_type_info(string the_unique_id, Ty_ty the_return_type,  HaverfordCS::list<Ty_ty> the_param_types, int the_fp, int the_frame) : unique_id(the_unique_id), return_type(the_return_type), param_types(the_param_types), fp(the_fp), frame(the_frame) {};
 variable_type_info::variable_type_info(Ty_ty the_type, int the_fp_plus, int the_frames) : type(the_type), fp_plus(the_fp_plus), frames(the_frames) {};
 
+// Built once, before main starts, and never changed after that, so all the threads of tiger --batch -j can share it
 tiger_standard_library data_shell =
         tiger_standard_library({
                std::pair(to_Symbol("ord"), function_type_info("", Ty_Int(), HaverfordCS::ez_list(Ty_String()), 0, 0)),
@@ -177,7 +179,11 @@ void AST_example_let()
 	EM_debug(str(twenty));
 
 	EM_debug("Now,  here's the HERA code we get at the moment for that:");
-	EM_debug(twenty->HERA_code());
+	HERA_insns twenty_code;
+	twenty->HERA_code(twenty_code);
+	HERA_emitter twenty_text;
+	HERA_write(twenty_code, twenty_text);
+	EM_debug(twenty_text.as_string());
 
 	EM_debug("Here's the full example AST, printed with to_String");
 	EM_debug(str(local_AST_root));
@@ -248,8 +254,16 @@ int main()
 				  
 // Now, the functions for the actual AST classes...
 
+static void destroy_AST_node(void *n)
+{
+	static_cast<AST_node_ *>(n)->~AST_node_();
+}
+
 AST_node_::AST_node_(A_pos pos) : stored_pos(pos)  // concise initialization of "pos" data field
 {
+	// if we were allocated in an arena, run the destructor when it's released (doesn't apply to nodes on the stack)
+	if (ASTArena::current()) ASTArena::current()->destroy_at_release(this, destroy_AST_node);
+	AST_nodes_in_this_thread++;
 }
 
 AST_node_::~AST_node_()
@@ -262,7 +276,9 @@ A_root_::A_root_(A_exp main_exp) : AST_node_(main_exp->pos()), main_expr(main_ex
 	// HOWEVER, the type of "this" is still AST_Node_, until the end of the constructor when it's a full-formed A_root_.
 	//          Thus, we'll write the code that would have been in that function:
 	this->stored_parent = 0;
+	phase_start("parent pointers");
 	main_exp->set_parent_pointers_for_me_and_my_descendants(this);
+	phase_start("parse");
 }
 
 
@@ -13,9 +13,9 @@
 //  to these nodes, in part because we need to connect with
 //  bison, and need to have a naked pointer (rather than a
 //  class with a constructor) in the %union statement, and
-//  we make to attempt to free up memory (this is left to
-//  the user of the class or anyone working on conservative
-//  garbage collection in C++).
+//  we make no attempt to free individual nodes. Instead,
+//  nodes are allocated in the current ASTArena (if any),
+//  which frees them all at once (see ASTArena.h).
 //
 // The hierarchy is given below.  All leaf classes can be
 //  allocated using the function names given by appel (see AST_appel.h).
@@ -166,6 +166,14 @@ typedef Position A_pos;
 #include <hc_list.h>	// gets files from /home/courses/include folder, thanks to -I flag on compiler
 #include <hc_list_helpers.h>
 #include "ST-2024.h"
+#include "ST-hashed.h"
+#include <map>
+#include <vector>
+#include "HERA_emitter.h"
+#include "HERA_IR.h"
+#include "attribute.h"
+struct IR_program;  // see IR.h
+#include "ASTArena.h"
 
 struct function_type_info {
 public:
@@ -189,7 +197,7 @@ public:
 };
 // make an abbreviation "ST_example" for a symbol table with the example sym info
 //   (also would be in a .h, usually)
-typedef ST<function_type_info> tiger_standard_library;
+typedef ST_hashed<function_type_info> tiger_standard_library;
 extern tiger_standard_library data_shell;
 
 struct variable_type_info {
@@ -210,9 +218,33 @@ public:
 };
 // make an abbreviation "ST_example" for a symbol table with the example sym info
 //   (also would be in a .h, usually)
-typedef ST<variable_type_info> local_variable_scope;
+typedef ST_hashed<variable_type_info> local_variable_scope;
 extern local_variable_scope local_data_shell;
 
+// What a name in an A_simpleVar_ or A_callExp_ refers to: the node whose symbol table declares it
+//  (the A_root_, for the standard library), and what that table says about it.
+//  Each use finds its binding once (see resolve_variable and resolve_function), and code generation
+//  and type checking just look at the binding attribute after that.
+class AST_node_;
+struct variable_binding {
+    variable_binding() : scope(0), info(nullptr, 0, 0) {}
+    variable_binding(AST_node_ *scope, variable_type_info info) : scope(scope), info(info) {}
+    AST_node_ *scope;
+    variable_type_info info;  // type, fp_plus (its place in its frame), and frames (how deep that frame is)
+
+    string __repr__() const { Ty_ty type = info.type; return "type: " + str(type) + "  fp_plus:" + str(info.fp_plus) + "  frames:" + str(info.frames); }
+    string __str__() const { return this->__repr__(); }
+};
+struct function_binding {
+    function_binding() : scope(0), info("", nullptr, HaverfordCS::ez_list(Ty_Nil()), 0, 0) {}
+    function_binding(AST_node_ *scope, function_type_info info) : scope(scope), info(info) {}
+    AST_node_ *scope;
+    function_type_info info;  // unique_id (the rest of its label), types, static link (fp), and frame
+
+    string __repr__() const { return "unique_id: " + info.unique_id + "  fp:" + str(info.fp) + "  frame:" + str(info.frame); }
+    string __str__() const { return this->__repr__(); }
+};
+
 
 void AST_examples();  // Examples, to help understand what't going on here ... see AST.cc
 
@@ -241,6 +273,7 @@ typedef class A_efieldList_ *A_efieldList;
 // #include "AST_attribute_types.h"   // This is for the old (non-lazy) attribute system
 
 extern bool print_ASTs_with_attributes;  // defaults to false; can be overridden in main with "-A" option
+void reset_unique_numbers();  // in result_reg.cpp; start label numbering etc. over, for the next program
 
 
 class AST_node_ {  // abstract class with some common data
@@ -248,6 +281,10 @@ public:
 	AST_node_(A_pos pos);
 	virtual ~AST_node_();
 
+	// nodes live in the current ASTArena, if there is one
+	static void *operator new(size_t size) { return ASTArena::allocate_in_current(size); }
+	static void operator delete(void *p)   { ASTArena::deallocate(p); }
+
 	A_pos pos() { return stored_pos; }
 
 	// Each node will know its parent, except the root node (on which this is an error):
@@ -270,14 +307,14 @@ public:
 	
 	// And now, the attributes that exist in ALL kinds of AST nodes.
 	//  See Design_Documents/AST_Attributes.txt for details.
-    virtual string HERA_data();
-	virtual string HERA_code();  // defaults to a warning, with HERA code that would error if compiled; could be "=0" in final compiler
+    virtual void HERA_data(HERA_emitter &out);
+	virtual void HERA_code(HERA_insns &out);  // defaults to a warning, with HERA code that would error if compiled; could be "=0" in final compiler
 
 	int height();  // example we'll play with in class, not actually needed to compile
 	virtual int compute_height();  // just for an example, not needed to compile
 	int depth();   // example we'll play with in class, not actually needed to compile
 	virtual int compute_depth();   // just for an example, not needed to compile
-    virtual Ty_ty typecheck();
+    Ty_ty typecheck() { return stored_typecheck.get(); }  // the type of this expression, see typecheck.cpp
     virtual string break_label() { if (branch_label_post() != "") return branch_label_post(); else { if (parent() != 0 ) {return parent()->break_label(); } else { EM_error("Oops, break point could not be associated with a while loop", true); return "Label_Error";};} }
     virtual string branch_label_post() { return ""; };
     virtual bool skip_my_symbol_table() {return false;}
@@ -294,60 +331,33 @@ public:
         return -1;
     }
     virtual int result_where_stack(){
-        if (this->stored_where_stack < 0) this->stored_where_stack = this->init_result_where_stack();
-        return this->stored_where_stack;
+        return stored_result_where_stack.get();
     }
 
     virtual Symbol my_var_from_var() {return nullptr;}
 
     virtual Symbol my_for_loop(){ return parent()->my_for_loop();};
 
-    virtual function_type_info find_local_functions(Symbol name) {
-        try {
-            function_type_info my_func = lookup(name, this->my_local_functions());
-            return my_func;
-        } catch(const tiger_standard_library::undefined_symbol &missing) {
-                return parent()->find_local_functions(name);
-        }
-    }
-
-    virtual int find_local_variables_fp(Symbol name, int ceiling = 1000000000) {
-        try {
-            variable_type_info my_var = lookup(name, this->my_local_variables());
-
-            if (my_var.fp_plus <= ceiling){
-                return my_var.fp_plus;
-            } else {
-                return parent()->find_local_variables_fp(name, ceiling);
+    // Find what "name" means here, in one trip up through the enclosing scopes
+    //  (A_callExp_ and A_simpleVar_ keep the answer in their binding attributes).
+    //  Most nodes on the way don't have the name, so check with is_name_there rather than catching
+    //  undefined_symbol, which is much slower (and made long A_seqExp_'s take quadratic time)
+    virtual function_binding resolve_function(Symbol name) {
+        tiger_standard_library mine = this->my_local_functions();
+        if (is_name_there(name, mine)) return function_binding(this, lookup(name, mine));
+        return parent()->resolve_function(name);
+    }
+
+    // only variables at or below "ceiling" in their frame count, i.e., ones declared before the use
+    virtual variable_binding resolve_variable(Symbol name, int ceiling = 1000000000) {
+        if (!this->skip_my_symbol_table()) {
+            local_variable_scope mine = this->my_local_variables();
+            if (is_name_there(name, mine)) {
+                variable_type_info my_var = lookup(name, mine);
+                if (my_var.fp_plus <= ceiling) return variable_binding(this, my_var);
             }
-        } catch(const local_variable_scope::undefined_symbol &missing) {
-            return parent()->find_local_variables_fp(name, ceiling);
-        }
-    }
-
-    virtual int find_local_variables_frames(Symbol name, int ceiling = 1000000000) {
-        try {
-            variable_type_info my_var = lookup(name, this->my_local_variables());
-
-            if (my_var.fp_plus <= ceiling){
-                return my_var.frames;
-            } else {
-                return parent()->find_local_variables_frames(name, ceiling);
-            }
-        } catch(const local_variable_scope::undefined_symbol &missing) {
-            return parent()->find_local_variables_frames(name, ceiling);
-        }
-    }
-
-    virtual variable_type_info find_local_variables(Symbol name) {
-        if (this->skip_my_symbol_table()) return parent()->find_local_variables(name);
-        try {
-            variable_type_info my_var = lookup(name, this->my_local_variables());
-
-            return my_var;
-        } catch(const local_variable_scope::undefined_symbol &missing) {
-            return parent()->find_local_variables(name);
         }
+        return parent()->resolve_variable(name, ceiling);
     }
 
     virtual Ty_ty implicit_type_init(Symbol name) {
@@ -363,6 +373,7 @@ public:
     virtual local_variable_scope my_local_variables(){
         if (!is_vars_init) {
             vars_data_shell = this->init_local_variable();
+            is_vars_init = true;
         }
         return vars_data_shell;
     }
@@ -370,22 +381,14 @@ public:
     virtual tiger_standard_library my_local_functions(){
         if (!is_funcs_init) {
             funcs_data_shell = this->init_local_funcs();
+            is_funcs_init = true;
         }
         return funcs_data_shell;
     }
 
     virtual string my_local_variables_print(){
-        if (!is_vars_init) {
-            vars_data_shell = this->init_local_variable();
-        }
-        return str(vars_data_shell);
-    }
-
-    virtual Ty_ty my_result_type(){
-        if (!is_type_init) {
-            my_type = this->init_my_type();
-        }
-        return my_type;
+        local_variable_scope vars = this->my_local_variables();
+        return str(vars);
     }
 
     virtual void create_variable(Symbol name, Ty_ty type, int fp_plus, int frames) {
@@ -408,8 +411,7 @@ public:
         return -1;
     }
     virtual int result_frames(){
-        if (this->stored_frames < 0) this->stored_frames = this->init_result_frames();
-        return this->stored_frames;
+        return stored_result_frames.get();
     }
 
     virtual int my_unique_num();
@@ -438,9 +440,8 @@ private:
 	virtual AST_node_ *get_parent_without_checking();	// NOT FOR GENERAL USE: get the parent node, either before or after the 'set all parent nodes' pass, but note it will be incorrect if done before (this is usually just done for assertions)
 	A_pos stored_pos;
 
-    bool is_type_init = false;
-    Ty_ty init_my_type();
-    Ty_ty my_type = Ty_Error();
+    virtual Ty_ty init_typecheck();
+    AST_ATTRIBUTE(Ty_ty, typecheck);
 
     bool is_vars_init = false;
     local_variable_scope init_local_variable();
@@ -451,13 +452,10 @@ private:
     tiger_standard_library funcs_data_shell = tiger_standard_library();
 
     int init_result_frames();
-    int stored_frames = -1;
-
-    int init_result_fp_plus();
-    int stored_fp_plus = -1;
+    AST_ATTRIBUTE(int, result_frames);
 
     int init_result_where_stack();
-    int stored_where_stack = -1;
+    AST_ATTRIBUTE(int, result_where_stack);
 
 
 };
@@ -468,38 +466,47 @@ public:
 
 	// Attributes for all expressions: result_reg() is the register number to use;
 	//  in the first call, it is defined by the init_result_reg for the class,
-	//  and then reused each time we ask for it.
+	//  and then reused each time we ask for it (see attribute.h).
+	//  Subclasses just override init_result_reg, init_result_fp_plus, etc.
 	int    result_reg() {
-		if (this->stored_result_reg < 0) this->stored_result_reg = this->init_result_reg();
-		return stored_result_reg;
+		return stored_result_reg.get();
 	}
-	string result_reg_s() { // return in string form, e.g. "R2"
-        return "R" + std::to_string(this->result_reg());
+	HERA_operand result_register() { // as an operand, e.g. R2
+        return HERA_register(this->result_reg());
     }
 
     string result_dlabel() {
-        if (stored_dlabel == "") this->stored_dlabel = this->init_result_dlabel();
-        return stored_dlabel;
+        return stored_result_dlabel.get();
     }
     bool is_dlabel(){
-        if (stored_dlabel == "") return false;
-        return true;
+        return stored_result_dlabel.ready();
     }
     int regular_fp_plus(){
         return parent()->result_fp_plus();
     }
     virtual int result_fp_plus(){
-        if (this->stored_fp_plus < 0) this->stored_fp_plus = this->init_result_fp_plus();
-        return this->stored_fp_plus;
+        return stored_result_fp_plus.get();
     }
     virtual int result_frames(){
-        if (this->stored_frames < 0) this->stored_frames = this->init_result_frames();
-        return this->stored_frames;
+        return stored_result_frames.get();
     }
 
-    virtual Ty_ty typecheck(){
-        return Ty_Nil();
+    // Constant folding (see constant_fold.cpp): has_constant_value() is true if the value of this
+    //  expression is known at compile time (and nothing else has to happen to get it, e.g. a call),
+    //  in which case constant_value() is that value, as HERA would compute it (16-bit, signed).
+    bool has_constant_value() {
+        if (this->stored_has_constant_value < 0) this->stored_has_constant_value = this->init_has_constant_value(this->stored_constant_value);
+        return stored_has_constant_value;
     }
+    int constant_value() {
+        precondition(has_constant_value());
+        return stored_constant_value;
+    }
+
+    // Jumping code, for the tests of if and while (see HERA_code.cpp): go to "label" if this
+    //  expression is true (nonzero) and "when" is true, or false and "when" is false, or else on to
+    //  what comes next, without putting a 0 or 1 in a register if it doesn't have to
+    virtual void HERA_branch(HERA_insns &out, const string &label, bool when);
 
 
 	// we'll need to print the register number attribute for exp's
@@ -507,19 +514,22 @@ public:
 
 private:
     virtual int init_result_reg();
-    int stored_result_reg = -1;  // Initialize to -1 to be sure it gets replaced by "if" in result_reg() above
-    int stored_fp_plus = -1;
+    AST_ATTRIBUTE(int, result_reg);
+
+    virtual Ty_ty init_typecheck() { return Ty_Nil(); }
+
+    virtual bool init_has_constant_value(int &value) { return false; }  // sets value if it returns true
+    int stored_has_constant_value = -1;
+    int stored_constant_value = 0;
 
     virtual string init_result_dlabel();
-    string stored_dlabel = "";
+    AST_ATTRIBUTE(string, result_dlabel);
 
     virtual int init_result_fp_plus();
-    virtual int init_regular_fp_plus();
-    int stored_regular_fp_plus = -1;
-    int stored_result_fp_plus = -1;
+    AST_ATTRIBUTE(int, result_fp_plus);
 
     virtual int init_result_frames();
-    int stored_frames = -1;
+    AST_ATTRIBUTE(int, result_frames);
 
     local_variable_scope vars_data_shell = local_variable_scope();
 };
@@ -529,7 +539,7 @@ public:
 	A_root_(A_exp main_exp);
 	A_exp *main();
 
-	string HERA_code();
+	void lower_to_IR(IR_program &program);  // in HERA_code.cpp; see IR.h
 	AST_node_ *parent();	// We should never call this
 	string print_rep(int indent, bool with_attributes);
 
@@ -538,8 +548,9 @@ public:
     }
 
     int result_fp_plus() {
-        return -1;
+        return this->spill_slots() - 1;  // main's variables go after its spill slots, if any
     }
+    int spill_slots();  // see layout_frames.cpp
 
     int result_frames() {
         return 0;
@@ -559,58 +570,24 @@ public:
 
     virtual Symbol my_for_loop(){ return to_Symbol("!noforloop");};
 
-    virtual Ty_ty typecheck();
+    virtual Ty_ty init_typecheck();
 
-    virtual variable_type_info find_local_variables(Symbol name) {
+    virtual variable_binding resolve_variable(Symbol name, int ceiling = 10000000) {
         try {
             variable_type_info my_var = lookup(name, this->vars_data_shell);
-
-            return my_var;
+            if (this->result_fp_plus() <= ceiling) return variable_binding(this, my_var);
         } catch(const local_variable_scope::undefined_symbol &missing) {
-            EM_error("Oops, the variable "+ str(name) +" was not found", true);
-            return variable_type_info(nullptr, -1, -1);
         }
+        EM_error("Oops, the variable "+ str(name) +" was not found", true);
+        return variable_binding();
     }
 
-    virtual int find_local_variables_fp(Symbol name, int ceiling = 10000000) {
+    virtual function_binding resolve_function(Symbol name) {
         try {
-            variable_type_info my_var = lookup(name, this->vars_data_shell);
-
-            if (this->result_fp_plus() <= ceiling){
-                return my_var.fp_plus;
-            } else {
-                EM_error("Oops, the variable "+ str(name) +" was not found", true);
-                return 0;
-            }
-        } catch(const local_variable_scope::undefined_symbol &missing) {
-            EM_error("Oops, the variable "+ str(name) +" was not found", true);
-            return 0;
-        }
-    }
-
-    virtual int find_local_variables_frames(Symbol name, int ceiling = 10000000) {
-        try {
-            variable_type_info my_var = lookup(name, this->vars_data_shell);
-
-            if (this->result_fp_plus() <= ceiling){
-                return my_var.frames;
-            } else {
-                EM_error("Oops, the variable "+ str(name) +" was not found", true);
-                return 0;
-            }
-        } catch(const local_variable_scope::undefined_symbol &missing) {
-            EM_error("Oops, the variable "+ str(name) +" was not found", true);
-            return 0;
-        }
-    }
-
-    virtual function_type_info find_local_functions(Symbol name) {
-        try {
-            function_type_info my_func = lookup(name, data_shell);
-            return my_func;
+            return function_binding(this, lookup(name, data_shell));
         } catch(const tiger_standard_library::undefined_symbol &missing) {
                EM_error("Oops, the function "+ str(name) +" was not found in scope", true);
-               return function_type_info("", nullptr, HaverfordCS::ez_list(Ty_Nil()), 0, 0);
+               return function_binding();
         }
     }
 
@@ -642,24 +619,17 @@ public:
 	virtual string print_rep(int indent, bool with_attributes);
 
     virtual bool null_input() {return true;}
-    int    result_reg() {
-        if (this->stored_result_reg < 0) this->stored_result_reg = this->init_result_reg();
-        return stored_result_reg;
-    }
-    string result_reg_s() { // return in string form, e.g. "R2"
-        return "R" + std::to_string(this->result_reg());
-    }
 
-    virtual string HERA_code(){return "";}
-    virtual string HERA_data(){return "";}
+    virtual void HERA_code(HERA_insns &out){}
+    virtual void HERA_data(HERA_emitter &out){}
 
+private:
     /* this could really screw up function type checking */
-    virtual Ty_ty typecheck(){
+    virtual Ty_ty init_typecheck(){
         return Ty_Void();
     }
-private:
+
     virtual int init_result_reg();
-    int stored_result_reg = -1;
 };
 
 
@@ -668,21 +638,13 @@ public:
 	A_boolExp_(A_pos pos, bool b);
 	virtual string print_rep(int indent, bool with_attributes);
 
-    int    result_reg() {
-        if (this->stored_result_reg < 0) this->stored_result_reg = this->init_result_reg();
-        return stored_result_reg;
-    }
-    string result_reg_s() { // return in string form, e.g. "R2"
-        return "R" + std::to_string(this->result_reg());
-    }
+    virtual void HERA_data(HERA_emitter &out);
+    virtual void HERA_code(HERA_insns &out);
 
-    virtual string HERA_data();
-    virtual string HERA_code();
-
-    virtual Ty_ty typecheck();
+    virtual Ty_ty init_typecheck();
 private:
     virtual int init_result_reg();
-    int stored_result_reg = -1;
+    virtual bool init_has_constant_value(int &value);
     bool value;
 };
 
@@ -691,22 +653,13 @@ public:
 	A_intExp_(A_pos pos, int i);
 	virtual string print_rep(int indent, bool with_attributes);
 
-    int    result_reg() {
-        if (this->stored_result_reg < 0) this->stored_result_reg = this->init_result_reg();
-        return stored_result_reg;
-    }
-    string result_reg_s() { // return in string form, e.g. "R2"
-        return "R" + std::to_string(this->result_reg());
-    }
-
+    virtual void HERA_data(HERA_emitter &out);
+	virtual void HERA_code(HERA_insns &out);
 
-    virtual string HERA_data();
-	virtual string HERA_code();
-
-    virtual Ty_ty typecheck();
+    virtual Ty_ty init_typecheck();
 private:
     virtual int init_result_reg();
-    int stored_result_reg = -1;
+    virtual bool init_has_constant_value(int &value);
 	int value;
 };
 
@@ -715,34 +668,15 @@ public:
 	A_stringExp_(A_pos pos, String s);
 	virtual string print_rep(int indent, bool with_attributes);
 
-    int    result_reg() {
-        if (this->stored_result_reg < 0) this->stored_result_reg = this->init_result_reg();
-        return stored_result_reg;
-    }
-    string result_reg_s() { // return in string form, e.g. "R2"
-        return "R" + std::to_string(this->result_reg());
-    }
-
-    string result_dlabel() {
-        if (stored_dlabel == "") this->stored_dlabel = this->init_result_dlabel();
-        return stored_dlabel;
-    }
-    bool is_dlabel(){
-        if (stored_dlabel == "") return false;
-        return true;
-    }
-
-    virtual string HERA_data();
-    virtual string HERA_code();
+    virtual void HERA_data(HERA_emitter &out);
+    virtual void HERA_code(HERA_insns &out);
 
-    virtual Ty_ty typecheck();
+    virtual Ty_ty init_typecheck();
 private:
     virtual string init_result_dlabel();
     virtual int init_result_reg();
 
 	String value;
-    string stored_dlabel = "";
-    int stored_result_reg = -1;
 };
 
 class A_recordExp_ : public A_literalExp_ {
@@ -771,29 +705,15 @@ public:
 	virtual string print_rep(int indent, bool with_attributes);
     void set_parent_pointers_for_me_and_my_descendants(AST_node_ *my_parent);
 
-    int result_reg() {
-        if (this->stored_result_reg < 0) this->stored_result_reg = this->init_result_reg();
-        return stored_result_reg;
-    }
-    string result_reg_s() { // return in string form, e.g. "R2"
-        return "R" + std::to_string(this->result_reg());
-    }
-    virtual int result_fp_plus(){
-        if (this->stored_fp_plus < 0) this->stored_fp_plus = this->init_result_fp_plus();
-        return this->stored_fp_plus;
-    }
+    virtual void HERA_data(HERA_emitter &out);
+    virtual void HERA_code(HERA_insns &out);
 
-    virtual string HERA_data();
-    virtual string HERA_code();
-
-    virtual Ty_ty typecheck();
+    virtual Ty_ty init_typecheck();
 
 private:
     virtual int init_result_reg();
-    int stored_result_reg = -1;
 	A_var _var;
     int init_result_fp_plus();
-    int stored_fp_plus = -1;
 };
 
 typedef enum {A_plusOp, A_minusOp, A_timesOp, A_divideOp,
@@ -811,31 +731,21 @@ public:
     A_arithExp_(A_pos pos, A_oper oper, A_exp left, A_exp right);
 	virtual string print_rep(int indent, bool with_attributes);
 
-    int    result_reg() {
-        if (this->stored_result_reg < 0) this->stored_result_reg = this->init_result_reg();
-        return stored_result_reg;
-    }
-    string result_reg_s() { // return in string form, e.g. "R2"
-        return "R" + std::to_string(this->result_reg());
-    }
-    int result_fp_plus(){
-        if (this->stored_fp_plus < 0) this->stored_fp_plus = this->init_result_fp_plus();
-        return this->stored_fp_plus;
-    }
     virtual int init_result_reg();
 
-    virtual string HERA_data();
-    virtual string HERA_code();
+    virtual void HERA_data(HERA_emitter &out);
+    virtual void HERA_code(HERA_insns &out);
 
-    virtual Ty_ty typecheck();
+    virtual Ty_ty init_typecheck();
 
 	void set_parent_pointers_for_me_and_my_descendants(AST_node_ *my_parent);
 	virtual int compute_height();  // just for an example, not needed to compile
+
+    A_exp identity_operand();  // see constant_fold.cpp
 private:
-    int stored_fp_plus = -1;
     int init_result_fp_plus();
 
-    int stored_result_reg = -1;
+    virtual bool init_has_constant_value(int &value);
 
 	A_oper _oper;
 	A_exp _left;
@@ -847,42 +757,40 @@ public:
     A_condExp_(A_pos pos, A_oper oper, A_exp left, A_exp right);
     virtual string print_rep(int indent, bool with_attributes);
 
-    int    result_reg() {
-        if (this->stored_result_reg < 0) this->stored_result_reg = this->init_result_reg();
-        return stored_result_reg;
-    }
-    string result_reg_s() { // return in string form, e.g. "R2"
-        return "R" + std::to_string(this->result_reg());
-    }
-    void do_init(){
-        if (this->stored_true_label == "" && this->stored_end_label == ""){
-            int results = this->init_labels();
-            this->stored_true_label = "my_cond_true_"+str(results);
-            this->stored_end_label = "my_cond_end_"+str(results);
-        }
-    }
     string branch_label_true() {
-        do_init();
-        return stored_true_label;
+        return "my_cond_true_"+str(stored_label_number.get());
     }
     string branch_label_end() {
-        do_init();
-        return stored_end_label;
+        return "my_cond_end_"+str(stored_label_number.get());
+    }
+    string branch_label_loop() {  // for comparing strings (see HERA_code.cpp)
+        return "my_cond_loop_"+str(stored_label_number.get());
+    }
+    string branch_label_skip() {
+        return "my_cond_skip_"+str(stored_label_number.get());
     }
 
-    virtual string HERA_data();
-    virtual string HERA_code();
+    virtual void HERA_data(HERA_emitter &out);
+    virtual void HERA_code(HERA_insns &out);
+    virtual void HERA_branch(HERA_insns &out, const string &label, bool when);
 
-    virtual Ty_ty typecheck();
+    virtual Ty_ty init_typecheck();
 
     void set_parent_pointers_for_me_and_my_descendants(AST_node_ *my_parent);
     virtual int compute_height();  // just for an example, not needed to compile
 private:
+    void HERA_compare(HERA_insns &out);  // the CMP that HERA_math_op's branch goes by
+    void HERA_string_operands(HERA_insns &out, HERA_operand &left, HERA_operand &right);
+    // = or <> that might be on strings; result_reg can't ask typecheck (the frame layout needs result_reg),
+    //  but a constant is never a string
+    bool might_compare_strings() {
+        return (_oper == A_eqOp || _oper == A_neqOp) && !_left->has_constant_value() && !_right->has_constant_value();
+    }
+    void HERA_string_equality(HERA_insns &out, const string &label, bool when);
     virtual int init_result_reg();
-    virtual int init_labels();
-    int stored_result_reg = -1;
-    string stored_true_label = "";
-    string stored_end_label = "";
+    virtual int init_label_number();
+    AST_ATTRIBUTE(int, label_number);
+    virtual bool init_has_constant_value(int &value);
 
     A_oper _oper;
     A_exp _left;
@@ -894,26 +802,18 @@ public:
 	A_assignExp_(A_pos pos, A_var var, A_exp exp);
 	virtual string print_rep(int indent, bool with_attributes);
 
-    int result_reg() {
-        if (this->stored_result_reg < 0) this->stored_result_reg = this->init_result_reg();
-        return stored_result_reg;
-    }
-    string result_reg_s() { // return in string form, e.g. "R2"
-        return "R" + std::to_string(this->result_reg());
-    }
     virtual Symbol my_var_from_var();
 
-    string HERA_code();
-    string HERA_data();
+    void HERA_code(HERA_insns &out);
+    void HERA_data(HERA_emitter &out);
 
-    Ty_ty typecheck();
+    virtual Ty_ty init_typecheck();
     void set_parent_pointers_for_me_and_my_descendants(AST_node_ *my_parent);
 private:
 	A_var _var;
 	A_exp _exp;
 
     int init_result_reg();
-    int stored_result_reg = -1;
 };
 
 class A_letExp_ : public A_exp_ {
@@ -922,16 +822,8 @@ public:
 	virtual string print_rep(int indent, bool with_attributes);
     void set_parent_pointers_for_me_and_my_descendants(AST_node_ *my_parent);
 
-    int result_reg() {
-        if (this->stored_result_reg < 0) this->stored_result_reg = this->init_result_reg();
-        return stored_result_reg;
-    }
-    string result_reg_s() { // return in string form, e.g. "R2"
-        return "R" + std::to_string(this->result_reg());
-    }
     virtual int result_where_stack(){
-        if (this->stored_where_stack < 0) this->stored_where_stack = this->init_result_where_stack();
-        return this->stored_where_stack;
+        return stored_result_where_stack.get();
     }
 
     virtual int my_let_fp_plus() {
@@ -950,14 +842,9 @@ public:
             return this->result_fp_plus();
         }
     }
-    virtual int result_fp_plus(){
-        if (this->stored_fp_plus < 0) this->stored_fp_plus = this->init_result_fp_plus();
-        return this->stored_fp_plus;
-    }
 
     virtual int result_end_fp_plus(){
-        if (this->stored_end_fp_plus < 0) this->stored_end_fp_plus = this->init_result_end_fp_plus();
-        return this->stored_end_fp_plus;
+        return stored_result_end_fp_plus.get();
     }
 
     local_variable_scope virtual my_local_variables(){
@@ -970,16 +857,17 @@ public:
     tiger_standard_library virtual my_local_functions(){
         if (!is_funcs_init) {
             funcs_data_shell = this->init_local_functions();
+            is_funcs_init = true;
         }
         return funcs_data_shell;
     }
 
     virtual Ty_ty implicit_type_init(Symbol name);
 
-    virtual string HERA_code();
-    virtual string HERA_data();
+    virtual void HERA_code(HERA_insns &out);
+    virtual void HERA_data(HERA_emitter &out);
 
-    virtual Ty_ty typecheck();
+    virtual Ty_ty init_typecheck();
 
     virtual bool skip_my_symbol_table() {return false;}
     virtual int let_fp_plus_total();
@@ -989,15 +877,13 @@ public:
     }
 private:
     int init_result_reg();
-    int stored_result_reg = -1;
 
     int init_result_fp_plus();
-    int stored_fp_plus = -1;
 
     int init_result_end_fp_plus();
-    int stored_end_fp_plus = -1;
+    AST_ATTRIBUTE(int, result_end_fp_plus);
 
-    int stored_where_stack = -1;
+    AST_ATTRIBUTE(int, result_where_stack);
     int init_result_where_stack();
 
     bool is_vars_init = false;
@@ -1018,23 +904,17 @@ public:
 	A_callExp_(A_pos pos, Symbol func, A_expList args);
 	virtual string print_rep(int indent, bool with_attributes);
 
-    int result_reg() {
-        if (this->stored_result_reg < 0) this->stored_result_reg = this->init_result_reg();
-        return stored_result_reg;
-    }
-    string result_reg_s() { // return in string form, e.g. "R2"
-        return "R" + std::to_string(this->result_reg());
-    }
-    virtual int result_fp_plus(){
-        if (this->stored_fp_plus < 0) this->stored_fp_plus = this->init_result_fp_plus();
-        return this->stored_fp_plus;
-    }
-
-    virtual string HERA_data();
-    virtual string HERA_code();
+    virtual void HERA_data(HERA_emitter &out);
+    virtual void HERA_code(HERA_insns &out);
 
-    virtual Ty_ty typecheck();
+    virtual Ty_ty init_typecheck();
 
+    function_binding binding() {  // the function we're calling
+        return stored_binding.get();
+    }
+    string branch_label_end() {  // for the library routines done without a CALL (see HERA_code.cpp)
+        return "my_call_end_"+str(stored_label_number.get());
+    }
 
     void set_parent_pointers_for_me_and_my_descendants(AST_node_ *my_parent);
 
@@ -1042,11 +922,14 @@ private:
 	Symbol _func;
 	A_expList _args;
 
+    void HERA_intrinsic_code(int which, HERA_insns &out);
     virtual int init_result_reg();
-    int stored_result_reg = -1;
+    virtual int init_label_number();
+    AST_ATTRIBUTE(int, label_number);
 
     int init_result_fp_plus();
-    int stored_fp_plus = -1;
+    function_binding init_binding();
+    AST_ATTRIBUTE(function_binding, binding);
 };
 
 class A_controlExp_ : public A_exp_ {
@@ -1059,35 +942,21 @@ public:
 	A_ifExp_(A_pos pos, A_exp test, A_exp then, A_exp else_or_0_pointer_for_no_else);
 	virtual string print_rep(int indent, bool with_attributes);
 
-    int result_reg() {
-        if (this->stored_result_reg < 0) this->stored_result_reg = this->init_result_reg();
-        return stored_result_reg;
-    }
-    void do_init(){
-        if (this->stored_then_label == "" && this->stored_else_label == "" && this->stored_post_label == ""){
-            int results = this->init_if_labels();
-            this->stored_then_label = "my_if_then_"+str(results);
-            this->stored_else_label = "my_if_else_"+str(results);
-            this->stored_post_label = "my_if_post_"+str(results);
-        }
-    }
     string branch_label_then() {
-        do_init();
-        return stored_then_label;
+        return "my_if_then_"+str(stored_label_number.get());
     }
     string branch_label_else() {
-        do_init();
-        return stored_else_label;
+        return "my_if_else_"+str(stored_label_number.get());
     }
     string branch_label_post_if() {
-        do_init();
-        return stored_post_label;
+        return "my_if_post_"+str(stored_label_number.get());
     }
 
-    virtual string HERA_data();
-    virtual string HERA_code();
+    virtual void HERA_data(HERA_emitter &out);
+    virtual void HERA_code(HERA_insns &out);
+    virtual void HERA_branch(HERA_insns &out, const string &label, bool when);  // for & and |, which are ifs
 
-    virtual Ty_ty typecheck();
+    virtual Ty_ty init_typecheck();
 
     void set_parent_pointers_for_me_and_my_descendants(AST_node_ *my_parent);
 private:
@@ -1095,13 +964,10 @@ private:
 	A_exp _then;
 	A_exp _else_or_null;
 
-    virtual int init_if_labels();
+    virtual int init_label_number();
     virtual int init_result_reg();
 
-    int stored_result_reg = -1;
-    string stored_then_label = "";
-    string stored_else_label = "";
-    string stored_post_label = "";
+    AST_ATTRIBUTE(int, label_number);
 };
 
 class A_whileExp_ : public A_controlExp_ {
@@ -1109,42 +975,27 @@ public:
     A_whileExp_(A_pos pos, A_exp cond, A_exp body);
     virtual string print_rep(int indent, bool with_attributes);
 
-    int result_reg() {
-        if (this->stored_result_reg < 0) this->stored_result_reg = this->init_result_reg();
-        return stored_result_reg;
-    }
-    void do_init(){
-        if (this->stored_cond_label == "" && this->stored_post_label == ""){
-            int results = this->init_labels();
-            this->stored_cond_label = "my_while_cond_"+str(results);
-            this->stored_post_label = "my_while_post_"+str(results);
-        }
-    }
     string branch_label_cond() {
-        do_init();
-        return stored_cond_label;
+        return "my_while_cond_"+str(stored_label_number.get());
     }
     string branch_label_post() {
-        do_init();
-        return stored_post_label;
+        return "my_while_post_"+str(stored_label_number.get());
     }
 
-    virtual string HERA_data();
-    virtual string HERA_code();
+    virtual void HERA_data(HERA_emitter &out);
+    virtual void HERA_code(HERA_insns &out);
 
-    virtual Ty_ty typecheck();
+    virtual Ty_ty init_typecheck();
 
     void set_parent_pointers_for_me_and_my_descendants(AST_node_ *my_parent);
 private:
     A_exp _cond;
     A_exp _body;
 
-    virtual int init_labels();
+    virtual int init_label_number();
     virtual int init_result_reg();
 
-    int stored_result_reg = -1;
-    string stored_cond_label = "";
-    string stored_post_label = "";
+    AST_ATTRIBUTE(int, label_number);
 };
 
 class A_forExp_ : public A_controlExp_ {
@@ -1152,35 +1003,15 @@ public:
 	A_forExp_(A_pos pos, Symbol var, A_exp lo, A_exp hi, A_exp body);
 	virtual string print_rep(int indent, bool with_attributes);
     void set_parent_pointers_for_me_and_my_descendants(AST_node_ *my_parent);
-    void do_init(){
-        if (this->stored_cond_label == "" && this->stored_post_label == ""){
-            int results = this->init_labels();
-            this->stored_cond_label = "my_for_cond_"+str(results);
-            this->stored_post_label = "my_for_post_"+str(results);
-        }
-    }
     string branch_label_cond() {
-        do_init();
-        return stored_cond_label;
+        return "my_for_cond_"+str(stored_label_number.get());
     }
     string branch_label_post() {
-        do_init();
-        return stored_post_label;
+        return "my_for_post_"+str(stored_label_number.get());
     }
 
     virtual Symbol my_for_loop(){ return _var;};
 
-    int    result_reg() {
-        if (this->stored_result_reg < 0) this->stored_result_reg = this->init_result_reg();
-        return stored_result_reg;
-    }
-    string result_reg_s() { // return in string form, e.g. "R2"
-        return "R" + std::to_string(this->result_reg());
-    }
-    int result_fp_plus(){
-        if (this->stored_fp_plus < 0) this->stored_fp_plus = this->init_result_fp_plus();
-        return this->stored_fp_plus;
-    }
     int fp_plus_for_me(A_exp which_child) {
         if (which_child == _hi || which_child == _lo){
             return this->parent()->result_fp_plus();
@@ -1196,14 +1027,15 @@ public:
     virtual local_variable_scope my_local_variables(){
         if (!is_vars_init) {
             vars_data_shell = this->init_local_variable();
+            is_vars_init = true;
         }
         return vars_data_shell;
     }
 
-    virtual string HERA_data();
-    virtual string HERA_code();
+    virtual void HERA_data(HERA_emitter &out);
+    virtual void HERA_code(HERA_insns &out);
 
-    virtual Ty_ty typecheck();
+    virtual Ty_ty init_typecheck();
 private:
 	Symbol _var;
 	A_exp _lo;
@@ -1215,12 +1047,9 @@ private:
     local_variable_scope vars_data_shell = local_variable_scope();
     tiger_standard_library funcs_data_shell = tiger_standard_library();
     int init_result_reg();
-    int init_labels();
-    int stored_result_reg = -1;
+    int init_label_number();
+    AST_ATTRIBUTE(int, label_number);
     int init_result_fp_plus();
-    int stored_fp_plus = -1;
-    string stored_cond_label = "";
-    string stored_post_label = "";
 };
 
 
@@ -1229,21 +1058,12 @@ public:
 	A_breakExp_(A_pos p);
 	virtual string print_rep(int indent, bool with_attributes);
 
-    int result_reg() {
-        if (this->stored_result_reg < 0) this->stored_result_reg = this->init_result_reg();
-        return stored_result_reg;
-    }
-
     virtual string break_label(){
-        if (stored_break_label == "") {
-            stored_break_label = this->init_break_label();
-        }
-
-        return stored_break_label;
+        return stored_break_label.get();
     }
 
-    virtual string HERA_code();
-    virtual string HERA_data();
+    virtual void HERA_code(HERA_insns &out);
+    virtual void HERA_data(HERA_emitter &out);
 
     virtual int init_result_reg();
 
@@ -1251,8 +1071,7 @@ public:
 
 private:
     virtual string init_break_label();
-    string stored_break_label = "";
-    int stored_result_reg = -1;
+    AST_ATTRIBUTE(string, break_label);
 
 };
 
@@ -1261,31 +1080,18 @@ public:
 	A_seqExp_(A_pos pos, A_expList seq);
 	virtual string print_rep(int indent, bool with_attributes);
 
-    int result_reg() {
-        if (this->stored_result_reg < 0) this->stored_result_reg = this->init_result_reg();
-        return stored_result_reg;
-    }
-    string result_reg_s() { // return in string form, e.g. "R2"
-        return "R" + std::to_string(this->result_reg());
-    }
-    int result_fp_plus(){
-        if (this->stored_fp_plus < 0) this->stored_fp_plus = this->init_result_fp_plus();
-        return this->stored_fp_plus;
-    }
     virtual int init_result_reg();
 
-    virtual string HERA_data();
-    virtual string HERA_code();
+    virtual void HERA_data(HERA_emitter &out);
+    virtual void HERA_code(HERA_insns &out);
 
-    virtual Ty_ty typecheck();
+    virtual Ty_ty init_typecheck();
 
     void set_parent_pointers_for_me_and_my_descendants(AST_node_ *my_parent);
 private:
 	A_expList _seq;
-    int stored_result_reg = -1;
 
     int init_result_fp_plus();
-    int stored_fp_plus = -1;
 
 };
 
@@ -1295,8 +1101,7 @@ public:
     int result_reg() {
         return 1;
     }
-    virtual string HERA_assign(){
-        return "";
+    virtual void HERA_assign(HERA_insns &out){
     };
 };
 
@@ -1307,31 +1112,32 @@ public:
     void set_parent_pointers_for_me_and_my_descendants(AST_node_ *my_parent);
 
     int result_reg() {
-        if (this->stored_result_reg < 0) this->stored_result_reg = this->init_result_reg();
-        return stored_result_reg;
+        return stored_result_reg.get();
     }
-    string result_reg_s() { // return in string form, e.g. "R2"
-        return "R" + std::to_string(this->result_reg());
+    HERA_operand result_register() { // as an operand, e.g. R2
+        return HERA_register(this->result_reg());
     }
     int result_fp_plus(){
-        if (this->stored_fp_plus < 0) this->stored_fp_plus = this->init_result_fp_plus();
-        return this->stored_fp_plus;
+        return stored_result_fp_plus.get();
     }
 
-    int get_offest();
+    variable_binding binding() {  // the variable we're using
+        return stored_binding.get();
+    }
     virtual Symbol my_var_from_var() {return _sym;}
 
-    virtual string HERA_data();
-    virtual string HERA_code();
-    virtual string HERA_assign();
+    virtual void HERA_data(HERA_emitter &out);
+    virtual void HERA_code(HERA_insns &out);
+    virtual void HERA_assign(HERA_insns &out);
 
-    virtual Ty_ty typecheck();
+    virtual Ty_ty init_typecheck();
 private:
     int init_result_reg();
-    int stored_result_reg = -1;
+    AST_ATTRIBUTE(int, result_reg);
     int init_result_fp_plus();
-    int stored_fp_plus = -1;
-    int stored_offest = -1;
+    AST_ATTRIBUTE(int, result_fp_plus);
+    variable_binding init_binding();
+    AST_ATTRIBUTE(variable_binding, binding);
 
 	Symbol _sym;
 };
@@ -1362,22 +1168,20 @@ public:
 	virtual string print_rep(int indent, bool with_attributes);
 
     int result_reg() {
-        if (this->stored_result_reg < 0) this->stored_result_reg = this->init_result_reg();
-        return stored_result_reg;
+        return stored_result_reg.get();
     }
-    string result_reg_s() { // return in string form, e.g. "R2"
-        return "R" + std::to_string(this->result_reg());
+    HERA_operand result_register() { // as an operand, e.g. R2
+        return HERA_register(this->result_reg());
     }
     int result_fp_plus(){
-        if (this->stored_fp_plus < 0) this->stored_fp_plus = this->init_result_fp_plus();
-        return this->stored_fp_plus;
+        return stored_result_fp_plus.get();
     }
     virtual int init_result_reg();
 
-    virtual string HERA_data();
-    virtual string HERA_code();
+    virtual void HERA_data(HERA_emitter &out);
+    virtual void HERA_code(HERA_insns &out);
 
-    virtual Ty_ty typecheck();
+    virtual Ty_ty init_typecheck();
 
 	int length();
 	A_exp _head;
@@ -1385,9 +1189,9 @@ public:
 
     void set_parent_pointers_for_me_and_my_descendants(AST_node_ *my_parent);
 private:
-    int stored_result_reg = -1;
+    AST_ATTRIBUTE(int, result_reg);
     int init_result_fp_plus();
-    int stored_fp_plus = -1;
+    AST_ATTRIBUTE(int, result_fp_plus);
 };
 
 // The componends of a A_recordExp, e.g. point{X = 4, Y = 12}
@@ -1423,20 +1227,17 @@ public:
     void set_parent_pointers_for_me_and_my_descendants(AST_node_ *my_parent);
 
     int result_reg() {
-        if (this->stored_result_reg < 0) this->stored_result_reg = this->init_result_reg();
-        return stored_result_reg;
+        return stored_result_reg.get();
     }
-    string result_reg_s() { // return in string form, e.g. "R2"
-        return "R" + std::to_string(this->result_reg());
+    HERA_operand result_register() { // as an operand, e.g. R2
+        return HERA_register(this->result_reg());
     }
     int result_fp_plus(){
-        if (this->stored_fp_plus < 0) this->stored_fp_plus = this->init_result_fp_plus();
-        return this->stored_fp_plus;
+        return stored_result_fp_plus.get();
     }
 
     virtual int result_end_fp_plus(){
-        if (this->stored_end_fp_plus < 0) this->stored_end_fp_plus = this->init_result_end_fp_plus();
-        return this->stored_end_fp_plus;
+        return stored_result_end_fp_plus.get();
     }
 
     virtual bool carrys_func(){
@@ -1459,6 +1260,7 @@ public:
     local_variable_scope virtual my_local_variables(){
         if (!is_vars_init) {
             vars_data_shell = this->init_local_variable();
+            is_vars_init = true;
         }
         return vars_data_shell;
     }
@@ -1466,28 +1268,29 @@ public:
     tiger_standard_library virtual my_local_functions(){
         if (!is_funcs_init) {
             funcs_data_shell = this->init_local_functions();
+            is_funcs_init = true;
         }
         return funcs_data_shell;
     }
 
     virtual Ty_ty find_my_implicit(Symbol name);
 
-    virtual string HERA_code();
-    virtual string HERA_data();
-    virtual Ty_ty typecheck();
+    virtual void HERA_code(HERA_insns &out);
+    virtual void HERA_data(HERA_emitter &out);
+    virtual Ty_ty init_typecheck();
 
     virtual int let_fp_plus_total();
 
 private:
     A_dec _head;
     A_decList _tail;
-    int stored_result_reg = -1;
+    AST_ATTRIBUTE(int, result_reg);
     int init_result_reg();
 
-    int stored_fp_plus = -1;
+    AST_ATTRIBUTE(int, result_fp_plus);
     int init_result_fp_plus();
 
-    int stored_end_fp_plus = -1;
+    AST_ATTRIBUTE(int, result_end_fp_plus);
     int init_result_end_fp_plus();
 
     bool is_vars_init = false;
@@ -1506,20 +1309,17 @@ public:
     void set_parent_pointers_for_me_and_my_descendants(AST_node_ *my_parent);
 
     int result_reg() {
-        if (this->stored_result_reg < 0) this->stored_result_reg = this->init_result_reg();
-        return stored_result_reg;
+        return stored_result_reg.get();
     }
-    string result_reg_s() { // return in string form, e.g. "R2"
-        return "R" + std::to_string(this->result_reg());
+    HERA_operand result_register() { // as an operand, e.g. R2
+        return HERA_register(this->result_reg());
     }
     int result_fp_plus(){
-        if (this->stored_fp_plus < 0) this->stored_fp_plus = this->init_result_fp_plus();
-        return this->stored_fp_plus;
+        return stored_result_fp_plus.get();
     }
 
     virtual int result_where_stack(){
-        if (this->stored_where_stack < 0) this->stored_where_stack = this->init_result_where_stack();
-        return this->stored_where_stack;
+        return stored_result_where_stack.get();
     }
 
 
@@ -1530,27 +1330,28 @@ public:
     virtual local_variable_scope my_local_variables(){
         if (!is_vars_init) {
             vars_data_shell = this->init_local_variable();
+            is_vars_init = true;
         }
         return vars_data_shell;
     }
 
     virtual Ty_ty find_my_implicit(Symbol name);
 
-    virtual string HERA_code();
-    virtual string HERA_data();
+    virtual void HERA_code(HERA_insns &out);
+    virtual void HERA_data(HERA_emitter &out);
 
-    virtual Ty_ty typecheck();
+    virtual Ty_ty init_typecheck();
     virtual int let_fp_plus_total();
 private:
 	Symbol _var;
 	Symbol _typ;
 	A_exp _init;
 
-    int stored_result_reg = -1;
+    AST_ATTRIBUTE(int, result_reg);
     int init_result_reg();
-    int stored_fp_plus = -1;
+    AST_ATTRIBUTE(int, result_fp_plus);
     int init_result_fp_plus();
-    int stored_where_stack = -1;
+    AST_ATTRIBUTE(int, result_where_stack);
     int init_result_where_stack();
 
     bool is_vars_init = false;
@@ -1572,12 +1373,11 @@ public:
     void set_parent_pointers_for_me_and_my_descendants(AST_node_ *my_parent);
 
     int result_fp_plus(){
-        if (this->stored_fp_plus < 0) this->stored_fp_plus = this->init_result_fp_plus();
-        return this->stored_fp_plus;
+        return stored_result_fp_plus.get();
     }
 
-    virtual string HERA_code();
-    virtual string HERA_data();
+    virtual void HERA_code(HERA_insns &out);
+    virtual void HERA_data(HERA_emitter &out);
 
     virtual bool carrys_func(){
         return true;
@@ -1586,11 +1386,21 @@ public:
     tiger_standard_library virtual my_local_functions(){
         if (!is_funcs_init) {
             funcs_data_shell = this->init_local_functions();
+            is_funcs_init = true;
         }
         return funcs_data_shell;
     }
     virtual int let_fp_plus_total();
-    virtual Ty_ty typecheck();
+    virtual Ty_ty init_typecheck();
+
+    // For --cache-dir, each A_functionDec_ that isn't inside a function keeps track of
+    //  what its functions look up outside it (see cache.h and cache.cpp)
+    int cache_group(){  // which of IR_program::current()->cache_groups, or -1
+        return stored_cache_group.get();
+    }
+    virtual function_binding resolve_function(Symbol name);
+    virtual variable_binding resolve_variable(Symbol name, int ceiling = 1000000000);
+    virtual Ty_ty implicit_type_init(Symbol name);
 
 private:
     bool is_funcs_init = false;
@@ -1598,7 +1408,13 @@ private:
     tiger_standard_library funcs_data_shell = tiger_standard_library();
 
     int init_result_fp_plus();
-    int stored_fp_plus = -1;
+    AST_ATTRIBUTE(int, result_fp_plus);
+
+    int init_cache_group();
+    AST_ATTRIBUTE(int, cache_group);
+    int recording_group = -1;  // the cache group whose dependencies we're noting, while generating its code
+    void note_dependency(const string &what, const string &found);
+    string outside(const string &what, std::map<string, string> &labels);
 
 	A_fundecList theFunctions;
 };
@@ -1623,29 +1439,31 @@ public:
     };
 
     int result_fp_plus(){
-        if (this->stored_fp_plus < 0) this->stored_fp_plus = this->init_result_fp_plus();
-        return this->stored_fp_plus;
+        return stored_result_fp_plus.get();
     }
 
     virtual int result_where_stack(){
-        if (this->stored_where_stack < 0) this->stored_where_stack = this->init_result_where_stack();
-        return this->stored_where_stack;
+        return stored_result_where_stack.get();
     }
 
     int fp_plus_for_me(A_exp which_child);
 
     virtual int my_func_fp_plus(){
-        return this->result_fp_plus();
+        return 3;  // the first parameter, right after the static link
     }
 
+    int number_of_params();      // see layout_frames.cpp
+    int argument_slots();
+    int saved_register_slots();
+
     virtual int result_frames(){
-        if (this->stored_frames < 0) this->stored_frames = this->init_result_frames();
-        return this->stored_frames;
+        return stored_result_frames.get();
     }
 
     virtual local_variable_scope my_local_variables(){
         if (!is_vars_init) {
             vars_data_shell = this->init_local_variable();
+            is_vars_init = true;
         }
         return vars_data_shell;
     }
@@ -1653,13 +1471,13 @@ public:
     virtual tiger_standard_library my_local_functions(){
         if (!is_funcs_init) {
             funcs_data_shell = this->init_local_funcs();
+            is_funcs_init = true;
         }
         return funcs_data_shell;
     }
 
     string branch_label_post() {
-        if (stored_skip_label == "") stored_skip_label = this->init_label_skip();
-        return stored_skip_label;
+        return stored_label_skip.get();
     }
 
     string set_unique_id(){
@@ -1667,12 +1485,16 @@ public:
         return _unique_id;
     }
 
+    string function_label(){  // where CALL goes
+        return str(_name) + this->set_unique_id();
+    }
+
     HaverfordCS::list<Ty_ty> type_field_list();
 
-    virtual string HERA_code();
-    virtual string HERA_data();
+    virtual void HERA_code(HERA_insns &out);
+    virtual void HERA_data(HERA_emitter &out);
 
-    virtual Ty_ty typecheck();
+    virtual Ty_ty init_typecheck();
 private:
 	Symbol _name;
 	A_fieldList _params;
@@ -1680,15 +1502,15 @@ private:
 	A_exp _body;
     string _unique_id;
 
-    int stored_where_stack = -1;
+    AST_ATTRIBUTE(int, result_where_stack);
     int init_result_where_stack();
-    string stored_skip_label = "";
+    AST_ATTRIBUTE(string, label_skip);
     string init_label_skip();
-    int stored_fp_plus = -1;
+    AST_ATTRIBUTE(int, result_fp_plus);
     int init_result_fp_plus();
 
     int init_result_frames();
-    int stored_frames = -1;
+    AST_ATTRIBUTE(int, result_frames);
 
     bool is_vars_init = false;
     local_variable_scope init_local_variable();
@@ -1713,8 +1535,7 @@ public:
     }
 
     int result_fp_plus(){
-        if (this->stored_fp_plus < 0) this->stored_fp_plus = this->init_result_fp_plus();
-        return this->stored_fp_plus;
+        return stored_result_fp_plus.get();
     }
 
     void set_parent_pointers_for_me_and_my_descendants(AST_node_ *my_parent);
@@ -1722,14 +1543,20 @@ public:
     tiger_standard_library virtual my_local_functions(){
         if (!is_funcs_init) {
             funcs_data_shell = this->init_local_functions();
+            is_funcs_init = true;
         }
         return funcs_data_shell;
     }
 
-    virtual string HERA_code();
-    virtual string HERA_data();
+    void function_labels(std::vector<string> &labels){  // of each function in the list, in order
+        labels.push_back(_head->function_label());
+        if (_tail != 0) _tail->function_labels(labels);
+    }
+
+    virtual void HERA_code(HERA_insns &out);
+    virtual void HERA_data(HERA_emitter &out);
 
-    virtual Ty_ty typecheck();
+    virtual Ty_ty init_typecheck();
 private:
 	A_fundec _head;
 	A_fundecList _tail;
@@ -1738,7 +1565,7 @@ private:
     tiger_standard_library init_local_functions();
     tiger_standard_library funcs_data_shell = tiger_standard_library();
 
-    int stored_fp_plus = -1;
+    AST_ATTRIBUTE(int, result_fp_plus);
     int init_result_fp_plus();
 };
 
@@ -1774,12 +1601,12 @@ public:
     void set_parent_pointers_for_me_and_my_descendants(AST_node_ *my_parent);
 
     int result_fp_plus(){
-        if (this->stored_fp_plus < 0) this->stored_fp_plus = this->init_result_fp_plus();
-        return this->stored_fp_plus;
+        return stored_result_fp_plus.get();
     }
     local_variable_scope virtual my_local_variables(){
         if (!is_vars_init) {
             vars_data_shell = this->init_local_variable();
+            is_vars_init = true;
         }
         return vars_data_shell;
     }
@@ -1792,13 +1619,13 @@ public:
 
     bool null_input();
 
-    virtual string HERA_code();
-    virtual string HERA_data();
+    virtual void HERA_code(HERA_insns &out);
+    virtual void HERA_data(HERA_emitter &out);
 private:
 	A_field _head;
 	A_fieldList _tail;
 
-    int stored_fp_plus = -1;
+    AST_ATTRIBUTE(int, result_fp_plus);
     int init_result_fp_plus();
 
     bool is_vars_init = false;
@@ -1815,8 +1642,7 @@ public:
     void set_parent_pointers_for_me_and_my_descendants(AST_node_ *my_parent);
 
     int result_fp_plus(){
-        if (this->stored_fp_plus < 0) this->stored_fp_plus = this->init_result_fp_plus();
-        return this->stored_fp_plus;
+        return stored_result_fp_plus.get();
     }
 
     virtual void create_variable(Symbol name, Ty_ty type, int fp_plus, int frames) {
@@ -1826,6 +1652,7 @@ public:
     virtual local_variable_scope my_local_variables(){
         if (!is_vars_init) {
             vars_data_shell = this->init_local_variable();
+            is_vars_init = true;
         }
         return vars_data_shell;
     }
@@ -1838,13 +1665,13 @@ public:
         return from_String(str(_typ));
     }
 
-    virtual string HERA_code();
-    virtual string HERA_data();
+    virtual void HERA_code(HERA_insns &out);
+    virtual void HERA_data(HERA_emitter &out);
 private:
 	Symbol _name;
 	Symbol _typ;
 
-    int stored_fp_plus = -1;
+    AST_ATTRIBUTE(int, result_fp_plus);
     int init_result_fp_plus();
 
     bool is_vars_init = false;
@@ -0,0 +1,87 @@
+#include <new>
+#include "ASTArena.h"
+#include "phases.h"
+
+static thread_local ASTArena *the_current_arena = 0;  // each thread compiles one program at a time
+
+ASTArena::ASTArena() : next(0), end(0), total_bytes(0), total_objects(0)
+{
+}
+
+ASTArena::~ASTArena()
+{
+	release();
+	if (the_current_arena == this) the_current_arena = 0;
+}
+
+void *ASTArena::allocate(size_t bytes)
+{
+	const size_t align = alignof(std::max_align_t);
+	bytes = (bytes + align - 1) / align * align;
+	if (bytes > size_t(end - next)) {
+		size_t size = bytes > chunk_size ? bytes : chunk_size;
+		char *start = static_cast<char *>(::operator new(size));
+		chunks.push_back(chunk{start, size});
+		next = start;
+		end = start + size;
+	}
+	void *result = next;
+	next += bytes;
+	total_bytes += bytes;
+	total_objects++;
+	return result;
+}
+
+bool ASTArena::owns(const void *p) const
+{
+	const char *c = static_cast<const char *>(p);
+	for (auto ch = chunks.rbegin(); ch != chunks.rend(); ch++)  // newest first, since that's the usual question
+		if (c >= ch->start && c < ch->start + ch->size)
+			return true;
+	return false;
+}
+
+void ASTArena::destroy_at_release(void *object, void (*destroy)(void *))
+{
+	if (owns(object))
+		to_destroy.push_back(destructor_call{object, destroy});
+}
+
+void ASTArena::release()
+{
+	for (auto d = to_destroy.rbegin(); d != to_destroy.rend(); d++)
+		d->destroy(d->object);
+	to_destroy.clear();
+	for (chunk &ch : chunks)
+		::operator delete(ch.start);
+	chunks.clear();
+	next = end = 0;
+	total_bytes = total_objects = 0;
+}
+
+ASTArena *ASTArena::current()
+{
+	return the_current_arena;
+}
+
+void ASTArena::set_current(ASTArena *a)
+{
+	the_current_arena = a;
+}
+
+void *ASTArena::allocate_in_current(size_t bytes)
+{
+	if (the_current_arena) {
+		allocations_in_this_thread++;  // for --time-phases; the heap ones are counted in phases.cpp
+		return the_current_arena->allocate(bytes);
+	}
+	else
+		return ::operator new(bytes);
+}
+
+void ASTArena::deallocate(void *p)
+{
+	// arena memory is only given back by release(); anything else came from the heap
+	if (p && !(the_current_arena && the_current_arena->owns(p)))
+		::operator delete(p);
+}
@@ -0,0 +1,56 @@
+#if ! defined AST_ARENA_H
+#define AST_ARENA_H
+
+#include <cstddef>
+#include <vector>
+
+// An ASTArena hands out memory for AST nodes, Ty_ty_ objects and the Ty_ list cells
+//  by bumping a pointer through big chunks, and gives it all back at once when it is
+//  released (or destroyed). This is much cheaper than one "new" per node, keeps the nodes
+//  of a tree close together in memory, and means that compiling many programs
+//  in one process doesn't keep every old AST around.
+//
+// The tigerParseDriver owns an arena, and makes it the "current" one while it exists,
+//  so everything built by the grammar, the type checker, or code generation goes there.
+// When no arena is current (e.g. for the standard library table built before main,
+//  or for AST_examples), the operator new's below just use the ordinary heap.
+//
+// Objects with real destructors (all AST nodes, which hold strings and symbol tables)
+//  ask to be destroyed when the arena is released; see AST_node_::AST_node_.
+
+class ASTArena {
+public:
+	ASTArena();
+	~ASTArena();  // calls release()
+
+	void *allocate(size_t bytes);
+	void destroy_at_release(void *object, void (*destroy)(void *));  // ignored unless object is in this arena
+	bool owns(const void *p) const;
+	void release();  // destroy registered objects (most recent first) and free all chunks
+
+	unsigned long bytes_allocated() const { return total_bytes; }
+	unsigned long objects_allocated() const { return total_objects; }
+
+	static ASTArena *current();
+	static void set_current(ASTArena *a);
+
+	// memory for class-specific operator new/delete
+	static void *allocate_in_current(size_t bytes);
+	static void deallocate(void *p);
+
+private:
+	ASTArena(const ASTArena &) = delete;
+	ASTArena &operator=(const ASTArena &) = delete;
+
+	static const size_t chunk_size = 64*1024;
+	struct chunk { char *start; size_t size; };
+	struct destructor_call { void *object; void (*destroy)(void *); };
+
+	std::vector<chunk> chunks;
+	char *next;  // bump pointer, within the last chunk
+	char *end;
+	std::vector<destructor_call> to_destroy;
+	unsigned long total_bytes, total_objects;
+};
+
+#endif
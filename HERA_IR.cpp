@@ -0,0 +1,328 @@
+#include <cctype>
+#include <cstdlib>
+#include <unordered_map>
+#include "HERA_IR.h"
+
+/*
+ * Reading and writing the linear form of HERA code, and the facts about each instruction we need for analysis
+ */
+
+static const char *op_names[HERA_ops] = {
+	"",
+	"SET", "SETLO", "SETHI", "MOVE", "ADD", "SUB", "MUL", "AND", "OR", "XOR",
+	"INC", "DEC", "LSL", "LSR", "ASL", "ASR", "LSL8", "LSR8", "CMP",
+	"LOAD", "STORE", "LABEL", "DLABEL", "CALL", "RETURN", "HALT", "CBON",
+	"BR", "BZ", "BNZ", "BL", "BLE", "BG", "BGE", "BULE", "BUG", "BS", "BNS", "BC", "BNC", "BV", "BNV",
+	"BRR", "BZR", "BNZR", "BLR", "BLER", "BGR", "BGER", "BULER", "BUGR", "BSR", "BNSR", "BCR", "BNCR", "BVR", "BNVR",
+};
+
+const char *HERA_op_name(HERA_op op)
+{
+	return op_names[op];
+}
+
+bool HERA_op_named(const string &name, HERA_op &op)
+{
+	static const std::unordered_map<string, HERA_op> ops = [] {
+		std::unordered_map<string, HERA_op> result;
+		for (int o = HERA_TEXT + 1; o < HERA_ops; o++)
+			result[op_names[o]] = HERA_op(o);
+		return result;
+	}();
+	auto o = ops.find(name);
+	if (o == ops.end()) return false;
+	op = o->second;
+	return true;
+}
+
+
+HERA_operand HERA_register(int number)
+{
+	return {HERA_operand::reg, number};
+}
+
+HERA_operand HERA_number(int value)
+{
+	return {HERA_operand::number, value};
+}
+
+HERA_operand HERA_label(const string &label)
+{
+	return {HERA_operand::label, 0, label};
+}
+
+HERA_operand HERA_temporary(int number)
+{
+	return {HERA_operand::temporary, number};
+}
+
+static const char *fixed_names[] = {"Rt", "FP_alt", "PC_ret", "FP", "SP"};  // R11 ... R15
+
+string HERA_operand::__str__() const
+{
+	switch (kind) {
+	case reg:       return "R" + str(n);
+	case fixed_reg: return fixed_names[n - 11];
+	case temporary: return "%t" + str(n);  // (the "%" keeps them from looking like any label or register)
+	case number:    return str(n);
+	case label:     return name;
+	default:        return "";
+	}
+}
+
+int HERA_register_number(const HERA_operand &operand)
+{
+	return operand.kind == HERA_operand::reg ? operand.n : 0;  // R0 is 0, which is what we want
+}
+
+int HERA_temporary_number(const HERA_operand &operand)
+{
+	return operand.kind == HERA_operand::temporary ? operand.n : -1;
+}
+
+
+HERA_insn HERA_text(const string &text)
+{
+	HERA_insn t;
+	t.text = text;
+	return t;
+}
+
+void HERA_write(const HERA_insns &code, HERA_emitter &out)
+{
+	for (const HERA_insn &insn : code) {
+		if (insn.op == HERA_TEXT) {
+			out << insn.text;
+		} else {
+			out << HERA_op_name(insn.op) << "(";
+			for (unsigned i = 0; i < insn.args.size(); i++)
+				out << (i == 0 ? "" : ", ") << insn.args[i].__str__();
+			out << ")\n";
+		}
+	}
+}
+
+
+// Reading code back in, e.g. from the cache, which is only ever what HERA_write wrote
+
+static string trim(const string &s)
+{
+	unsigned long b = 0, e = s.length();
+	while (b < e && isspace((unsigned char) s[b])) b++;
+	while (e > b && isspace((unsigned char) s[e-1])) e--;
+	return s.substr(b, e - b);
+}
+
+static HERA_operand parse_operand(const string &a)
+{
+	for (int r = 0; r < 5; r++)
+		if (a == fixed_names[r]) return {HERA_operand::fixed_reg, 11 + r};
+	unsigned long digits = a.length() > 1 && (a[0] == 'R' || a[0] == '-') ? 1 : a.length() > 2 && a[0] == '%' && a[1] == 't' ? 2 : 0;
+	bool numeric = a.length() > digits;
+	for (unsigned long i = digits; i < a.length(); i++)
+		if (!isdigit((unsigned char) a[i])) numeric = false;
+	if (!numeric) return HERA_label(a);
+	if (a[0] == 'R') return HERA_register(atoi(a.c_str() + 1));
+	if (a[0] == '%') return HERA_temporary(atoi(a.c_str() + 2));
+	return HERA_number(atoi(a.c_str()));
+}
+
+// turn one line (without its newline) into an instruction, or return false if it isn't one
+static bool parse_instruction(const string &line, HERA_insn &insn)
+{
+	unsigned long i = 0;
+	while (i < line.length() && (line[i] == ' ' || line[i] == '\t')) i++;
+	unsigned long name_start = i;
+	while (i < line.length() && (isalnum((unsigned char) line[i]) || line[i] == '_')) i++;
+	if (i == name_start || i >= line.length() || line[i] != '(' ||
+	    !HERA_op_named(line.substr(name_start, i - name_start), insn.op))
+		return false;
+	unsigned long close = line.find(')', i);
+	if (close == string::npos)
+		return false;
+
+	string args = line.substr(i + 1, close - i - 1);
+	unsigned long start = 0;
+	while (trim(args) != "") {
+		unsigned long comma = args.find(',', start);
+		insn.args.push_back(parse_operand(trim(args.substr(start, comma == string::npos ? string::npos : comma - start))));
+		if (comma == string::npos) break;
+		start = comma + 1;
+	}
+	return true;
+}
+
+HERA_insns HERA_parse(const string &text)
+{
+	HERA_insns code;
+	unsigned long from = 0;
+	while (from < text.length()) {
+		unsigned long nl = text.find('\n', from);
+		unsigned long end = nl == string::npos ? text.length() : nl + 1;
+		string line = text.substr(from, end - from);
+		string without_newline = line.back() == '\n' ? line.substr(0, line.length() - 1) : line;
+		HERA_insn insn;
+		if (parse_instruction(without_newline, insn))
+			code.push_back(insn);
+		else if (!code.empty() && code.back().op == HERA_TEXT)
+			code.back().text += line;
+		else
+			code.push_back(HERA_text(line));
+		from = end;
+	}
+	return code;
+}
+
+
+HERA_operand_role HERA_role(const HERA_insn &insn, int operand)
+{
+	if (HERA_register_number(insn.args[operand]) == 0 && HERA_temporary_number(insn.args[operand]) < 0)
+		return HERA_not_a_register;
+
+	static const std::vector<HERA_operand_role> def_use_use = {HERA_def, HERA_use, HERA_use}, def_use = {HERA_def, HERA_use};
+	static const std::vector<HERA_operand_role> use_use = {HERA_use, HERA_use}, def = {HERA_def}, use_def = {HERA_use_def};
+	static const std::vector<HERA_operand_role> load = {HERA_def, HERA_not_a_register, HERA_use};
+	static const std::vector<HERA_operand_role> store = {HERA_use, HERA_not_a_register, HERA_use};
+	const std::vector<HERA_operand_role> *roles;
+	switch (insn.op) {
+	case HERA_SET: case HERA_SETLO:                       roles = &def; break;
+	case HERA_SETHI: case HERA_INC: case HERA_DEC:        roles = &use_def; break;
+	case HERA_MOVE: case HERA_LSL: case HERA_LSR: case HERA_ASL: case HERA_ASR: case HERA_LSL8: case HERA_LSR8:
+	                                                      roles = &def_use; break;
+	case HERA_ADD: case HERA_SUB: case HERA_MUL: case HERA_AND: case HERA_OR: case HERA_XOR:
+	                                                      roles = &def_use_use; break;
+	case HERA_CMP: case HERA_CALL: case HERA_RETURN:      roles = &use_use; break;
+	case HERA_LOAD:                                       roles = &load; break;
+	case HERA_STORE:                                      roles = &store; break;
+	default:                                              return HERA_use_def;  // don't know this one, so assume the worst
+	}
+	if (operand >= int(roles->size())) return HERA_use_def;
+	return (*roles)[operand];
+}
+
+int HERA_previous_insn(const HERA_insns &code, int i)
+{
+	for (int j = i - 1; j >= 0; j--)
+		if (code[j].op != HERA_TEXT) return j;
+	return -1;
+}
+
+int HERA_next_insn(const HERA_insns &code, int i)
+{
+	for (int j = i + 1; j < int(code.size()); j++)
+		if (code[j].op != HERA_TEXT) return j;
+	return -1;
+}
+
+bool HERA_is_branch(const HERA_insn &insn)
+{
+	return insn.op >= HERA_BR && insn.op <= HERA_BNVR && insn.args.size() == 1;
+}
+
+bool HERA_is_unconditional(const HERA_insn &insn)
+{
+	return insn.op == HERA_BR || insn.op == HERA_BRR || insn.op == HERA_RETURN || insn.op == HERA_HALT;
+}
+
+bool HERA_reads_flags(const HERA_insn &insn)
+{
+	// (ADD and SUB can use the carry, but not after the CBON() at the start of the program)
+	return HERA_is_branch(insn) && insn.op != HERA_BR && insn.op != HERA_BRR;
+}
+
+bool HERA_sets_all_flags(const HERA_insn &insn)
+{
+	return insn.op == HERA_CMP || insn.op == HERA_ADD || insn.op == HERA_SUB || insn.op == HERA_INC || insn.op == HERA_DEC;
+}
+
+bool HERA_flags_dead_after(const HERA_insns &code, int i)
+{
+	for (int j = HERA_next_insn(code, i); j >= 0; j = HERA_next_insn(code, j)) {
+		if (HERA_reads_flags(code[j])) return false;
+		if (HERA_sets_all_flags(code[j]) || code[j].op == HERA_HALT) return true;
+		if (code[j].op == HERA_LABEL || HERA_is_branch(code[j]) || code[j].op == HERA_CALL || code[j].op == HERA_RETURN)
+			return false;  // we don't know where we'll be next
+	}
+	return false;
+}
+
+HERA_blocks HERA_find_blocks(const HERA_insns &code)
+{
+	HERA_blocks result;
+	int n = code.size();
+	std::vector<bool> leader(n + 1, false);
+	leader[0] = true;
+	for (int i = 0; i < n; i++) {
+		if (code[i].op == HERA_LABEL) leader[i] = true;
+		if (HERA_is_branch(code[i]) || HERA_is_unconditional(code[i])) leader[i + 1] = true;
+	}
+	std::vector<int> block_of(n);
+	for (int i = 0; i < n; i++) {
+		if (leader[i]) result.first.push_back(i);
+		block_of[i] = result.first.size() - 1;
+	}
+	result.first.push_back(n);
+
+	std::unordered_map<string, int> label_block;
+	for (int i = 0; i < n; i++)
+		if (code[i].op == HERA_LABEL && code[i].args.size() == 1)
+			label_block[code[i].args[0].name] = block_of[i];
+
+	result.successors.resize(result.count());
+	result.predecessors.resize(result.count());
+	for (int b = 0; b < result.count(); b++) {
+		int last = result.first[b + 1] - 1;
+		const HERA_insn &insn = code[last];
+		if (HERA_is_branch(insn) && insn.args.size() == 1 && insn.args[0].kind == HERA_operand::label) {
+			auto target = label_block.find(insn.args[0].name);
+			if (target != label_block.end())
+				result.successors[b].push_back(target->second);
+		}
+		if (!HERA_is_unconditional(insn) && b + 1 < result.count())
+			result.successors[b].push_back(b + 1);
+		for (int s : result.successors[b])
+			result.predecessors[s].push_back(b);
+	}
+	return result;
+}
+
+HERA_liveness HERA_find_liveness(const HERA_insns &code, const HERA_blocks &blocks,
+				 int how_many, const std::function<int(const HERA_operand &)> &number_of)
+{
+	int nb = blocks.count();
+	std::vector<HERA_variable_set> uses(nb, HERA_variable_set(how_many)), defs = uses;
+	for (int b = 0; b < nb; b++) {
+		for (int i = blocks.first[b]; i < blocks.first[b+1]; i++) {
+			for (unsigned j = 0; j < code[i].args.size(); j++) {  // a use after a def in the same block doesn't count
+				HERA_operand_role role = HERA_role(code[i], j);
+				int v = number_of(code[i].args[j]);
+				if (v >= 0 && (role == HERA_use || role == HERA_use_def) && !defs[b][v]) uses[b][v] = true;
+			}
+			for (unsigned j = 0; j < code[i].args.size(); j++) {
+				HERA_operand_role role = HERA_role(code[i], j);
+				int v = number_of(code[i].args[j]);
+				if (v >= 0 && (role == HERA_def || role == HERA_use_def)) defs[b][v] = true;
+			}
+		}
+	}
+
+	HERA_liveness result;
+	result.live_in.assign(nb, HERA_variable_set(how_many));
+	result.live_out = result.live_in;
+	for (bool changed = true; changed; ) {
+		changed = false;
+		for (int b = nb - 1; b >= 0; b--) {
+			HERA_variable_set out(how_many);
+			for (int s : blocks.successors[b])
+				for (int v = 0; v < how_many; v++)
+					if (result.live_in[s][v]) out[v] = true;
+			HERA_variable_set in = uses[b];
+			for (int v = 0; v < how_many; v++)
+				if (out[v] && !defs[b][v]) in[v] = true;
+			if (in != result.live_in[b] || out != result.live_out[b]) changed = true;
+			result.live_in[b] = in;
+			result.live_out[b] = out;
+		}
+	}
+	return result;
+}
@@ -0,0 +1,125 @@
+#if ! defined HERA_IR_H
+#define HERA_IR_H
+
+#include <vector>
+#include <functional>
+#include "util.h"
+#include "HERA_emitter.h"
+
+// A linear form of HERA code, so that passes like register allocation can work on it:
+//  one HERA_insn per instruction, in order, with the operation and its operands already
+//  taken apart. HERA_code builds these directly (see HERA_code.cpp), IR.h builds the IR
+//  for a whole program out of them, and HERA_write turns them into text at the very end.
+//
+// Comments and blank lines are HERA_insn's with op HERA_TEXT, that are copied to the output as is.
+
+enum HERA_op : unsigned char {
+	HERA_TEXT,  // not an instruction: "text" is copied to the output
+	HERA_SET, HERA_SETLO, HERA_SETHI, HERA_MOVE, HERA_ADD, HERA_SUB, HERA_MUL, HERA_AND, HERA_OR, HERA_XOR,
+	HERA_INC, HERA_DEC, HERA_LSL, HERA_LSR, HERA_ASL, HERA_ASR, HERA_LSL8, HERA_LSR8, HERA_CMP,
+	HERA_LOAD, HERA_STORE, HERA_LABEL, HERA_DLABEL, HERA_CALL, HERA_RETURN, HERA_HALT, HERA_CBON,
+	// the branches, to a label: BR first, and then the conditional ones
+	HERA_BR, HERA_BZ, HERA_BNZ, HERA_BL, HERA_BLE, HERA_BG, HERA_BGE, HERA_BULE, HERA_BUG,
+	HERA_BS, HERA_BNS, HERA_BC, HERA_BNC, HERA_BV, HERA_BNV,
+	// and the relative ones
+	HERA_BRR, HERA_BZR, HERA_BNZR, HERA_BLR, HERA_BLER, HERA_BGR, HERA_BGER, HERA_BULER, HERA_BUGR,
+	HERA_BSR, HERA_BNSR, HERA_BCR, HERA_BNCR, HERA_BVR, HERA_BNVR,
+	HERA_ops
+};
+const char *HERA_op_name(HERA_op op);                // e.g. "ADD"
+bool HERA_op_named(const string &name, HERA_op &op);  // the other way; false if it's not one of the above
+
+// An operand: a register (R0, R1, ...), one of the registers with a fixed job (Rt, FP_alt, PC_ret, FP, SP),
+//  a temporary (which stands for a value until register allocation picks a register for it; see IR.h),
+//  a number, or a label.
+//
+// The registers we number: R1 is 1, ... R10 is 10; anything above that is one of the
+//  R11, R12, ... that the result_reg numbering can run into for very big expressions,
+//  which are NOT the same as Rt, FP_alt, etc., but just more registers than we really have.
+struct HERA_operand {
+	enum kind_type : unsigned char { none, reg, fixed_reg, temporary, number, label };
+	kind_type kind = none;
+	int n = 0;     // the register's or temporary's number, or the number; for a fixed_reg, its real register (Rt is 11, ...)
+	string name;   // for a label
+
+	bool operator==(const HERA_operand &other) const = default;
+	bool is_number(int value) const { return kind == number && n == value; }
+	string __str__() const;  // as written in HERA, e.g. "R3", "FP_alt", "5", "my_string_1"; temporaries are "%t0", "%t1", ...
+};
+
+HERA_operand HERA_register(int number);
+HERA_operand HERA_number(int value);
+HERA_operand HERA_label(const string &label);
+HERA_operand HERA_temporary(int number);
+inline const HERA_operand HERA_Rt     = {HERA_operand::fixed_reg, 11};
+inline const HERA_operand HERA_FP_alt = {HERA_operand::fixed_reg, 12};
+inline const HERA_operand HERA_PC_ret = {HERA_operand::fixed_reg, 13};
+inline const HERA_operand HERA_FP     = {HERA_operand::fixed_reg, 14};
+inline const HERA_operand HERA_SP     = {HERA_operand::fixed_reg, 15};
+
+// R0, Rt, FP_alt, PC_ret, FP, and SP have fixed jobs, so HERA_register_number gives 0 for them,
+//  and also for operands that aren't registers at all; HERA_temporary_number gives -1 for anything
+//  that isn't a temporary.
+int HERA_register_number(const HERA_operand &operand);
+int HERA_temporary_number(const HERA_operand &operand);
+const int HERA_allocatable_registers = 10;  // R1 ... R10
+
+
+struct HERA_insn {
+	HERA_op op = HERA_TEXT;
+	std::vector<HERA_operand> args;  // e.g. R3, %t5, 5, FP_alt, my_string_1
+	string text;                     // for HERA_TEXT: the text to copy, including its newline(s)
+	int line = 0;                    // for HERA_TEXT: if not 0, a mark for the line of the Tiger program
+	                                 //  the code after it comes from, which has no text (see cost.h)
+
+	HERA_insn() {}
+	HERA_insn(HERA_op op, std::vector<HERA_operand> args) : op(op), args(std::move(args)) {}
+};
+typedef std::vector<HERA_insn> HERA_insns;
+
+HERA_insn HERA_text(const string &text);  // a comment, or blank line, with its newline
+
+void HERA_write(const HERA_insns &code, HERA_emitter &out);
+HERA_insns HERA_parse(const string &text);  // for code that was written out, e.g. to --cache-dir
+
+
+// What each operand of an instruction does with it, if it's a register or temporary
+enum HERA_operand_role { HERA_not_a_register, HERA_use, HERA_def, HERA_use_def };
+HERA_operand_role HERA_role(const HERA_insn &insn, int operand);
+
+// The instruction before or after code[i], skipping text (comments, etc.); -1 if there isn't one
+int HERA_previous_insn(const HERA_insns &code, int i);
+int HERA_next_insn(const HERA_insns &code, int i);
+
+bool HERA_is_branch(const HERA_insn &insn);          // BR, BZ, etc. (to a label)
+bool HERA_is_unconditional(const HERA_insn &insn);   // BR, RETURN, HALT: never goes on to the next instruction
+
+// The flags: which instructions look at them (conditional branches),
+//  and which set all four (Z, N, V, and C; others, like LOAD and MOVE, set only some)
+bool HERA_reads_flags(const HERA_insn &insn);
+bool HERA_sets_all_flags(const HERA_insn &insn);
+bool HERA_flags_dead_after(const HERA_insns &code, int i);  // are they set again after code[i], before anything could look?
+
+
+// Basic blocks of a HERA_insns, i.e., the control flow graph, for dataflow analysis:
+//  block b is instructions first[b] ... first[b+1]-1, and can be followed by the blocks in successors[b]
+//  (a branch to a label that's not in the code, e.g. to leave a function, has no successor)
+struct HERA_blocks {
+	std::vector<int> first;
+	std::vector<std::vector<int>> successors, predecessors;
+	int count() const { return int(first.size()) - 1; }
+};
+HERA_blocks HERA_find_blocks(const HERA_insns &code);
+
+
+// Which "variables" are live at the start and end of each block, where the variables are whatever
+//  number_of gives a number 0 ... how_many-1 for (e.g. HERA_register_number, or HERA_temporary_number),
+//  with -1 for operands that aren't variables
+typedef std::vector<bool> HERA_variable_set;
+struct HERA_liveness {
+	std::vector<HERA_variable_set> live_in, live_out;
+};
+HERA_liveness HERA_find_liveness(const HERA_insns &code, const HERA_blocks &blocks,
+				 int how_many, const std::function<int(const HERA_operand &)> &number_of);
+
+#endif
@@ -1,180 +1,373 @@
 #include "AST.h"
+#include "IR.h"
+#include "phases.h"
+#include "cost.h"
+#include "inline.h"
+#include "frames.h"
+#include "loops.h"
+#include <map>
 #include <hc_list.h>
 #include <hc_list_helpers.h>
 
 /*
- * HERA_code methods
+ * HERA_code methods: each adds its instructions to "out" (see HERA_IR.h)
  */
 
-const string indent_math = "    ";  // might want to use something different for, e.g., branches
+static void emit(HERA_insns &out, HERA_op op, std::vector<HERA_operand> args)
+{
+    out.push_back(HERA_insn(op, std::move(args)));
+}
 
+static void comment(HERA_insns &out, const string &text)  // copied to the output as "//text"
+{
+    out.push_back(HERA_text("//" + text + "\n"));
+}
 
-string AST_node_::HERA_code()  // Default used during development; could be removed in final version
+// for --cost-report: say which line of the program the code after this comes from
+//  (nodes the compiler made up have no position, so their code goes with the line before)
+static void mark_line(AST_node_ *node, HERA_insns &out)
+{
+    IR_program *program = IR_program::current();
+    if (program && program->mark_lines && node->pos().line() > 0) out.push_back(cost_line_mark(node->pos().line()));
+}
+
+
+void AST_node_::HERA_code(HERA_insns &out)  // Default used during development; could be removed in final version
 {
 	string message = "HERA_code() requested for AST node type not yet having a HERA_code() method";
 	EM_error(message);
-	return "#error " + message;  //if somehow we try to HERA-C-Run this, it will fail
+	out.push_back(HERA_text("#error " + message + "\n"));  //if somehow we try to HERA-C-Run this, it will fail
 }
 
 
-string A_root_::HERA_code()
+// Lower the whole program to the IR (see IR.h): the main program and each function
+//  are generated separately (A_fundec_::HERA_code adds each function to the current program),
+//  and then the small functions are inlined into their callers (see inline.h), loops are optimized
+//  (see loops.h), and calls and functions leave out what they don't need of their frames (see frames.h)
+void A_root_::lower_to_IR(IR_program &program)
 {
-	return  "#include \"Tiger-stdlib-stack-data.hera\"\n\n" + main_expr->HERA_data() +"CBON()\n\n" + main_expr->HERA_code();  // was SETCB for HERA 2.3
+	IR_program::set_current(&program);
+	phase_start("HERA_data");
+	main_expr->HERA_data(program.data);
+
+	phase_start("HERA_code");
+	HERA_insns main_code;
+	mark_line(main_expr, main_code);
+	main_expr->HERA_code(main_code);
+	program.main = IR_function_from_HERA("", 0, spill_slots(), main_code);
+	IR_inline_small_functions(program);
+	IR_optimize_loops(program);
+	IR_trim_frames(program);
+	if (static_links_cached()) IR_cache_static_links(program);
+	IR_program::set_current(0);
 }
 
 
 
-string A_intExp_::HERA_code()
+void A_intExp_::HERA_code(HERA_insns &out)
 {
-	return indent_math + "SET(" + result_reg_s() + ", " + str(value) +")\n";
+	emit(out, HERA_SET, {result_register(), HERA_number(value)});
 }
 
-string A_boolExp_::HERA_code()
+void A_boolExp_::HERA_code(HERA_insns &out)
 {
-    return indent_math + "SET(" + result_reg_s() + ", " + (value == true ? '1' : '0') +")\n";
+    emit(out, HERA_SET, {result_register(), HERA_number(value == true ? 1 : 0)});
 }
 
-string A_stringExp_::HERA_code()
+void A_stringExp_::HERA_code(HERA_insns &out)
 {
-    string my_code;
-    my_code += "SET("+this->result_reg_s()+", "+this->result_dlabel()+")\n";
-
-    return my_code;
+    emit(out, HERA_SET, {this->result_register(), HERA_label(this->result_dlabel())});
 }
 
 
 
-static string HERA_math_op(Position p, A_oper op) // needed for opExp
+static HERA_op HERA_math_op(Position p, A_oper op) // needed for opExp
 {
 	switch (op) {
 	case A_plusOp:
-		return "ADD";
+		return HERA_ADD;
     case A_minusOp:
-        return "SUB";
+        return HERA_SUB;
 	case A_timesOp:
-		return "MUL";	// was MULT for HERA 2.3
+		return HERA_MUL;	// was MULT for HERA 2.3
     case A_eqOp:
-        return "BZ";
+        return HERA_BZ;
     case A_geOp:
-        return "BGE";
+        return HERA_BGE;
     case A_gtOp:
-        return "BG";
+        return HERA_BG;
     case A_leOp:
-        return "BLE";
+        return HERA_BLE;
     case A_ltOp:
-        return "BL";
+        return HERA_BL;
     case A_neqOp:
-        return "BNZ";
+        return HERA_BNZ;
 	default:
 		EM_error("Unhandled case in HERA_math_op", false, p);
-		return "Oops_unhandled_hera_math_op";
+		return HERA_TEXT;
 	}
 }
-string A_condExp_::HERA_code()
+
+// the branch that goes when the one HERA_math_op gives wouldn't
+static HERA_op HERA_negated_branch(HERA_op branch)
 {
+    switch (branch) {
+    case HERA_BZ:  return HERA_BNZ;
+    case HERA_BNZ: return HERA_BZ;
+    case HERA_BL:  return HERA_BGE;
+    case HERA_BGE: return HERA_BL;
+    case HERA_BG:  return HERA_BLE;
+    case HERA_BLE: return HERA_BG;
+    default:       return branch;  // (HERA_math_op already complained)
+    }
+}
 
-    string left_side = _left->HERA_code();
-    string right_side = _right->HERA_code();
+// Jumping code: an expression that isn't a comparison (or & or |) is tested against 0
+void A_exp_::HERA_branch(HERA_insns &out, const string &label, bool when)
+{
+    if (this->has_constant_value()) {  // it always goes, or never does
+        if ((this->constant_value() != 0) == when) emit(out, HERA_BR, {HERA_label(label)});
+        return;
+    }
+    this->HERA_code(out);
+    emit(out, HERA_CMP, {this->result_register(), HERA_register(0)});
+    emit(out, when ? HERA_BNZ : HERA_BZ, {HERA_label(label)});
+}
 
-    string pre_build;
-    string my_code;
+void A_condExp_::HERA_compare(HERA_insns &out)
+{
     Ty_ty left_type = _left->typecheck();
 
-    if(left_type == Ty_Int()) {
-
-        if (_left->result_reg() >= _right->result_reg()) {
-            pre_build =
-                    left_side + indent_math + "MOVE(" + this->result_reg_s() + ", " + _left->result_reg_s() +
-                    ")\n" + right_side;
-
-            my_code = indent_math + ("CMP(" +
-                    this->result_reg_s() + ", " +
-                                     _right->result_reg_s() + ")\n");
-        } else {
-            pre_build = right_side + indent_math + left_side;
-
-            my_code = indent_math + ("CMP(" +
-                                     _left->result_reg_s() + ", "
-                                      + this->result_reg_s() + ")\n\n");
-        }
-        my_code += HERA_math_op(pos(), _oper) + "(" + this->branch_label_true() + ")\n";
+    if (left_type == Ty_String()) {  // (= and <> are done in HERA_string_equality)
+        HERA_operand left, right;
+        HERA_string_operands(out, left, right);
+        comment(out, "compare strings, with tstrcmp");
+        emit(out, HERA_MOVE, {HERA_FP_alt, HERA_SP});
+        emit(out, HERA_INC, {HERA_SP, HERA_number(5)});
+        emit(out, HERA_STORE, {left, HERA_number(3), HERA_FP_alt});
+        emit(out, HERA_STORE, {right, HERA_number(4), HERA_FP_alt});
+        emit(out, HERA_CALL, {HERA_FP_alt, HERA_label("tstrcmp")});
+        emit(out, HERA_LOAD, {this->result_register(), HERA_number(3), HERA_FP_alt});
+        emit(out, HERA_DEC, {HERA_SP, HERA_number(5)});
+        emit(out, HERA_CMP, {this->result_register(), HERA_register(0)});  // it returns neg # if a < b, 0 if =, pos # if a > b
+        return;
+    }
 
-    } else if (left_type == Ty_String()){
-        //A_ExpList(_left, A_ExpList(_right, 0))
-        Symbol lname = to_Symbol("!callleft"+str(this->my_unique_num()));
-        Symbol rname = to_Symbol("!callright"+str(this->my_unique_num()));
-        A_letExp_ my_call = A_letExp_(Position::undefined(), A_DecList(A_VarDec(Position::undefined(), lname,
-                                                                                  to_Symbol("string"), _left),
-                                                                       A_DecList(A_VarDec(Position::undefined(), rname, to_Symbol("string"), _right), 0)),
-                                      A_CallExp(Position::undefined(), to_Symbol("tstrcmp"), A_ExpList(A_VarExp(Position::undefined(), A_SimpleVar(Position::undefined(), lname)),
-                                                                                                        A_ExpList(A_VarExp(Position::undefined(), A_SimpleVar(Position::undefined(), rname)), 0))));
+    // ints, and bools, and records and arrays (which are the same if they're at the same address)
+    if (_left->result_reg() >= _right->result_reg()) {
+        _left->HERA_code(out);
+        emit(out, HERA_MOVE, {this->result_register(), _left->result_register()});
+        _right->HERA_code(out);
 
-        my_call.set_parent_pointers_for_me_and_my_descendants(this);
-//        A_callExp_ my_call = A_callExp_(Position::undefined(), to_Symbol("tstrcmp"), A_ExpList(_left, A_ExpList(_right, 0)));
-        my_code += my_call.HERA_code();
-//        my_code += "LOAD("+this->result_reg_s()+", "+str(this->result_fp_plus())+", FP)";
-        my_code += "CMP("+my_call.result_reg_s()+", R0)\n";
-        //returns neg # if a < b, 0 if =, pos # if a > b
-        my_code += HERA_math_op(pos(), _oper) + "(" + this->branch_label_true() + ")\n";
+        emit(out, HERA_CMP, {this->result_register(), _right->result_register()});
+    } else {
+        _right->HERA_code(out);
+        _left->HERA_code(out);
 
+        emit(out, HERA_CMP, {_left->result_register(), this->result_register()});
+    }
+}
 
+// Both strings, in registers we can change: this expression's and the other operand's
+void A_condExp_::HERA_string_operands(HERA_insns &out, HERA_operand &left, HERA_operand &right)
+{
+    if (_left->result_reg() >= _right->result_reg()) {
+        _left->HERA_code(out);
+        emit(out, HERA_MOVE, {this->result_register(), _left->result_register()});
+        _right->HERA_code(out);
+        left = this->result_register(), right = _right->result_register();
+    } else {
+        _right->HERA_code(out);
+        emit(out, HERA_MOVE, {this->result_register(), _right->result_register()});
+        _left->HERA_code(out);
+        left = _left->result_register(), right = this->result_register();
     }
+}
 
-    my_code += "SET(" + this->result_reg_s() + ", 0)\n";
-    my_code += "BR(" + this->branch_label_end() + ")\n";
-    my_code += "LABEL(" + this->branch_label_true() + ")\n";
-    my_code += "SET(" + this->result_reg_s() + ", 1)\n";
-    my_code += "LABEL(" + this->branch_label_end() + ")\n";
+// s = t and s <> t, without a CALL: the same address is the same string; otherwise, the lengths
+//  (in the word each string starts with) have to match, and then each character, up to the first that doesn't.
+//  Besides the strings, it uses three of the other registers up to result_reg (see init_result_reg)
+void A_condExp_::HERA_string_equality(HERA_insns &out, const string &label, bool when)
+{
+    precondition(this->might_compare_strings() && this->result_reg() >= 5);
+    HERA_operand s, t;
+    HERA_string_operands(out, s, t);
+    std::vector<HERA_operand> free;
+    for (int r = 1; r <= this->result_reg() && free.size() < 3; r++)
+        if (HERA_register(r) != s && HERA_register(r) != t) free.push_back(HERA_register(r));
+    const HERA_operand &n = free[0], &a = free[1], &b = free[2];
+    bool on_equal = (_oper == A_eqOp) == when;  // which way goes to "label"
+    HERA_operand equal = HERA_label(on_equal ? label : this->branch_label_skip());
+    HERA_operand different = HERA_label(on_equal ? this->branch_label_skip() : label);
+    HERA_operand loop = HERA_label(this->branch_label_loop()), zero = HERA_number(0), one = HERA_number(1);
+
+    comment(out, "compare strings, without a CALL");
+    emit(out, HERA_CMP, {s, t});
+    emit(out, HERA_BZ, {equal});
+    emit(out, HERA_LOAD, {n, zero, s});
+    emit(out, HERA_LOAD, {a, zero, t});
+    emit(out, HERA_CMP, {n, a});
+    emit(out, HERA_BNZ, {different});
+    emit(out, HERA_CMP, {n, HERA_register(0)});
+    emit(out, HERA_BZ, {equal});
+    emit(out, HERA_LABEL, {loop});
+    emit(out, HERA_INC, {s, one});
+    emit(out, HERA_INC, {t, one});
+    emit(out, HERA_LOAD, {a, zero, s});
+    emit(out, HERA_LOAD, {b, zero, t});
+    emit(out, HERA_CMP, {a, b});
+    emit(out, HERA_BNZ, {different});
+    emit(out, HERA_DEC, {n, one});
+    emit(out, HERA_BNZ, {loop});
+    if (on_equal) emit(out, HERA_BR, {HERA_label(label)});
+    emit(out, HERA_LABEL, {HERA_label(this->branch_label_skip())});
+}
 
-    return pre_build + my_code;
+void A_condExp_::HERA_branch(HERA_insns &out, const string &label, bool when)
+{
+    if (this->has_constant_value()) {
+        A_exp_::HERA_branch(out, label, when);
+        return;
+    }
+    if (_left->typecheck() == Ty_String() && (_oper == A_eqOp || _oper == A_neqOp)) {
+        HERA_string_equality(out, label, when);
+        return;
+    }
+    HERA_compare(out);
+    HERA_op branch = HERA_math_op(pos(), _oper);
+    emit(out, when ? branch : HERA_negated_branch(branch), {HERA_label(label)});
 }
 
-string A_arithExp_::HERA_code()
+void A_condExp_::HERA_code(HERA_insns &out)
 {
+    if (this->has_constant_value()) {  // see constant_fold.cpp
+        emit(out, HERA_SET, {this->result_register(), HERA_number(this->constant_value())});
+        return;
+    }
 
-    string left_side = _left->HERA_code();
-    string right_side = _right->HERA_code();
+    HERA_branch(out, this->branch_label_true(), true);
+    emit(out, HERA_SET, {this->result_register(), HERA_number(0)});
+    emit(out, HERA_BR, {HERA_label(this->branch_label_end())});
+    emit(out, HERA_LABEL, {HERA_label(this->branch_label_true())});
+    emit(out, HERA_SET, {this->result_register(), HERA_number(1)});
+    emit(out, HERA_LABEL, {HERA_label(this->branch_label_end())});
+}
 
-    string pre_build;
-    string my_code;
+void A_arithExp_::HERA_code(HERA_insns &out)
+{
+    // see constant_fold.cpp for these first three
+    if (this->has_constant_value()) {
+        emit(out, HERA_SET, {this->result_register(), HERA_number(this->constant_value())});
+        return;
+    }
+    if (A_exp x = this->identity_operand()) {
+        x->HERA_code(out);
+        emit(out, HERA_MOVE, {this->result_register(), x->result_register()});
+        return;
+    }
+    if (_oper == A_timesOp && (_left->has_constant_value() || _right->has_constant_value())) {
+        A_exp x = _right->has_constant_value() ? _left : _right;  // x*2 or 2*x is just a shift
+        A_exp two = x == _left ? _right : _left;
+        if (two->constant_value() == 2) {
+            x->HERA_code(out);
+            emit(out, HERA_LSL, {this->result_register(), x->result_register()});
+            return;
+        }
+    }
 
     if (_left->result_reg() >= _right->result_reg()){
-        pre_build = left_side + indent_math + "MOVE("+this->result_reg_s()+", "+_left->result_reg_s()+")\n" + right_side;
+        _left->HERA_code(out);
+        emit(out, HERA_MOVE, {this->result_register(), _left->result_register()});
+        _right->HERA_code(out);
 
-        my_code = indent_math + (HERA_math_op(pos(), _oper) + "(" +
-                                 this->result_reg_s() + ", " +
-                                 this->result_reg_s()+", " +
-                                 _right->result_reg_s() + ")\n\n");
+        emit(out, HERA_math_op(pos(), _oper), {this->result_register(), this->result_register(), _right->result_register()});
     } else {
-        pre_build = right_side + indent_math + left_side;
+        _right->HERA_code(out);
+        _left->HERA_code(out);
 
-        my_code = indent_math + (HERA_math_op(pos(), _oper) + "(" +
-                                 this->result_reg_s() + ", " +
-                                 _left->result_reg_s() + ", " +
-                                 this->result_reg_s()+")\n\n");
+        emit(out, HERA_math_op(pos(), _oper), {this->result_register(), _left->result_register(), this->result_register()});
     }
-
-    return pre_build + my_code;
 }
 
-string A_callExp_::HERA_code()
+// The library routines that are only a few instructions in Tiger-stdlib-stack.hera are done right at the call,
+//  on the register their argument is in, with no frame or CALL (chr still CALLs malloc, for its string)
+enum intrinsic { intrinsic_not, intrinsic_ord, intrinsic_size, intrinsic_chr };
+static const std::map<string, intrinsic> intrinsics = {
+    {"not", intrinsic_not}, {"ord", intrinsic_ord}, {"size", intrinsic_size}, {"chr", intrinsic_chr},
+};
+
+void A_callExp_::HERA_intrinsic_code(int which, HERA_insns &out)
 {
+    A_exp arg = _args->_head;
+    HERA_operand result = this->result_register();  // (a higher register than arg's)
+    arg->HERA_code(out);
+    comment(out, str(_func) + ", without a CALL");
+    switch (which) {
+    case intrinsic_not:
+        emit(out, HERA_SET, {result, HERA_number(0)});
+        emit(out, HERA_CMP, {arg->result_register(), HERA_register(0)});
+        emit(out, HERA_BNZ, {HERA_label(this->branch_label_end())});
+        emit(out, HERA_SET, {result, HERA_number(1)});
+        emit(out, HERA_LABEL, {HERA_label(this->branch_label_end())});
+        break;
+    case intrinsic_ord:
+        emit(out, HERA_LOAD, {result, HERA_number(1), arg->result_register()});  // the first character
+        break;
+    case intrinsic_size:
+        emit(out, HERA_LOAD, {result, HERA_number(0), arg->result_register()});
+        break;
+    case intrinsic_chr:  // malloc(2), then the length and the character
+        emit(out, HERA_MOVE, {HERA_FP_alt, HERA_SP});
+        emit(out, HERA_INC, {HERA_SP, HERA_number(4)});
+        emit(out, HERA_SET, {HERA_Rt, HERA_number(2)});
+        emit(out, HERA_STORE, {HERA_Rt, HERA_number(3), HERA_FP_alt});
+        emit(out, HERA_CALL, {HERA_FP_alt, HERA_label("malloc")});
+        emit(out, HERA_LOAD, {HERA_Rt, HERA_number(3), HERA_FP_alt});
+        emit(out, HERA_DEC, {HERA_SP, HERA_number(4)});
+        emit(out, HERA_STORE, {arg->result_register(), HERA_number(1), HERA_Rt});
+        emit(out, HERA_MOVE, {result, HERA_Rt});
+        emit(out, HERA_SET, {HERA_Rt, HERA_number(1)});
+        emit(out, HERA_STORE, {HERA_Rt, HERA_number(0), result});
+        break;
+    }
+}
 
-    string my_code;
-    function_type_info my_func = find_local_functions(_func);
+void A_callExp_::HERA_code(HERA_insns &out)
+{
+    function_type_info my_func = this->binding().info;
+    auto intrinsic = my_func.unique_id == "" ? intrinsics.find(str(_func)) : intrinsics.end();  // (not the program's own functions)
+    if (intrinsic != intrinsics.end()) {
+        HERA_intrinsic_code(intrinsic->second, out);
+        return;
+    }
 
     int starting_frame_size = 3;
     int stack_pointer = starting_frame_size;
 
-    int increment_size = starting_frame_size;
-    if (!_args->_head->null_input()) increment_size = increment_size+_args->length();
-    my_code += "MOVE(FP_alt, SP)\nINC(SP, "+str(increment_size)+")\n//set static link for "+str(_func)+" \nSET("+this->result_reg_s()+", "+str(my_func.fp)+")\nSTORE("+this->result_reg_s()+", 2, FP_alt)\n";
+    // one slot for each argument, or one for the result if there are none (see layout_frames.cpp);
+    //  _args->length() is 1 for a call with no arguments, too
+    int increment_size = starting_frame_size + _args->length();
+    emit(out, HERA_MOVE, {HERA_FP_alt, HERA_SP});
+    emit(out, HERA_INC, {HERA_SP, HERA_number(increment_size)});
+    if (my_func.unique_id != "") {  // the library never looks at its static link
+        // the frame of the function _func was declared in, which is ours or one we get to by static links
+        int links = this->result_frames() - (my_func.frame - 1);
+        comment(out, "set static link for " + str(_func));
+        if (links == 0) {
+            emit(out, HERA_MOVE, {this->result_register(), HERA_FP});
+        } else {
+            emit(out, HERA_LOAD, {this->result_register(), HERA_number(2), HERA_FP});
+            for (int i = 1; i < links; i++)
+                emit(out, HERA_LOAD, {this->result_register(), HERA_number(2), this->result_register()});
+        }
+        emit(out, HERA_STORE, {this->result_register(), HERA_number(2), HERA_FP_alt});
+    }
 
     A_expList my_pointer = _args;
     while (true && !_args->_head->null_input()) {
 
-        my_code += my_pointer->_head->HERA_code();
-        my_code += "STORE("+my_pointer->_head->result_reg_s()+", "+str(stack_pointer)+", FP_alt) \n";
+        my_pointer->_head->HERA_code(out);
+        emit(out, HERA_STORE, {my_pointer->_head->result_register(), HERA_number(stack_pointer), HERA_FP_alt});
         stack_pointer += 1;
 
         if (my_pointer->_tail == 0) break;
@@ -182,240 +375,263 @@ string A_callExp_::HERA_code()
 
     }
 
-    my_code += "CALL(FP_alt, "+Symbol_to_string(_func)+my_func.unique_id+")\nLOAD("+this->result_reg_s()+", 3, FP_alt)\nDEC(SP, "+str(_args->length()+starting_frame_size)+") \n\n";
-
-    return my_code;
+    emit(out, HERA_CALL, {HERA_FP_alt, HERA_label(Symbol_to_string(_func) + my_func.unique_id)});
+    emit(out, HERA_LOAD, {this->result_register(), HERA_number(3), HERA_FP_alt});
+    emit(out, HERA_DEC, {HERA_SP, HERA_number(increment_size)});
 }
 
-string A_seqExp_::HERA_code()
+void A_seqExp_::HERA_code(HERA_insns &out)
 {
     A_expList my_pointer = _seq;
-    string last_reg = "";
+    HERA_operand last_reg;
     while (true) {
-        last_reg = my_pointer->_head->result_reg_s();
+        last_reg = my_pointer->_head->result_register();
 
         if (my_pointer->_tail == 0) break;
         my_pointer = my_pointer->_tail;
     }
 
-    return _seq->HERA_code() + "MOVE("+this->result_reg_s()+", "+last_reg+")\n";
+    _seq->HERA_code(out);
+    emit(out, HERA_MOVE, {this->result_register(), last_reg});
 }
 
-string A_expList_::HERA_code()
+void A_expList_::HERA_code(HERA_insns &out)
 {
-    string my_code;
-    my_code += _head->HERA_code();
+    mark_line(_head, out);
+    _head->HERA_code(out);
 
     if (_tail != 0){
-        my_code += _tail->HERA_code();
+        _tail->HERA_code(out);
     }
-    return my_code;
 }
 
-string A_decList_::HERA_code()
+void A_decList_::HERA_code(HERA_insns &out)
 {
-    string my_code;
-    my_code += _head->HERA_code();
+    mark_line(_head, out);
+    _head->HERA_code(out);
 
     if (_tail != 0){
-        my_code += _tail->HERA_code();
+        _tail->HERA_code(out);
     }
-    return my_code;
 }
 
-string A_fundecList_::HERA_code()
+void A_fundecList_::HERA_code(HERA_insns &out)
 {
-    string my_code;
-    my_code += _head->HERA_code();
+    _head->HERA_code(out);
 
     if (_tail != 0){
-        my_code += _tail->HERA_code();
+        _tail->HERA_code(out);
     }
-    return my_code;
 }
 
-string A_fieldList_::HERA_code()
+void A_fieldList_::HERA_code(HERA_insns &out)
 {
-    string my_code;
-    my_code += _head->HERA_code();
+    _head->HERA_code(out);
 
     if (_tail != 0){
-        my_code += _tail->HERA_code();
+        _tail->HERA_code(out);
     }
-    return my_code;
 }
 
-string A_field_::HERA_code() {
-    return "";
+void A_field_::HERA_code(HERA_insns &out) {
 }
 
-string A_ifExp_::HERA_code()
+void A_ifExp_::HERA_code(HERA_insns &out)
 {
-    string test_cond = _test->HERA_code() + "\nCMP(" + _test->result_reg_s() + ", R0)" + "\nBZ(" + this->branch_label_else() + ")\n";
-    string then_clause = "\nLABEL(" + this->branch_label_then() + ")\n" +  _then->HERA_code() + "\nMOVE(" + this->result_reg_s() + ", " + _then->result_reg_s() + ")\n" + "BR(" + this->branch_label_post_if() + ")\n";
-
-    string else_clause = "\nLABEL(" + this->branch_label_else() + ")\n";
-    if (_else_or_null != 0){
-        else_clause += _else_or_null->HERA_code() + "\nMOVE(" + this->result_reg_s() + ", " + _else_or_null->result_reg_s() + ")\n";
+    if (_test->has_constant_value()) {  // only one branch can happen, so there's nothing to test
+        A_exp taken = _test->constant_value() ? _then : _else_or_null;
+        if (taken != 0) {
+            taken->HERA_code(out);
+            emit(out, HERA_MOVE, {this->result_register(), taken->result_register()});
+        }
+        return;
     }
-    else_clause += "\nBR(" + this->branch_label_post_if() + ")\n";
 
-    return test_cond + then_clause + else_clause + "LABEL(" + this->branch_label_post_if() + ")\n";
-}
+    _test->HERA_branch(out, this->branch_label_else(), false);
 
-string A_whileExp_::HERA_code() {
-    string my_code;
-    my_code += "LABEL("+this->branch_label_cond()+")\n";
-    my_code += _cond->HERA_code() + "\n";
-    my_code += "CMP("+_cond->result_reg_s()+", R0)\n";
-    my_code += "BZ("+this->branch_label_post()+")\n";
+    emit(out, HERA_LABEL, {HERA_label(this->branch_label_then())});
+    _then->HERA_code(out);
+    emit(out, HERA_MOVE, {this->result_register(), _then->result_register()});
+    emit(out, HERA_BR, {HERA_label(this->branch_label_post_if())});
 
-    my_code += _body->HERA_code()  + "\n";
-    my_code += "BR("+this->branch_label_cond()+")\n";
-    my_code += "LABEL("+this->branch_label_post()+")\n";
+    emit(out, HERA_LABEL, {HERA_label(this->branch_label_else())});
+    if (_else_or_null != 0){
+        _else_or_null->HERA_code(out);
+        emit(out, HERA_MOVE, {this->result_register(), _else_or_null->result_register()});
+    }
+    emit(out, HERA_BR, {HERA_label(this->branch_label_post_if())});
 
-    return my_code;
+    emit(out, HERA_LABEL, {HERA_label(this->branch_label_post_if())});
 }
 
-string A_breakExp_::HERA_code() {
-    return "BR("+ this->break_label() +")\n";
+// "a & b" is "if a then b else 0", and "a | b" is "if a then 1 else b" (see tiger-grammar.yy),
+//  so for those, one side goes right to "label" or past the rest, with no 0 or 1 in between
+void A_ifExp_::HERA_branch(HERA_insns &out, const string &label, bool when)
+{
+    if (_else_or_null == 0) {  // (no value to test)
+        A_exp_::HERA_branch(out, label, when);
+        return;
+    }
+    if (_test->has_constant_value()) {
+        (_test->constant_value() ? _then : _else_or_null)->HERA_branch(out, label, when);
+        return;
+    }
+    string skip = this->branch_label_post_if();
+    if (_else_or_null->has_constant_value()) {  // &
+        bool goes = (_else_or_null->constant_value() != 0) == when;
+        _test->HERA_branch(out, goes ? label : skip, false);
+        _then->HERA_branch(out, label, when);
+        if (!goes) emit(out, HERA_LABEL, {HERA_label(skip)});
+    } else if (_then->has_constant_value()) {  // |
+        bool goes = (_then->constant_value() != 0) == when;
+        _test->HERA_branch(out, goes ? label : skip, true);
+        _else_or_null->HERA_branch(out, label, when);
+        if (!goes) emit(out, HERA_LABEL, {HERA_label(skip)});
+    } else {
+        _test->HERA_branch(out, this->branch_label_else(), false);
+        _then->HERA_branch(out, label, when);
+        emit(out, HERA_BR, {HERA_label(skip)});
+        emit(out, HERA_LABEL, {HERA_label(this->branch_label_else())});
+        _else_or_null->HERA_branch(out, label, when);
+        emit(out, HERA_LABEL, {HERA_label(skip)});
+    }
 }
 
-string A_forExp_::HERA_code() {
-    string my_code;
+void A_whileExp_::HERA_code(HERA_insns &out) {
+    if (_cond->has_constant_value() && _cond->constant_value() == 0) return;  // never runs
 
-    int starting_frame_size = 1;
-    int stack_pointer = this->result_fp_plus();
-
-    my_code += "// for loop\n";
-    my_code += _lo->HERA_code();
-    my_code += "INC(SP, "+str(starting_frame_size)+")\n";
-    my_code += "STORE("+_lo->result_reg_s()+", "+str(stack_pointer)+", FP) \n\n";
-    my_code +=  _hi->HERA_code() + "\n";
-    my_code += "MOVE("+this->result_reg_s()+", "+_hi->result_reg_s()+")\n";
-    my_code += "LABEL("+this->branch_label_cond()+")\n";
-    my_code += "LOAD(R"+ str(this->result_reg()-1) +", "+str(stack_pointer)+", FP)\n";
-    my_code += "CMP(R"+str(this->result_reg()-1)+", "+this->result_reg_s()+")\n";
-    my_code += "BG("+this->branch_label_post()+")\n";
+    emit(out, HERA_LABEL, {HERA_label(this->branch_label_cond())});
+    if (!_cond->has_constant_value()) {  // otherwise, it only stops with "break"
+        _cond->HERA_branch(out, this->branch_label_post(), false);
+    }
 
-    my_code += _body->HERA_code() + "\n";
+    _body->HERA_code(out);
+    emit(out, HERA_BR, {HERA_label(this->branch_label_cond())});
+    emit(out, HERA_LABEL, {HERA_label(this->branch_label_post())});
+}
 
-    my_code += "LOAD(R"+ str(this->result_reg()-1) +", "+str(stack_pointer)+", FP)\n";
-    my_code += "INC(R"+ str(this->result_reg()-1) +", 1)\n";
-    my_code += "STORE(R"+ str(this->result_reg()-1) +", "+str(stack_pointer)+", FP) \n\n";
-    my_code += "BR("+this->branch_label_cond()+")\n";
-    my_code += "LABEL("+this->branch_label_post()+")\n";
-    my_code += "DEC(SP, "+str(starting_frame_size)+")\n";
+void A_breakExp_::HERA_code(HERA_insns &out) {
+    emit(out, HERA_BR, {HERA_label(this->break_label())});
+}
 
-    return my_code;
+void A_forExp_::HERA_code(HERA_insns &out) {
+    int starting_frame_size = 1;
+    HERA_operand i = HERA_number(this->result_fp_plus());
+    HERA_operand counter = HERA_register(this->result_reg()-1);
+
+    comment(out, " for loop");
+    _lo->HERA_code(out);
+    emit(out, HERA_INC, {HERA_SP, HERA_number(starting_frame_size)});
+    emit(out, HERA_STORE, {_lo->result_register(), i, HERA_FP});
+    _hi->HERA_code(out);
+    emit(out, HERA_MOVE, {this->result_register(), _hi->result_register()});
+    emit(out, HERA_LABEL, {HERA_label(this->branch_label_cond())});
+    emit(out, HERA_LOAD, {counter, i, HERA_FP});
+    emit(out, HERA_CMP, {counter, this->result_register()});
+    emit(out, HERA_BG, {HERA_label(this->branch_label_post())});
+
+    _body->HERA_code(out);
+
+    emit(out, HERA_LOAD, {counter, i, HERA_FP});
+    emit(out, HERA_INC, {counter, HERA_number(1)});
+    emit(out, HERA_STORE, {counter, i, HERA_FP});
+    emit(out, HERA_BR, {HERA_label(this->branch_label_cond())});
+    emit(out, HERA_LABEL, {HERA_label(this->branch_label_post())});
+    emit(out, HERA_DEC, {HERA_SP, HERA_number(starting_frame_size)});
 }
 
-string A_varExp_::HERA_code() {
-    return _var->HERA_code();
+void A_varExp_::HERA_code(HERA_insns &out) {
+    _var->HERA_code(out);
 }
 
-string A_simpleVar_::HERA_code() {
-    int var_frame = this->find_local_variables_frames(_sym, this->result_fp_plus());
+void A_simpleVar_::HERA_code(HERA_insns &out) {
+    int var_frame = this->binding().info.frames;
+    HERA_operand fp_plus = HERA_number(this->binding().info.fp_plus);
     if (this->result_frames() != var_frame) {
-        string my_code = "//load "+str(_sym)+" from mem (frame: "+str(var_frame)+")\n";
+        comment(out, "load " + str(_sym) + " from mem (frame: " + str(var_frame) + ")");
 
-        my_code += "LOAD(Rt, 2, FP)\n";
+        emit(out, HERA_LOAD, {HERA_Rt, HERA_number(2), HERA_FP});
         for (int i = 0; i < this->result_frames()-var_frame-1; i++) {
-            my_code += "LOAD(Rt, 2, Rt)\n";
+            emit(out, HERA_LOAD, {HERA_Rt, HERA_number(2), HERA_Rt});
         }
 
-        my_code += "LOAD("+ this->result_reg_s()+", "+str(this->get_offest())+", Rt)\n";
-        return my_code;
+        emit(out, HERA_LOAD, {this->result_register(), fp_plus, HERA_Rt});
+        return;
     }
-    return "//load "+str(_sym)+" from mem\nLOAD("+ this->result_reg_s()+", "+str(this->get_offest())+", FP)\n";
+    comment(out, "load " + str(_sym) + " from mem");
+    emit(out, HERA_LOAD, {this->result_register(), fp_plus, HERA_FP});
 };
 
-string A_assignExp_::HERA_code() {
-    string my_code;
-
-    my_code += _exp->HERA_code();
-    my_code += _var->HERA_assign();
-
-    return my_code;
+void A_assignExp_::HERA_code(HERA_insns &out) {
+    _exp->HERA_code(out);
+    _var->HERA_assign(out);
 }
 
-string A_simpleVar_::HERA_assign() {
-    int var_frame = this->find_local_variables_frames(_sym, this->result_fp_plus());
+void A_simpleVar_::HERA_assign(HERA_insns &out) {
+    int var_frame = this->binding().info.frames;
+    HERA_operand fp_plus = HERA_number(this->binding().info.fp_plus);
     if (this->result_frames() != var_frame) {
-        string my_code = "//assign "+str(_sym)+" from mem (frame: "+str(var_frame)+")\n";
+        comment(out, "assign " + str(_sym) + " from mem (frame: " + str(var_frame) + ")");
 
-        my_code += "LOAD(Rt, 2, FP)\n";
+        emit(out, HERA_LOAD, {HERA_Rt, HERA_number(2), HERA_FP});
         for (int i = 0; i < this->result_frames()-var_frame-1; i++) {
-            my_code += "LOAD(Rt, 2, Rt)\n";
+            emit(out, HERA_LOAD, {HERA_Rt, HERA_number(2), HERA_Rt});
         }
-        my_code += "STORE(R"+ str(parent()->result_reg())+", "+str(this->get_offest())+", Rt)\n";
-        return my_code;
+        emit(out, HERA_STORE, {HERA_register(parent()->result_reg()), fp_plus, HERA_Rt});
+        return;
     }
 
-    return "//assign "+str(_sym)+"\n STORE(R"+str(parent()->result_reg())+", "+str(this->get_offest())+", FP)\n";
+    comment(out, "assign " + str(_sym));
+    emit(out, HERA_STORE, {HERA_register(parent()->result_reg()), fp_plus, HERA_FP});
 }
-string A_letExp_::HERA_code() {
-    string my_code;
+void A_letExp_::HERA_code(HERA_insns &out) {
     int dec_amount = this->let_fp_plus_total();
 
-    my_code += _decs->HERA_code();
-    my_code += _body->HERA_code();
+    _decs->HERA_code(out);
+    _body->HERA_code(out);
 
     // rescure kludge
     if (_decs->result_reg() > _body->result_reg()) {
-        my_code += "MOVE(R"+str(_decs->result_reg())+", R"+str(_body->result_reg())+")\n";
+        emit(out, HERA_MOVE, {HERA_register(_decs->result_reg()), HERA_register(_body->result_reg())});
     }
 
     if (dec_amount > 0) {
-        my_code += "DEC(SP, " + str(dec_amount) + ")\n";
+        emit(out, HERA_DEC, {HERA_SP, HERA_number(dec_amount)});
     }
-
-    return my_code;
 }
 
-string A_varDec_::HERA_code(){
-
-    string my_code;
-    my_code += "//store "+str(_var)+"\n";
-    my_code += "INC(SP, 1)\n";
-    my_code += _init->HERA_code();
-    my_code += "STORE("+_init->result_reg_s()+", "+str(this->result_fp_plus()) + ", FP)\n";
-
-    return my_code;
+void A_varDec_::HERA_code(HERA_insns &out){
+    comment(out, "store " + str(_var));
+    emit(out, HERA_INC, {HERA_SP, HERA_number(1)});
+    _init->HERA_code(out);
+    emit(out, HERA_STORE, {_init->result_register(), HERA_number(this->result_fp_plus()), HERA_FP});
 }
 
-string A_fundec_::HERA_code() {
-    string my_code;
-
-    // save registers
-    int save_these_regs = _body->result_reg();
-    int number_of_params = 0;
-    if (head(this->type_field_list()) != Ty_Void()) number_of_params = length(this->type_field_list());
-
-    my_code += "BR("+this->branch_label_post()+")\n";
-    my_code += "LABEL("+str(_name)+this->set_unique_id()+")\n";
-    my_code += "STORE(PC_ret, 0, FP)\nSTORE(FP_alt, 1, FP)\n";
-
-    my_code += "//save registers \nINC(SP, "+str(save_these_regs)+")\n";
-    for (int i = 1; i <= save_these_regs; i++) {
-        my_code += "STORE(R"+str(i)+", "+str(2+number_of_params+i)+", FP)\n";
-    }
-
-    my_code += _body->HERA_code();
-    my_code += "STORE("+_body->result_reg_s()+", 3, FP)\n";
-
-    for (int i = 1; i <= save_these_regs; i++) {
-        my_code += "LOAD(R"+str(i)+", "+str(2+number_of_params+i)+", FP)\n";
-    }
-    my_code += "DEC(SP, "+str(save_these_regs)+")\n";
-
-    my_code += "LOAD(PC_ret, 0, FP)\nLOAD(FP_alt, 1, FP)\n";
-    my_code += "RETURN(FP_alt, PC_ret)\n";
-    my_code += "LABEL("+this->branch_label_post()+")\n\n";
-
-    return my_code;
+void A_fundec_::HERA_code(HERA_insns &out) {
+    // the function is a separate part of the IR, so nothing goes into "out" here;
+    //  IR_emit_HERA adds the code to save and restore registers, and return
+    HERA_insns body;
+    mark_line(_body, body);
+    _body->HERA_code(body);
+    mark_line(this, body);  // returning
+    emit(body, HERA_STORE, {_body->result_register(), HERA_number(3), HERA_FP});
+    IR_program::current()->functions.push_back(
+        IR_function_from_HERA(this->function_label(), this->argument_slots(), this->saved_register_slots(), body));
 }
 
-string A_functionDec_::HERA_code() {
-    return theFunctions->HERA_code();
+void A_functionDec_::HERA_code(HERA_insns &out) {
+    int g = this->cache_group();
+    if (g < 0) {
+        theFunctions->HERA_code(out);
+        return;
+    }
+    // the group's code goes into its cache group, which IR_emit_HERA writes out
+    IR_program *program = IR_program::current();
+    if (program->cache_groups[g].from_cache) return;
+    unsigned long first = program->functions.size();
+    recording_group = g;
+    theFunctions->HERA_code(out);
+    recording_group = -1;
+    for (unsigned long f = first; f < program->functions.size(); f++)
+        program->functions[f].cache_group = g;
 }
\ No newline at end of file
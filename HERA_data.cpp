@@ -2,165 +2,157 @@
 // Created by John Finberg on 2/3/22.
 //
 #include "AST.h"
+#include "IR.h"
 
 const string indent = "    ";
 
-string AST_node_::HERA_data()  // Default used during development; could be removed in final version
+void AST_node_::HERA_data(HERA_emitter &out)  // Default used during development; could be removed in final version
 {
     string message = "HERA_data() requested for AST node type not yet having a HERA_data() method";
     EM_error(message);
-    return "#error " + message;  //if somehow we try to HERA-C-Run this, it will fail
+    out << "#error " << message;  //if somehow we try to HERA-C-Run this, it will fail
 }
 
-string A_arithExp_::HERA_data()
+void A_arithExp_::HERA_data(HERA_emitter &out)
 {
-    return _left->HERA_data() + _right->HERA_data();
+    _left->HERA_data(out);
+    _right->HERA_data(out);
 }
 
-string A_condExp_::HERA_data()
+void A_condExp_::HERA_data(HERA_emitter &out)
 {
-    return _left->HERA_data() + _right->HERA_data();
+    _left->HERA_data(out);
+    _right->HERA_data(out);
 }
 
-string A_intExp_::HERA_data()
+void A_intExp_::HERA_data(HERA_emitter &out)
 {
-    return "";
 }
 
-string A_boolExp_::HERA_data()
+void A_boolExp_::HERA_data(HERA_emitter &out)
 {
-    return "";
 }
 
-string A_callExp_::HERA_data()
+void A_callExp_::HERA_data(HERA_emitter &out)
 {
-    string my_code;
-
 //    A_expList my_pointer = _args;
 //    while (true){
-//        my_code += my_pointer->_head->HERA_data();
+//        my_pointer->_head->HERA_data(out);
 //        if (my_pointer->_tail == 0) break;
 //        my_pointer = my_pointer->_tail;
 //    }
-    my_code += _args->HERA_data();
+    _args->HERA_data(out);
 
 //    A_expList my_pointer = _args->;
 //    while (true && my_pointer != 0){
-//        my_code += my_pointer->HERA_data();
+//        my_pointer->HERA_data(out);
 //        if (my_pointer->_tail == 0) break;
 //        my_pointer = my_pointer->_tail;
 //    }
-    return my_code;
 }
 
-string A_seqExp_::HERA_data()
+void A_seqExp_::HERA_data(HERA_emitter &out)
 {
-    return _seq->HERA_data();
+    _seq->HERA_data(out);
 }
 
-string A_expList_::HERA_data() {
+void A_expList_::HERA_data(HERA_emitter &out) {
     //May have screwed this up in the process
-    string my_code;
-    my_code += _head->HERA_data();
+    _head->HERA_data(out);
 
     A_expList my_pointer = _tail;
     while (true && my_pointer != 0){
-        my_code += my_pointer->HERA_data();
+        my_pointer->HERA_data(out);
         if (my_pointer->_tail == 0) break;
         my_pointer = my_pointer->_tail;
     }
-    return my_code;
 }
 
-string A_stringExp_::HERA_data()
+void A_stringExp_::HERA_data(HERA_emitter &out)
 {
-    string my_code;
-    my_code += "DLABEL("+this->result_dlabel()+") \n";
-    my_code += indent + "LP_STRING("+ repr(value)+") \n\n";
-    return my_code;
+    out << "DLABEL(" << this->result_dlabel() << ") \n";
+    out << indent << "LP_STRING(" << repr(value) << ") \n\n";
 }
 
-string A_assignExp_::HERA_data() {
-    return _exp->HERA_data() + _var->HERA_data();
+void A_assignExp_::HERA_data(HERA_emitter &out) {
+    _exp->HERA_data(out);
+    _var->HERA_data(out);
 }
 
-string A_letExp_::HERA_data() {
-    return _decs->HERA_data() + _body->HERA_data();
+void A_letExp_::HERA_data(HERA_emitter &out) {
+    _decs->HERA_data(out);
+    _body->HERA_data(out);
 }
 
-string A_decList_::HERA_data() {
-    string my_code;
-    my_code += _head->HERA_data();
+void A_decList_::HERA_data(HERA_emitter &out) {
+    _head->HERA_data(out);
 
     if (_tail != 0){
-        my_code += _tail->HERA_data();
+        _tail->HERA_data(out);
     }
-
-    return my_code;
 }
 
-string A_fundecList_::HERA_data() {
-    string my_code;
-    my_code += _head->HERA_data();
+void A_fundecList_::HERA_data(HERA_emitter &out) {
+    _head->HERA_data(out);
 
     if (_tail != 0){
-        my_code += _tail->HERA_data();
+        _tail->HERA_data(out);
     }
-
-    return my_code;
 }
 
-string A_fieldList_::HERA_data() {
-    string my_code;
-    my_code += _head->HERA_data();
+void A_fieldList_::HERA_data(HERA_emitter &out) {
+    _head->HERA_data(out);
 
     if (_tail != 0){
-        my_code += _tail->HERA_data();
+        _tail->HERA_data(out);
     }
-
-    return my_code;
 }
 
-string A_field_::HERA_data() {
-    return "";
+void A_field_::HERA_data(HERA_emitter &out) {
 }
 
-string A_varDec_::HERA_data() {
-    return _init->HERA_data();
+void A_varDec_::HERA_data(HERA_emitter &out) {
+    _init->HERA_data(out);
 }
 
-string A_ifExp_::HERA_data() {
-    return (_else_or_null != 0) ? _test->HERA_data()+_then->HERA_data()+_else_or_null->HERA_data() : _test->HERA_data()+_then->HERA_data();
+void A_ifExp_::HERA_data(HERA_emitter &out) {
+    _test->HERA_data(out);
+    _then->HERA_data(out);
+    if (_else_or_null != 0) _else_or_null->HERA_data(out);
 }
 
-string A_whileExp_::HERA_data() {
-    return _cond->HERA_data() + _body->HERA_data();
+void A_whileExp_::HERA_data(HERA_emitter &out) {
+    _cond->HERA_data(out);
+    _body->HERA_data(out);
 }
 
-string A_forExp_::HERA_data() {
-    return _hi->HERA_data() + _lo->HERA_data() + _body->HERA_data();
+void A_forExp_::HERA_data(HERA_emitter &out) {
+    _hi->HERA_data(out);
+    _lo->HERA_data(out);
+    _body->HERA_data(out);
 }
 
-string A_simpleVar_::HERA_data(){
-    return "";
+void A_simpleVar_::HERA_data(HERA_emitter &out){
 }
 
-string A_breakExp_::HERA_data() {
-    return "";
+void A_breakExp_::HERA_data(HERA_emitter &out) {
 }
 
-string A_varExp_::HERA_data() {
-    return _var->HERA_data();
+void A_varExp_::HERA_data(HERA_emitter &out) {
+    _var->HERA_data(out);
 }
 
-string A_fundec_::HERA_data() {
-    string my_code;
-
-    my_code += _body->HERA_data();
-
-    return my_code;
+void A_fundec_::HERA_data(HERA_emitter &out) {
+    _body->HERA_data(out);
 }
 
-string A_functionDec_::HERA_data() {
-    return theFunctions->HERA_data();
+void A_functionDec_::HERA_data(HERA_emitter &out) {
+    int g = this->cache_group();
+    if (g < 0) {
+        theFunctions->HERA_data(out);
+        return;
+    }
+    function_group &group = IR_program::current()->cache_groups[g];
+    if (!group.from_cache) theFunctions->HERA_data(group.data);  // and keep it for cache_write
+    out << group.data;
 }
\ No newline at end of file
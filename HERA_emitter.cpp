@@ -0,0 +1,56 @@
+#include <cstring>
+#include "HERA_emitter.h"
+
+HERA_emitter::HERA_emitter() : total_length(0)
+{
+}
+
+HERA_emitter &HERA_emitter::operator<<(const char *s)
+{
+	append(s, strlen(s));
+	return *this;
+}
+
+void HERA_emitter::append(const char *s, unsigned long len)
+{
+	total_length += len;
+	while (len > 0) {
+		if (chunks.empty() || chunks.back().length() == chunk_size) {
+			chunks.emplace_back();
+			chunks.back().reserve(chunk_size);
+		}
+		unsigned long room = chunk_size - chunks.back().length();
+		unsigned long now = len < room ? len : room;
+		chunks.back().append(s, now);
+		s += now;
+		len -= now;
+	}
+}
+
+HERA_emitter &HERA_emitter::operator<<(const HERA_emitter &code)
+{
+	for (const string &c : code.chunks)
+		append(c.data(), c.length());
+	return *this;
+}
+
+void HERA_emitter::write_to(std::ostream &out) const
+{
+	for (const string &c : chunks)
+		out.write(c.data(), c.length());
+}
+
+string HERA_emitter::as_string() const
+{
+	string result;
+	result.reserve(total_length);
+	for (const string &c : chunks)
+		result += c;
+	return result;
+}
+
+void HERA_emitter::clear()
+{
+	chunks.clear();
+	total_length = 0;
+}
@@ -0,0 +1,39 @@
+#if ! defined HERA_EMITTER_H
+#define HERA_EMITTER_H
+
+#include <ostream>
+#include <vector>
+#include "util.h"
+
+// HERA_code and HERA_data append their output to a HERA_emitter,
+//  rather than returning strings that get concatenated at every level of the tree
+//  (which copied the code of a deep subtree once per level above it).
+//
+// The text is kept in fixed-size chunks, so appending never copies what's already there,
+//  and is written out all at once with write_to, e.g. to cout and/or an output file,
+//  after we know there were no errors.
+
+class HERA_emitter {
+public:
+	HERA_emitter();
+
+	HERA_emitter &operator<<(const string &s)  { append(s.data(), s.length()); return *this; }
+	HERA_emitter &operator<<(const char *s);
+	HERA_emitter &operator<<(char c)           { append(&c, 1); return *this; }
+	HERA_emitter &operator<<(int i)            { return *this << str(i); }
+	HERA_emitter &operator<<(const HERA_emitter &code);
+
+	void write_to(std::ostream &out) const;
+	string as_string() const;  // mostly for debugging; the whole point is to avoid building this
+	unsigned long length() const { return total_length; }
+	void clear();
+
+private:
+	static const unsigned long chunk_size = 64*1024;
+	void append(const char *s, unsigned long len);
+
+	std::vector<string> chunks;  // each has capacity chunk_size, and is never reallocated
+	unsigned long total_length;
+};
+
+#endif
@@ -0,0 +1,858 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include "HERA_interpreter.h"
+#include "HERA_IR.h"
+#include "HERA_machine.h"
+#include "cost.h"
+
+/*
+ * Loading and running HERA programs, for tiger --run and --profile; see HERA_interpreter.h
+ */
+
+// Anything we can't load: where it is (file:line), and what's wrong
+struct HERA_load_error {
+	string message;
+};
+
+// A line of the program after preprocessing, and where it came from
+struct source_line {
+	string text, where;
+};
+
+
+// The preprocessor
+
+static bool is_name_start(char c) { return isalpha((unsigned char) c) || c == '_'; }
+static bool is_name_char(char c)  { return isalnum((unsigned char) c) || c == '_'; }
+
+// skip a "string" or 'character' starting at text[i], returning where it ends
+static unsigned long skip_quoted(const string &text, unsigned long i)
+{
+	char quote = text[i++];
+	while (i < text.length() && text[i] != quote && text[i] != '\n') {
+		if (text[i] == '\\') i++;
+		i++;
+	}
+	return std::min(i + 1, (unsigned long) text.length());
+}
+
+// take out // and /* */ comments, keeping the newlines so the line numbers still work
+static string without_comments(const string &text)
+{
+	string result;
+	unsigned long i = 0;
+	while (i < text.length()) {
+		if (text[i] == '"' || text[i] == '\'') {
+			unsigned long end = skip_quoted(text, i);
+			result += text.substr(i, end - i);
+			i = end;
+		} else if (text.compare(i, 2, "//") == 0) {
+			while (i < text.length() && text[i] != '\n') i++;
+		} else if (text.compare(i, 2, "/*") == 0) {
+			unsigned long end = text.find("*/", i + 2);
+			end = end == string::npos ? text.length() : end + 2;
+			result += ' ';
+			result.append(std::count(text.begin() + i, text.begin() + end, '\n'), '\n');
+			i = end;
+		} else {
+			result += text[i++];
+		}
+	}
+	return result;
+}
+
+static string trimmed(const string &s)
+{
+	unsigned long b = 0, e = s.length();
+	while (b < e && isspace((unsigned char) s[b])) b++;
+	while (e > b && isspace((unsigned char) s[e-1])) e--;
+	return s.substr(b, e - b);
+}
+
+class HERA_preprocessor {
+public:
+	HERA_preprocessor(const std::vector<string> &include_dirs) : include_dirs(include_dirs) {}
+	void run(const string &text, const string &file, std::vector<source_line> &out);
+	string expand(const string &line, int depth = 0) const;
+	long evaluate(const string &expression, const string &where, int depth = 0) const;  // for #if
+
+private:
+	std::vector<string> include_dirs;
+	std::map<string, string> macros;           // #define NAME value
+	std::map<string, string> function_macros;  // #define NAME() value
+	int include_depth = 0;
+
+	string find_include(const string &name, const string &file, const string &where) const;
+	friend class condition_parser;
+};
+
+// #if expressions: numbers, macros, defined X or defined(X), !, &&, ||, ==, !=, and parentheses
+class condition_parser {
+public:
+	condition_parser(const HERA_preprocessor &pp, const string &text, const string &where, int depth) :
+		pp(pp), text(text), where(where), depth(depth) {}
+	long parse() {
+		long result = parse_or();
+		skip_space();
+		if (i < text.length()) fail();
+		return result;
+	}
+
+private:
+	const HERA_preprocessor &pp;
+	string text, where;
+	int depth;
+	unsigned long i = 0;
+
+	void fail() { throw HERA_load_error{where + ": can't understand #if " + text}; }
+	void skip_space() { while (i < text.length() && isspace((unsigned char) text[i])) i++; }
+	bool take(const string &op) {
+		skip_space();
+		if (text.compare(i, op.length(), op) != 0) return false;
+		i += op.length();
+		return true;
+	}
+	string name() {
+		skip_space();
+		unsigned long start = i;
+		if (i < text.length() && is_name_start(text[i]))
+			while (i < text.length() && is_name_char(text[i])) i++;
+		if (i == start) fail();
+		return text.substr(start, i - start);
+	}
+	long parse_or()  { long a = parse_and(); while (take("||")) { long b = parse_and(); a = a || b; } return a; }
+	long parse_and() { long a = parse_equality(); while (take("&&")) { long b = parse_equality(); a = a && b; } return a; }
+	long parse_equality() {
+		long a = parse_unary();
+		while (true) {
+			if (take("==")) a = a == parse_unary();
+			else if (take("!=")) a = a != parse_unary();
+			else return a;
+		}
+	}
+	long parse_unary() { return take("!") ? !parse_unary() : parse_primary(); }
+	long parse_primary() {
+		skip_space();
+		if (take("(")) {
+			long a = parse_or();
+			if (!take(")")) fail();
+			return a;
+		}
+		if (i < text.length() && isdigit((unsigned char) text[i])) {
+			char *end;
+			long n = strtol(text.c_str() + i, &end, 0);
+			i = end - text.c_str();
+			while (i < text.length() && isalpha((unsigned char) text[i])) i++;  // 1L, 1u
+			return n;
+		}
+		string n = name();
+		if (n == "defined") {
+			bool parens = take("(");
+			string what = name();
+			if (parens && !take(")")) fail();
+			return pp.macros.count(what) || pp.function_macros.count(what);
+		}
+		auto m = pp.macros.find(n);
+		return m == pp.macros.end() ? 0 : pp.evaluate(m->second, where, depth + 1);
+	}
+};
+
+long HERA_preprocessor::evaluate(const string &expression, const string &where, int depth) const
+{
+	if (depth > 20) throw HERA_load_error{where + ": macros nested too deep in #if"};
+	return condition_parser(*this, expression, where, depth).parse();
+}
+
+// replace the macros in a line (but not in its strings)
+string HERA_preprocessor::expand(const string &line, int depth) const
+{
+	if (depth > 20) return line;
+	string result;
+	unsigned long i = 0;
+	while (i < line.length()) {
+		if (line[i] == '"' || line[i] == '\'') {
+			unsigned long end = skip_quoted(line, i);
+			result += line.substr(i, end - i);
+			i = end;
+		} else if (is_name_start(line[i])) {
+			unsigned long start = i;
+			while (i < line.length() && is_name_char(line[i])) i++;
+			string n = line.substr(start, i - start);
+			auto m = macros.find(n);
+			auto f = function_macros.find(n);
+			unsigned long after = i;
+			while (after < line.length() && isspace((unsigned char) line[after])) after++;
+			if (m != macros.end()) {
+				result += expand(m->second, depth + 1);
+			} else if (f != function_macros.end() && after < line.length() && line[after] == '(') {
+				unsigned long close = after + 1;
+				while (close < line.length() && isspace((unsigned char) line[close])) close++;
+				if (close < line.length() && line[close] == ')') {
+					result += " " + expand(f->second, depth + 1) + " ";
+					i = close + 1;
+				} else {
+					result += n;
+				}
+			} else {
+				result += n;
+			}
+		} else {
+			result += line[i++];
+		}
+	}
+	return result;
+}
+
+static string directory_of(const string &file)
+{
+	unsigned long slash = file.rfind('/');
+	return slash == string::npos ? "." : file.substr(0, slash);
+}
+
+string HERA_preprocessor::find_include(const string &name, const string &file, const string &where) const
+{
+	std::vector<string> dirs = {directory_of(file)};
+	dirs.insert(dirs.end(), include_dirs.begin(), include_dirs.end());
+	for (const string &dir : dirs) {
+		string path = name[0] == '/' ? name : dir + "/" + name;
+		if (std::ifstream(path)) return path;
+	}
+	throw HERA_load_error{where + ": can't find #include'd file " + name};
+}
+
+void HERA_preprocessor::run(const string &text, const string &file, std::vector<source_line> &out)
+{
+	// #if's we're in: is this part on, and has some part of this #if ... #else been on yet
+	struct conditional { bool on, done; };
+	std::vector<conditional> conditionals;
+	auto on = [&conditionals]() { return conditionals.empty() || conditionals.back().on; };
+
+	std::istringstream lines(without_comments(text));
+	string line;
+	int number = 0;
+	while (std::getline(lines, line)) {
+		number++;
+		string where = file + ":" + str(number);
+		while (!line.empty() && line.back() == '\\') {  // continued on the next line
+			string more;
+			if (!std::getline(lines, more)) break;
+			number++;
+			line = line.substr(0, line.length() - 1) + " " + more;
+		}
+		string t = trimmed(line);
+		if (t.empty()) continue;
+		if (t[0] != '#') {
+			if (on()) out.push_back(source_line{expand(t), where});
+			continue;
+		}
+
+		t = trimmed(t.substr(1));
+		unsigned long k = 0;
+		while (k < t.length() && is_name_char(t[k])) k++;
+		string directive = t.substr(0, k), rest = trimmed(t.substr(k));
+		bool outer_on = on();
+		if (directive == "if" || directive == "ifdef" || directive == "ifndef") {
+			bool yes = false;
+			if (outer_on) {
+				if (directive == "if") yes = evaluate(rest, where) != 0;
+				else yes = (macros.count(rest) || function_macros.count(rest)) == (directive == "ifdef");
+			}
+			conditionals.push_back(conditional{outer_on && yes, !outer_on || yes});
+		} else if (directive == "elif" || directive == "else" || directive == "endif") {
+			if (conditionals.empty()) throw HERA_load_error{where + ": #" + directive + " without #if"};
+			conditional c = conditionals.back();
+			conditionals.pop_back();
+			if (directive == "endif") continue;
+			bool yes = !c.done && on() && (directive == "else" || evaluate(rest, where) != 0);
+			conditionals.push_back(conditional{yes, c.done || yes});
+		} else if (!outer_on) {
+			continue;
+		} else if (directive == "define") {
+			unsigned long n = 0;
+			while (n < rest.length() && is_name_char(rest[n])) n++;
+			string name = rest.substr(0, n);
+			if (rest.compare(n, 1, "(") == 0) {
+				unsigned long close = rest.find(')', n);
+				if (close == string::npos || trimmed(rest.substr(n + 1, close - n - 1)) != "")
+					throw HERA_load_error{where + ": can't do #define's with parameters: " + name};
+				function_macros[name] = trimmed(rest.substr(close + 1));
+			} else {
+				string value = trimmed(rest.substr(n));
+				macros[name] = value == "" ? "1" : value;
+			}
+		} else if (directive == "undef") {
+			macros.erase(rest);
+			function_macros.erase(rest);
+		} else if (directive == "include") {
+			if (rest.length() < 2) throw HERA_load_error{where + ": bad #include"};
+			string path = find_include(rest.substr(1, rest.length() - 2), file, where);
+			if (++include_depth > 20) throw HERA_load_error{where + ": #include's nested too deep"};
+			std::ifstream in(path);
+			std::stringstream contents;
+			contents << in.rdbuf();
+			run(contents.str(), path, out);
+			include_depth--;
+		} else if (directive == "error") {
+			throw HERA_load_error{where + ": #error " + rest};
+		} else {
+			throw HERA_load_error{where + ": can't do #" + directive};
+		}
+	}
+	if (!conditionals.empty()) throw HERA_load_error{file + ": #if without #endif"};
+}
+
+
+// Statements, e.g. SET(R1, 5) or LP_STRING("hi"); a line can have several (e.g. from a macro)
+
+struct statement {
+	string op;
+	std::vector<string> args;
+	string where;
+};
+
+static void parse_statements(const source_line &line, std::vector<statement> &out)
+{
+	const string &t = line.text;
+	unsigned long i = 0;
+	while (true) {
+		while (i < t.length() && (isspace((unsigned char) t[i]) || t[i] == ';')) i++;
+		if (i >= t.length()) return;
+		unsigned long start = i;
+		while (i < t.length() && is_name_char(t[i])) i++;
+		statement s;
+		s.op = t.substr(start, i - start);
+		s.where = line.where;
+		while (i < t.length() && isspace((unsigned char) t[i])) i++;
+		if (s.op.empty() || i >= t.length() || t[i] != '(')
+			throw HERA_load_error{line.where + ": can't run " + t.substr(start)};
+		i++;
+		string arg;
+		int depth = 1;
+		while (i < t.length()) {
+			if (t[i] == '"' || t[i] == '\'') {
+				unsigned long end = skip_quoted(t, i);
+				arg += t.substr(i, end - i);
+				i = end;
+				continue;
+			}
+			char c = t[i++];
+			if (c == '(') depth++;
+			if (c == ')' && --depth == 0) break;
+			if (c == ',' && depth == 1) {
+				s.args.push_back(trimmed(arg));
+				arg = "";
+			} else {
+				arg += c;
+			}
+		}
+		if (depth != 0) throw HERA_load_error{line.where + ": missing ) in " + t.substr(start)};
+		if (trimmed(arg) != "" || !s.args.empty()) s.args.push_back(trimmed(arg));
+		out.push_back(s);
+	}
+}
+
+// the characters of a "string" or 'c', with its escapes (\n, \", \012, \x0a, ...) worked out
+static string unquoted(const string &quoted, const string &where)
+{
+	if (quoted.length() < 2 || quoted.back() != quoted[0])
+		throw HERA_load_error{where + ": expected a quoted string or character, not " + quoted};
+	string result;
+	for (unsigned long i = 1; i + 1 < quoted.length(); i++) {
+		char c = quoted[i];
+		if (c != '\\' || i + 2 >= quoted.length()) {
+			result += c;
+			continue;
+		}
+		c = quoted[++i];
+		if (c >= '0' && c <= '7') {
+			int n = 0;
+			for (int digits = 0; digits < 3 && i + 1 < quoted.length() && quoted[i] >= '0' && quoted[i] <= '7'; digits++)
+				n = n * 8 + (quoted[i++] - '0');
+			i--;
+			result += char(n);
+		} else if (c == 'x') {
+			int n = 0;
+			while (i + 2 < quoted.length() && isxdigit((unsigned char) quoted[i+1])) {
+				char h = tolower(quoted[++i]);
+				n = n * 16 + (isdigit((unsigned char) h) ? h - '0' : h - 'a' + 10);
+			}
+			result += char(n);
+		} else {
+			const char *from = "ntrab0fv", *to = "\n\t\r\a\b\0\f\v";
+			const char *e = strchr(from, c);
+			result += e && *e ? to[e - from] : c;
+		}
+	}
+	return result;
+}
+
+
+// The program, loaded
+
+// the branches, in the order of their conditions in the run loop
+static const char *branch_names[] = {"BR", "BL", "BGE", "BLE", "BG", "BULE", "BUG", "BZ", "BNZ", "BC", "BNC", "BS", "BNS", "BV", "BNV"};
+
+static const char *native_names[] = {"print", "printint", "printbool", "putchar_ord", "getchar_ord",
+				     "getint", "getline", "flush", "div", "mod"};
+
+int HERA_machine::reg(const string &arg, const string &where) const
+{
+	static const std::map<string, int> named = {{"Rt", 11}, {"TMP", 11}, {"FP_alt", 12}, {"PC_ret", 13}, {"FP", 14}, {"SP", 15}};
+	auto n = named.find(arg);
+	if (n != named.end()) return n->second;
+	bool numbered = arg.length() >= 2 && arg.length() <= 3 && (arg[0] == 'R' || arg[0] == 'r') &&
+	                arg.find_first_not_of("0123456789", 1) == string::npos;
+	int r = numbered ? atoi(arg.c_str() + 1) : -1;
+	if (r < 0 || r > 15)
+		throw HERA_load_error{where + ": expected a register, not " + arg};
+	return r;
+}
+
+// a constant: a number, 'c', or a label, or a sum or difference of them
+int HERA_machine::value(const string &arg, const string &where) const
+{
+	int total = 0, sign = 1;
+	unsigned long i = 0;
+	string a = trimmed(arg);
+	if (a.empty()) throw HERA_load_error{where + ": missing operand"};
+	while (i < a.length()) {
+		while (i < a.length() && isspace((unsigned char) a[i])) i++;
+		if (a[i] == '-' || a[i] == '+') {
+			if (a[i] == '-') sign = -sign;
+			i++;
+			continue;
+		}
+		unsigned long start = i;
+		int term;
+		if (a[i] == '\'') {
+			i = skip_quoted(a, i);
+			string c = unquoted(a.substr(start, i - start), where);
+			term = c.empty() ? 0 : (unsigned char) c[0];
+		} else if (isdigit((unsigned char) a[i])) {
+			char *end;
+			term = strtol(a.c_str() + i, &end, 0);
+			i = end - a.c_str();
+		} else if (is_name_start(a[i])) {
+			while (i < a.length() && is_name_char(a[i])) i++;
+			auto l = labels.find(a.substr(start, i - start));
+			if (l == labels.end()) throw HERA_load_error{where + ": undefined label " + a.substr(start, i - start)};
+			term = l->second;
+		} else {
+			throw HERA_load_error{where + ": can't understand " + a};
+		}
+		total += sign * term;
+		sign = 1;
+		while (i < a.length() && isspace((unsigned char) a[i])) i++;
+		if (i < a.length() && a[i] != '+' && a[i] != '-') throw HERA_load_error{where + ": can't understand " + a};
+	}
+	return total;
+}
+
+static bool is_data(const string &op)
+{
+	return op == "DLABEL" || op == "INTEGER" || op == "LP_STRING" || op == "TIGER_STRING" || op == "DSKIP";
+}
+
+void HERA_machine::load(const std::vector<statement> &program)
+{
+	// first, where all the labels are
+	int instructions = 0, data = data_start;
+	for (const statement &s : program) {
+		if ((s.op == "LABEL" || s.op == "DLABEL") && s.args.size() != 1)
+			throw HERA_load_error{s.where + ": " + s.op + " needs a label"};
+		if (s.op == "LABEL" || s.op == "DLABEL") {
+			if (labels.count(s.args[0])) throw HERA_load_error{s.where + ": label " + s.args[0] + " is defined twice"};
+			labels[s.args[0]] = s.op == "LABEL" ? instructions : data;
+			if (s.op == "LABEL") {
+				code_labels.insert(s.args[0]);
+				label_at.push_back(std::pair(instructions, s.args[0]));
+			}
+		} else if (s.op == "INTEGER") {
+			data++;
+		} else if (s.op == "LP_STRING" || s.op == "TIGER_STRING") {
+			data += 1 + (s.args.size() == 1 ? unquoted(s.args[0], s.where).length() : 0);
+		} else if (s.op == "DSKIP") {
+			data += s.args.size() == 1 ? value(s.args[0], s.where) : 0;
+		} else {
+			instructions++;
+		}
+		if (data > 0xFFFF) throw HERA_load_error{s.where + ": out of memory for data"};
+	}
+	if (!labels.count("first_space_for_fsheap")) labels["first_space_for_fsheap"] = heap_start;
+	if (!labels.count("last_space_for_fsheap")) labels["last_space_for_fsheap"] = heap_end;
+	heap_cell = labels["first_space_for_fsheap"];
+	heap_last = labels["last_space_for_fsheap"];
+	if (labels.count("tiger_stdlib_ungetchar_one_char_tmp")) unget_cell = labels["tiger_stdlib_ungetchar_one_char_tmp"];
+
+	// then the data and the instructions
+	data = data_start;
+	for (const statement &s : program) {
+		const string &op = s.op;
+		auto need = [&s](unsigned long n) {
+			if (s.args.size() != n) throw HERA_load_error{s.where + ": " + s.op + " needs " + str(int(n)) + " operand(s)"};
+		};
+		auto code_label = [this, &s](const string &label) {
+			if (!code_labels.count(label)) throw HERA_load_error{s.where + ": " + label + " isn't a LABEL in the program"};
+			return labels[label];
+		};
+		if (op == "LABEL" || op == "DLABEL") continue;
+		if (is_data(op)) {
+			need(1);
+			if (op == "INTEGER") {
+				memory[data++] = value(s.args[0], s.where);
+			} else if (op == "DSKIP") {
+				data += value(s.args[0], s.where);
+			} else {
+				string chars = unquoted(s.args[0], s.where);
+				memory[data++] = chars.length();
+				for (char c : chars) memory[data++] = (unsigned char) c;
+			}
+			continue;
+		}
+
+		decoded_insn i = {op_NOP, 0, 0, 0, 0};
+		auto three_registers = [&](HERA_opcode o) {
+			need(3);
+			i = {o, (unsigned char) reg(s.args[0], s.where), (unsigned char) reg(s.args[1], s.where), (unsigned char) reg(s.args[2], s.where), 0};
+		};
+		auto two_registers = [&](HERA_opcode o) {
+			need(2);
+			i = {o, (unsigned char) reg(s.args[0], s.where), (unsigned char) reg(s.args[1], s.where), 0, 0};
+		};
+		auto register_and_value = [&](HERA_opcode o) {
+			need(2);
+			i = {o, (unsigned char) reg(s.args[0], s.where), 0, 0, value(s.args[1], s.where)};
+		};
+		static const std::map<string, HERA_opcode> no_operands = {
+			{"SETC", op_SETC}, {"CON", op_SETC}, {"CLRC", op_CLRC}, {"COFF", op_CLRC},
+			{"CBON", op_CBON}, {"SETCB", op_CBON}, {"CCBOFF", op_CCBOFF}, {"HALT", op_HALT}, {"NOP", op_NOP},
+		};
+		static const std::map<string, HERA_opcode> arithmetic = {
+			{"AND", op_AND}, {"OR", op_OR}, {"ADD", op_ADD}, {"SUB", op_SUB}, {"MUL", op_MUL}, {"XOR", op_XOR},
+		};
+		static const std::map<string, HERA_opcode> one_register = {
+			{"LSL", op_LSL}, {"LSR", op_LSR}, {"LSL8", op_LSL8}, {"LSR8", op_LSR8}, {"ASL", op_ASL}, {"ASR", op_ASR},
+			{"MOVE", op_MOVE}, {"NEG", op_NEG}, {"NOT", op_NOT},
+		};
+		string branch = op.length() > 2 && op.back() == 'R' ? op.substr(0, op.length() - 1) : op;  // BZR is BZ, etc.
+		int which_branch = -1;
+		for (unsigned b = 0; b < sizeof branch_names / sizeof *branch_names; b++)
+			if (branch == branch_names[b]) which_branch = b;
+
+		if (no_operands.count(op)) {
+			need(0);
+			i.op = no_operands.at(op);
+		} else if (arithmetic.count(op)) {
+			three_registers(arithmetic.at(op));
+		} else if (one_register.count(op)) {
+			two_registers(one_register.at(op));
+		} else if (op == "SETLO" || op == "SETHI" || op == "SET" || op == "INC" || op == "DEC") {
+			register_and_value(op == "SETLO" ? op_SETLO : op == "SETHI" ? op_SETHI : op == "SET" ? op_SET : op == "INC" ? op_INC : op_DEC);
+		} else if (op == "LOAD" || op == "STORE") {
+			need(3);
+			i = {op == "LOAD" ? op_LOAD : op_STORE, (unsigned char) reg(s.args[0], s.where), (unsigned char) reg(s.args[2], s.where), 0, value(s.args[1], s.where)};
+		} else if (op == "CMP") {
+			need(2);
+			i = {op_CMP, 0, (unsigned char) reg(s.args[0], s.where), (unsigned char) reg(s.args[1], s.where), 0};
+		} else if (which_branch >= 0) {
+			need(1);
+			i = {op_BRANCH, 0, (unsigned char) which_branch, 0, code_label(s.args[0])};
+		} else if (op == "CALL") {
+			need(2);
+			i = {op_CALL, 0, (unsigned char) reg(s.args[0], s.where), 0, 0};
+			string callee = s.args[1] == "DIV" ? "div" : s.args[1] == "MOD" ? "mod" : s.args[1];
+			for (int n = 0; n < native_routines; n++)
+				if (callee == native_names[n]) i = {op_NATIVE, 0, i.a, 0, n};
+			if (i.op == op_CALL) i.value = code_label(s.args[1]);
+		} else if (op == "RETURN") {
+			two_registers(op_RETURN);
+			i = {op_RETURN, 0, i.d, i.a, 0};
+		} else {
+			throw HERA_load_error{s.where + ": can't run " + op + " instructions"};
+		}
+		code.push_back(i);
+		HERA_op named;
+		cycles.push_back(HERA_op_named(op, named) ? cost_cycles(HERA_insn(named, std::vector<HERA_operand>(s.args.size()))) : 1);
+		where.push_back(s.where);
+	}
+}
+
+// one of the routines of the library that HERA-C does in C++, for a CALL with FP_alt = fp
+bool HERA_machine::native(int routine, uint16_t fp, string &error)
+{
+	std::vector<uint16_t> &M = memory;
+	uint16_t result = uint16_t(fp + 3), argument = M[result], second = M[uint16_t(fp + 4)];
+	switch (routine) {
+	case native_print:
+		for (int i = 1; i <= M[argument]; i++) *out << char(M[uint16_t(argument + i)]);
+		break;
+	case native_printint:
+		*out << int16_t(argument);
+		break;
+	case native_printbool:
+		*out << (argument ? "true" : "false");
+		break;
+	case native_putchar_ord:
+		*out << char(argument);
+		break;
+	case native_getchar_ord:
+		if (unget_cell >= 0 && M[unget_cell] != 0) {  // after ungetchar
+			M[unget_cell] = 0;
+			M[result] = M[unget_cell + 1];
+		} else {
+			int c = in->get();
+			M[result] = c == EOF ? 0xFFFF : c;
+			if (unget_cell >= 0) M[unget_cell + 1] = M[result];
+		}
+		break;
+	case native_getint: {
+		int i = 0;
+		*in >> i;
+		M[result] = uint16_t(i);
+		break;
+	}
+	case native_getline: {  // the same way malloc gets space
+		string line;
+		std::getline(*in, line);
+		int start = M[heap_cell] != 0 ? M[heap_cell] : heap_cell + 1;
+		if (start + 1 + int(line.length()) > heap_last) {
+			error = "out of memory in getline";
+			return false;
+		}
+		M[start] = line.length();
+		for (unsigned long i = 0; i < line.length(); i++) M[start + 1 + i] = (unsigned char) line[i];
+		M[heap_cell] = start + 1 + line.length();
+		M[result] = start;
+		break;
+	}
+	case native_flush:
+		out->flush();
+		break;
+	case native_div:
+	case native_mod:
+		if (second == 0)
+			*out << "Error in Tiger-stdlib function '" << native_names[routine] << "': dividing by 0";
+		else if (routine == native_div)
+			M[result] = uint16_t(int(int16_t(argument)) / int(int16_t(second)));
+		else
+			M[result] = uint16_t(int(int16_t(argument)) % int(int16_t(second)));
+		break;
+	}
+	return true;
+}
+
+int HERA_machine::fail(unsigned long pc, const string &message, std::ostream &errors)
+{
+	out->flush();
+	errors << (pc > 0 && pc <= code.size() ? where[pc - 1] + ": " : string()) << "HERA error: " << message << std::endl;
+	return 1;
+}
+
+// The run loop: each instruction does what its HERA instruction (or pseudo-instruction) does, including
+//  setting the flags, and the carry coming in to ADD, SUB and the shifts unless the carry block is on.
+template <bool profiling>
+int HERA_machine::run(std::ostream &errors)
+{
+	uint16_t *R = this->R, *M = memory.data();
+	const decoded_insn *program = code.data();
+	const unsigned long n = code.size();
+	unsigned long pc = 0;
+	bool s = false, z = false, v = false, c = false, cb = false;
+	auto fail = [&](const string &message) { return this->fail(pc, message, errors); };
+	auto result = [&](unsigned char d, unsigned r) {
+		r &= 0xFFFF;
+		s = r & 0x8000;
+		z = r == 0;
+		R[d] = r;
+	};
+	auto add = [&](unsigned char d, unsigned a, unsigned b, unsigned carry_in) {
+		unsigned sum = a + b + carry_in;
+		c = sum > 0xFFFF;
+		v = ((a ^ sum) & (b ^ sum) & 0x8000) != 0;
+		result(d, sum);
+	};
+	auto subtract = [&](unsigned char d, unsigned a, unsigned b, unsigned borrow) {
+		int difference = int(a) - int(b) - int(borrow);
+		c = difference >= 0;
+		v = ((a ^ b) & (a ^ unsigned(difference)) & 0x8000) != 0;
+		result(d, unsigned(difference));
+	};
+
+	while (true) {
+		R[0] = 0;
+		if (pc >= n) return fail("ran off the end of the program");
+		const decoded_insn &i = program[pc];
+		if constexpr (profiling) counts[pc]++;
+		pc++;
+		switch (i.op) {
+		case op_SETLO:  R[i.d] = uint16_t(int8_t(i.value & 0xFF)); break;
+		case op_SETHI:  R[i.d] = uint16_t((R[i.d] & 0xFF) | ((i.value & 0xFF) << 8)); break;
+		case op_SET:    R[i.d] = uint16_t(i.value); break;
+		case op_AND:    result(i.d, R[i.a] & R[i.b]); break;
+		case op_OR:     result(i.d, R[i.a] | R[i.b]); break;
+		case op_XOR:    result(i.d, R[i.a] ^ R[i.b]); break;
+		case op_ADD:    add(i.d, R[i.a], R[i.b], !cb && c); break;
+		case op_SUB:    subtract(i.d, R[i.a], R[i.b], !cb && !c); break;
+		case op_MUL:    result(i.d, unsigned(int(int16_t(R[i.a])) * int(int16_t(R[i.b])))); break;
+		case op_INC:
+			add(i.d, R[i.d], i.value & 0xFFFF, 0);
+			if (i.d == 15 && R[15] >= heap_start) return fail("stack overflow");
+			break;
+		case op_DEC:    subtract(i.d, R[i.d], i.value & 0xFFFF, 0); break;
+		case op_LSL:  { unsigned a = R[i.a]; result(i.d, (a << 1) | (!cb && c)); c = a & 0x8000; break; }
+		case op_LSR:  { unsigned a = R[i.a]; result(i.d, (a >> 1) | ((!cb && c) << 15)); c = a & 1; break; }
+		case op_LSL8:   result(i.d, R[i.a] << 8); break;
+		case op_LSR8:   result(i.d, R[i.a] >> 8); break;
+		case op_ASL:  { unsigned a = R[i.a]; result(i.d, (a << 1) | (!cb && c)); c = a & 0x8000; v = (a ^ (a << 1)) & 0x8000; break; }
+		case op_ASR:  { unsigned a = R[i.a]; result(i.d, (a >> 1) | (a & 0x8000)); c = a & 1; break; }
+		case op_SETC:   c = true; break;
+		case op_CLRC:   c = false; break;
+		case op_CBON:   cb = true; break;
+		case op_CCBOFF: cb = false; break;
+		case op_LOAD:   result(i.d, M[uint16_t(R[i.a] + i.value)]); break;
+		case op_STORE:  M[uint16_t(R[i.a] + i.value)] = R[i.d]; break;
+		case op_MOVE:   result(i.d, R[i.a]); break;
+		case op_CMP:    subtract(0, R[i.a], R[i.b], 0); break;
+		case op_NEG:    subtract(i.d, 0, R[i.a], 0); break;
+		case op_NOT:  { unsigned a = R[i.a]; R[11] = 0xFFFF; result(i.d, ~a); break; }
+		case op_BRANCH: {
+			bool go;
+			switch (i.a) {
+			case 0:  go = true; break;                    // BR
+			case 1:  go = s != v; break;                  // BL
+			case 2:  go = s == v; break;                  // BGE
+			case 3:  go = (s != v) || z; break;           // BLE
+			case 4:  go = !((s != v) || z); break;        // BG
+			case 5:  go = !c || z; break;                 // BULE
+			case 6:  go = c && !z; break;                 // BUG
+			case 7:  go = z; break;                       // BZ
+			case 8:  go = !z; break;                      // BNZ
+			case 9:  go = c; break;                       // BC
+			case 10: go = !c; break;                      // BNC
+			case 11: go = s; break;                       // BS
+			case 12: go = !s; break;                      // BNS
+			case 13: go = v; break;                       // BV
+			default: go = !v; break;                      // BNV
+			}
+			if (go) pc = i.value;
+			break;
+		}
+		case op_CALL: {  // CALL(FP_alt, label) is SET(PC_ret, label) then CALL(FP_alt, PC_ret)
+			if constexpr (profiling) calls[i.value]++;
+			uint16_t fp = R[14];
+			R[14] = R[i.a];
+			R[i.a] = fp;
+			R[13] = pc;
+			pc = i.value;
+			break;
+		}
+		case op_RETURN: {
+			unsigned long to = R[i.b];
+			uint16_t fp = R[14];
+			R[14] = R[i.a];
+			R[i.a] = fp;
+			R[i.b] = pc;
+			pc = to;
+			break;
+		}
+		case op_NATIVE: {
+			if constexpr (profiling) native_calls[i.value]++;
+			string error;
+			if (!native(i.value, R[i.a], error)) return fail(error);
+			break;
+		}
+		case op_HALT:
+			out->flush();
+			return 0;
+		case op_NOP:
+			break;
+		}
+	}
+}
+
+int HERA_run(const string &program, const string &where, const std::vector<string> &include_dirs,
+	     std::istream &in, std::ostream &out, std::ostream &errors, HERA_profile *profile, bool jit)
+{
+	HERA_machine machine;
+	try {
+		std::vector<source_line> lines;
+		HERA_preprocessor(include_dirs).run(program, where, lines);
+		std::vector<statement> statements;
+		for (const source_line &line : lines)
+			parse_statements(line, statements);
+		machine.load(statements);
+	} catch (const HERA_load_error &e) {
+		errors << e.message << std::endl;
+		return 1;
+	}
+	machine.in = &in;
+	machine.out = &out;
+	machine.R[14] = machine.R[15] = stack_start;
+	if (!profile) {
+		int result = jit ? HERA_jit_run(machine, errors) : -1;
+		return result >= 0 ? result : machine.run<false>(errors);
+	}
+
+	machine.counts.assign(machine.code.size(), 0);
+	machine.calls.assign(machine.code.size() + 1, 0);
+	machine.native_calls.assign(native_routines, 0);
+	int result = machine.run<true>(errors);
+
+	// add up each label's instructions, from it to the next one (labels at the same place share them)
+	std::vector<std::pair<int, string>> starts = {{0, "main program"}};
+	for (const auto &[at, label] : machine.label_at) {
+		if (starts.back().first == at && starts.back().second != "main program") starts.back().second += "/" + label;
+		else if (starts.back().first == at) starts.back().second = label;
+		else starts.push_back(std::pair(at, label));
+	}
+	profile->labels.clear();
+	profile->instructions = profile->cycles = 0;
+	for (unsigned l = 0; l < starts.size(); l++) {
+		HERA_profile::label_numbers numbers;
+		numbers.label = starts[l].second;
+		numbers.calls = machine.calls[starts[l].first];
+		int end = l + 1 < starts.size() ? starts[l+1].first : machine.code.size();
+		for (int i = starts[l].first; i < end; i++) {
+			numbers.instructions += machine.counts[i];
+			numbers.cycles += machine.counts[i] * machine.cycles[i];
+		}
+		profile->instructions += numbers.instructions;
+		profile->cycles += numbers.cycles;
+		if (numbers.instructions > 0) profile->labels.push_back(numbers);
+	}
+	for (int n = 0; n < native_routines; n++)
+		if (machine.native_calls[n] > 0) {
+			HERA_profile::label_numbers numbers;
+			numbers.label = native_names[n];
+			numbers.calls = machine.native_calls[n];
+			numbers.native = true;
+			profile->labels.push_back(numbers);
+		}
+	std::stable_sort(profile->labels.begin(), profile->labels.end(),
+			 [](const HERA_profile::label_numbers &a, const HERA_profile::label_numbers &b) { return a.cycles > b.cycles; });
+	return result;
+}
+
+void HERA_profile::print(std::ostream &out) const
+{
+	char line[200];
+	out << "Profile: " << instructions << " instructions, " << cycles << " cycles (as estimated in cost.h)" << std::endl;
+	snprintf(line, sizeof line, "  %-40s %10s %14s %14s %7s", "label", "calls", "instructions", "cycles", "cycles%");
+	out << line << std::endl;
+	for (const label_numbers &l : labels) {
+		if (l.native)
+			snprintf(line, sizeof line, "  %-40s %10lu %14s %14s %7s", l.label.c_str(), l.calls, "(native)", "", "");
+		else
+			snprintf(line, sizeof line, "  %-40s %10lu %14llu %14llu %6.1f%%", l.label.c_str(), l.calls, l.instructions, l.cycles,
+				 cycles > 0 ? 100.0 * l.cycles / cycles : 0.0);
+		out << line << std::endl;
+	}
+}
@@ -0,0 +1,53 @@
+#if ! defined HERA_INTERPRETER_H
+#define HERA_INTERPRETER_H
+
+#include <iostream>
+#include <vector>
+#include "util.h"
+
+// An interpreter for the HERA programs the compiler writes, for tiger --run and --profile,
+//  so we can run a program without HERA-C (or writing HERA_main.cc and compiling it).
+//
+// It loads the whole program, including the #include'd Tiger-stdlib-stack(-data).hera:
+//  - a little preprocessor does the #if's, #define's (with no parameters) and #include's;
+//  - the data (DLABEL, INTEGER, LP_STRING, ...) goes into memory, starting at 0xC000;
+//  - the labels all get their values in one pass over the program (a LABEL is the number of
+//    the instruction after it, so code addresses are instruction numbers, not memory addresses),
+//  - and each instruction is decoded once, with its registers, constants and branch targets worked out,
+//    into an array that a switch in one loop runs through.
+//
+// The library is loaded without HERA_C defined, so the routines written in HERA (tstrcmp, concat,
+//  substring, malloc, ...) run as HERA, and the ones that HERA-C does in C++ (print, printint, printbool,
+//  putchar_ord, getchar_ord, getint, getline, flush, div and mod) are done here instead, when they're CALLed.
+//  Integers are printed in decimal, as with HERA-C.
+//
+// The stack starts at 0 (FP = SP = 0), and malloc's heap at 0x4000 (first_space_for_fsheap).
+//
+// With "jit", and no profile, the program is translated to x86-64 code and run as that (see HERA_jit.cpp),
+//  if we're on x86-64 Linux and it's a program the JIT can do; it does just what the interpreter would.
+//
+// With a HERA_profile, it also counts how many times each instruction runs, and reports that
+//  for each label (i.e., the code from one LABEL to the next), with the cycles from cost.h's model.
+
+struct HERA_profile {
+	struct label_numbers {
+		string label;              // "main program" for the code before any label
+		unsigned long calls = 0;   // how many times a CALL went there
+		unsigned long long instructions = 0, cycles = 0;
+		bool native = false;       // one of the library routines done in C++ (see above)
+	};
+	std::vector<label_numbers> labels;  // most cycles first
+	unsigned long long instructions = 0, cycles = 0;  // for the whole run
+
+	void print(std::ostream &out) const;  // for tiger --profile
+};
+
+// Run a HERA program (the text of a .hera file, from "where", which is used for messages and
+//  as the first place to look for #include'd files, before include_dirs), with the program's
+//  output going to "out" and its input coming from "in".
+// Returns 0 if it ran to a HALT; otherwise prints what went wrong on "errors" and returns 1.
+int HERA_run(const string &program, const string &where, const std::vector<string> &include_dirs,
+	     std::istream &in, std::ostream &out, std::ostream &errors, HERA_profile *profile = 0,
+	     bool jit = false);
+
+#endif
@@ -0,0 +1,515 @@
+#include <cstddef>
+#include <cstring>
+#include "HERA_machine.h"
+
+/*
+ * Running a loaded HERA program as x86-64 code, for tiger --run (see HERA_interpreter.h)
+ *
+ * The whole program is translated once, when it's loaded, one HERA instruction at a time, into one
+ *  block of x86-64 code, so each branch, CALL and RETURN is a jump straight to the code for where
+ *  it goes (a RETURN goes through a table, since where it goes is in a register):
+ *  - R1-R5, Rt, FP_alt, PC_ret, FP and SP live in x86 registers (rbx, rbp, rsi, rdi, r8-r13), and the
+ *    other HERA registers in the jit_state that r15 points to; r14 points to the HERA memory;
+ *  - the flags are only worked out when something might look at them: we find which of them each
+ *    instruction sets that a branch could still see (going through branches and CALLs, and taking
+ *    each RETURN to need them all), and only store those, with a setcc of the x86 flags of the
+ *    same 16-bit operation (HERA's carry after a subtraction is x86's "no borrow");
+ *  - a conditional branch right after what set its flags (e.g. CMP then BL) is just a jcc,
+ *    unless another branch goes to it; a RETURN that gets there anyway uses the stored flags;
+ *  - the library routines done in C++ (print, getint, div, ...) are calls to HERA_machine::native.
+ *
+ * That needs the carry block to be on for the whole run, which it is for the programs the compiler
+ *  writes (they start with CBON(), and nothing turns it off), so we only take programs that start
+ *  with CBON and have no CCBOFF; anything else, and anywhere but x86-64 Linux, the interpreter runs.
+ *  A RETURN is assumed to go back just after a CALL, as the flags are all stored before any RETURN.
+ */
+
+#if defined __x86_64__ && defined __linux__
+
+#include <sys/mman.h>
+
+// what the x86 code keeps in memory (r15 points to this)
+struct jit_state {
+	uint16_t R[16];      // the HERA registers that aren't in x86 registers (and all of them, before and after)
+	uint8_t s, z, v, c;  // the flags that were stored
+	uint32_t pc;         // for an error: the instruction after the one that went wrong
+	HERA_machine *machine;
+	string *error;
+};
+
+// how the x86 code stops
+enum jit_exit { jit_halt, jit_stack_overflow, jit_ran_off_the_end, jit_native_error };
+
+// the x86 registers: eax, ecx and edx are for working things out, r14 and r15 are the memory and jit_state
+const int eax = 0, ecx = 1, edx = 2;
+static const int host_register[16] = {-1, 3 /*rbx*/, 5 /*rbp*/, 6 /*rsi*/, 7 /*rdi*/, 8, -1, -1, -1, -1, -1,
+				      9 /*Rt*/, 11 /*FP_alt*/, 10 /*PC_ret*/, 12 /*FP*/, 13 /*SP*/};
+static const int caller_saved[] = {6, 7, 8, 9, 10, 11};  // the ones of those a C++ function can change
+
+// the flags, as bits, and which ones each instruction sets or branch uses
+const int flag_s = 1, flag_z = 2, flag_v = 4, flag_c = 8, all_flags = 15;
+
+static int flags_set(const decoded_insn &i)
+{
+	switch (i.op) {
+	case op_ADD: case op_SUB: case op_INC: case op_DEC: case op_CMP: case op_NEG: case op_ASL:
+		return all_flags;
+	case op_MUL: case op_AND: case op_OR: case op_XOR: case op_LSL8: case op_LSR8: case op_LOAD: case op_MOVE: case op_NOT:
+		return flag_s | flag_z;
+	case op_LSL: case op_LSR: case op_ASR:
+		return flag_s | flag_z | flag_c;
+	case op_SETC: case op_CLRC:
+		return flag_c;
+	default:
+		return 0;
+	}
+}
+
+static int flags_used(const decoded_insn &i)
+{
+	static const int by_branch[] = {0, flag_s | flag_v, flag_s | flag_v, flag_s | flag_v | flag_z, flag_s | flag_v | flag_z,
+					flag_c | flag_z, flag_c | flag_z, flag_z, flag_z, flag_c, flag_c, flag_s, flag_s, flag_v, flag_v};
+	return i.op == op_BRANCH ? by_branch[i.a] : 0;
+}
+
+// What the x86 flags mean after the operation for an instruction: which x86 condition (or -1 for none)
+//  is each HERA branch, with HERA's carry being CF after an addition or shift, and not CF after a subtraction;
+//  shifts don't give us a HERA overflow, and logical operations (done with a TEST, for MOVE and LOAD) only s and z
+enum flags_kind { after_add, after_subtract, after_shift, after_logical };
+static const signed char condition_after[4][15] = {
+	// BR   BL   BGE  BLE  BG  BULE BUG BZ BNZ BC BNC BS BNS BV BNV
+	{  -1, 0xC, 0xD, 0xE, 0xF, -1, -1, 4, 5,  2, 3, 8, 9,  0, 1 },
+	{  -1, 0xC, 0xD, 0xE, 0xF,  6,  7, 4, 5,  3, 2, 8, 9,  0, 1 },
+	{  -1,  -1,  -1,  -1,  -1, -1, -1, 4, 5,  2, 3, 8, 9, -1, -1 },
+	{  -1,  -1,  -1,  -1,  -1, -1, -1, 4, 5, -1, -1, 8, 9, -1, -1 },
+};
+const int x86_S = 8, x86_E = 4, x86_O = 0, x86_B = 2, x86_AE = 3, x86_NE = 5;
+
+// a C++ library routine, for the x86 code; returns 0, or 1 (with the message in state->error) if it failed
+static int jit_native(jit_state *state, int routine, unsigned fp)
+{
+	return state->machine->native(routine, uint16_t(fp), *state->error) ? 0 : 1;
+}
+
+class HERA_jit {
+public:
+	HERA_jit(const HERA_machine &machine) : code(machine.code), n(machine.code.size()) {}
+	bool translate();  // false if it's not a program we can do
+	std::vector<uint8_t> bytes;           // the x86 code
+	std::vector<unsigned long> entry;     // where each instruction starts in it, for a RETURN
+	std::vector<unsigned long> table_at;  // where to put the address of the RETURN table
+
+private:
+	const std::vector<decoded_insn> &code;
+	const unsigned long n;
+	std::vector<unsigned long> at;  // where each instruction's code is; at[n] runs off the end, at[n+1] is the exit
+	std::vector<int> live_out;      // the flags that might be looked at after each instruction
+	std::vector<bool> target;       // can anything but the instruction before go here?
+	int fused_condition = -1;       // for a branch right after the instruction that set its flags
+
+	struct jump { unsigned long site; unsigned long to; };  // a rel32 at site, to instruction "to" (or n, or n+1)
+	std::vector<jump> jumps;
+	struct error_exit { unsigned long site; jit_exit why; long pc; };  // pc -1 for "it's in edx"
+	std::vector<error_exit> error_exits;
+	std::vector<unsigned long> unfused;  // branches that a RETURN could get to without their flags in x86
+
+	void put(std::initializer_list<int> b) { for (int x : b) bytes.push_back(uint8_t(x)); }
+	void put32(uint32_t x) { for (int i = 0; i < 4; i++) bytes.push_back(uint8_t(x >> (8 * i))); }
+	void put64(uint64_t x) { for (int i = 0; i < 8; i++) bytes.push_back(uint8_t(x >> (8 * i))); }
+	void patch32(unsigned long site, unsigned long to) {
+		uint32_t rel = uint32_t(long(to) - long(site + 4));
+		memcpy(&bytes[site], &rel, 4);
+	}
+
+	void find_targets_and_flags();
+	void load(int r, int x);
+	void store(int x, int r);
+	void set(int x, uint32_t value) { put({0xB8 + x}); put32(value); }  // mov x, value
+	void go_to(int condition, unsigned long instruction);  // jcc (or jmp, for -1)
+	void exit_if(int condition, jit_exit why, long pc);
+	void flags(unsigned long i, flags_kind kind, bool may_fuse = true);
+	void branch_on_stored_flags(const decoded_insn &i);
+	void translate(unsigned long i);
+};
+
+static int state_offset(size_t offset) { return int(offset); }  // all under 128, so they fit in a disp8
+#define STATE(field) state_offset(offsetof(jit_state, field))
+
+// HERA register r to x (eax, ecx or edx), zero-extended
+void HERA_jit::load(int r, int x)
+{
+	int h = host_register[r];
+	if (r == 0) {
+		set(x, 0);                                                 // (not xor, which would change the flags)
+	} else if (h >= 0) {
+		if (h >= 8) put({0x41});
+		put({0x8B, 0xC0 | x << 3 | (h & 7)});                    // mov x, h
+	} else {
+		put({0x41, 0x0F, 0xB7, 0x47 | x << 3, 2 * r});          // movzx x, word [r15 + 2r]
+	}
+}
+
+// the low 16 bits of x to HERA register r (which doesn't change the x86 flags)
+void HERA_jit::store(int x, int r)
+{
+	int h = host_register[r];
+	if (r == 0) return;
+	if (h >= 0) {
+		if (h >= 8) put({0x44});
+		put({0x0F, 0xB7, 0xC0 | (h & 7) << 3 | x});             // movzx h, x16
+	} else {
+		put({0x66, 0x41, 0x89, 0x47 | x << 3, 2 * r});          // mov [r15 + 2r], x16
+	}
+}
+
+void HERA_jit::go_to(int condition, unsigned long instruction)
+{
+	if (condition < 0) put({0xE9});
+	else put({0x0F, 0x80 | condition});
+	jumps.push_back({bytes.size(), instruction});
+	put32(0);
+}
+
+void HERA_jit::exit_if(int condition, jit_exit why, long pc)
+{
+	put({0x0F, 0x80 | condition});
+	error_exits.push_back({bytes.size(), why, pc});
+	put32(0);
+}
+
+// Which instructions can be gone to from elsewhere, and then which flags might be looked at
+//  after each one, going backwards until nothing changes (a RETURN could go anywhere after a CALL,
+//  so it needs them all)
+void HERA_jit::find_targets_and_flags()
+{
+	target.assign(n + 1, false);
+	target[0] = true;
+	for (unsigned long i = 0; i < n; i++) {
+		if (code[i].op == op_BRANCH || code[i].op == op_CALL) target[code[i].value] = true;
+		if (code[i].op == op_CALL) target[i + 1] = true;
+	}
+
+	live_out.assign(n, 0);
+	std::vector<int> live_in(n + 1, 0);
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (unsigned long i = n; i-- > 0; ) {
+			const decoded_insn &in = code[i];
+			int out;
+			switch (in.op) {
+			case op_BRANCH: out = live_in[in.value] | (in.a != 0 ? live_in[i + 1] : 0); break;
+			case op_CALL:   out = live_in[in.value]; break;
+			case op_RETURN: out = all_flags; break;
+			case op_HALT:   out = 0; break;
+			default:        out = live_in[i + 1]; break;
+			}
+			int in_flags = flags_used(in) | (out & ~flags_set(in));
+			if (out != live_out[i] || in_flags != live_in[i]) {
+				live_out[i] = out;
+				live_in[i] = in_flags;
+				changed = true;
+			}
+		}
+	}
+}
+
+// Just after the x86 instruction that set the flags for instruction i: store the ones that might be
+//  looked at, other than by a branch that can use the x86 flags (see above) -- which is then fused_condition.
+//  If the code for i goes on to change the x86 flags itself, it says may_fuse = false, so they're all stored.
+void HERA_jit::flags(unsigned long i, flags_kind kind, bool may_fuse)
+{
+	int keep = live_out[i];
+	fused_condition = -1;
+	if (may_fuse && i + 1 < n && code[i+1].op == op_BRANCH && code[i+1].a != 0 && !target[i+1] &&
+	    condition_after[kind][code[i+1].a] >= 0) {
+		fused_condition = condition_after[kind][code[i+1].a];
+		keep = live_out[i+1];
+	}
+	keep &= flags_set(code[i]);
+	auto setcc = [this](int condition, int offset) { put({0x41, 0x0F, 0x90 | condition, 0x47, offset}); };  // setcc [r15 + offset]
+	if (keep & flag_s) setcc(x86_S, STATE(s));
+	if (keep & flag_z) setcc(x86_E, STATE(z));
+	if (keep & flag_v) setcc(x86_O, STATE(v));
+	if (keep & flag_c) setcc(kind == after_subtract ? x86_AE : x86_B, STATE(c));
+}
+
+void HERA_jit::branch_on_stored_flags(const decoded_insn &i)
+{
+	auto al_op = [this](int opcode, int offset) { put({0x41, opcode, 0x47, offset}); };  // op al, [r15 + offset]
+	const int mov = 0x8A, cmp = 0x3A, xor_ = 0x32, or_ = 0x0A;
+	static const int flag_of[] = {0, 0, 0, 0, 0, 0, 0, STATE(z), STATE(z), STATE(c), STATE(c), STATE(s), STATE(s), STATE(v), STATE(v)};
+	int which = i.a;
+	if (which == 0) {                      // BR
+		go_to(-1, i.value);
+	} else if (which >= 7) {               // one flag: on for BZ, BC, BS, BV; off for the others
+		put({0x41, 0x80, 0x7F, flag_of[which], 0});  // cmp byte [r15 + flag], 0
+		go_to(which % 2 == 1 ? x86_NE : x86_E, i.value);
+	} else if (which <= 2) {               // BL, BGE: s != v
+		al_op(mov, STATE(s));
+		al_op(cmp, STATE(v));
+		go_to(which == 1 ? x86_NE : x86_E, i.value);
+	} else {                               // BLE, BG: (s != v) || z; BULE, BUG: !c || z
+		if (which <= 4) {
+			al_op(mov, STATE(s));
+			al_op(xor_, STATE(v));
+		} else {
+			al_op(mov, STATE(c));
+			put({0x34, 0x01});             // xor al, 1
+		}
+		al_op(or_, STATE(z));
+		go_to(which % 2 == 1 ? x86_NE : x86_E, i.value);
+	}
+}
+
+void HERA_jit::translate(unsigned long i)
+{
+	const decoded_insn &in = code[i];
+	int fused = fused_condition;  // from the instruction before
+	fused_condition = -1;
+	auto push_or_pop = [this](int opcode, int h) { if (h >= 8) put({0x41}); put({opcode + (h & 7)}); };
+	// the 16-bit operations, on ax and cx
+	auto alu = [this](int opcode) { put({0x66, opcode, 0xC8}); };   // op ax, cx
+	auto test = [this]() { put({0x66, 0x85, 0xC0}); };               // test ax, ax
+	auto two = [&](int opcode, flags_kind kind) {
+		load(in.a, eax);
+		load(in.b, ecx);
+		alu(opcode);
+		flags(i, kind);
+		store(eax, in.d);
+	};
+	auto one = [&](std::initializer_list<int> operation, flags_kind kind) {
+		load(in.a, eax);
+		put(operation);
+		flags(i, kind);
+		store(eax, in.d);
+	};
+	auto address = [&]() {   // R[a] + offset, to eax
+		load(in.a, eax);
+		if (in.value != 0) {
+			put({0x05});         // add eax, offset
+			put32(uint32_t(in.value));
+			put({0x0F, 0xB7, 0xC0});  // movzx eax, ax
+		}
+	};
+
+	switch (in.op) {
+	case op_SETLO:  set(eax, uint16_t(int8_t(in.value & 0xFF))); store(eax, in.d); break;
+	case op_SET:    set(eax, uint16_t(in.value)); store(eax, in.d); break;
+	case op_SETHI:
+		load(in.d, eax);
+		put({0x25}); put32(0xFF);                          // and eax, 0xFF
+		put({0x0D}); put32(uint32_t((in.value & 0xFF) << 8));  // or eax, value << 8
+		store(eax, in.d);
+		break;
+	case op_AND:    two(0x21, after_logical); break;
+	case op_OR:     two(0x09, after_logical); break;
+	case op_XOR:    two(0x31, after_logical); break;
+	case op_ADD:    two(0x01, after_add); break;
+	case op_SUB:    two(0x29, after_subtract); break;
+	case op_MUL:
+		load(in.a, eax);
+		load(in.b, ecx);
+		put({0x66, 0x0F, 0xAF, 0xC1});                    // imul ax, cx
+		test();
+		flags(i, after_logical);
+		store(eax, in.d);
+		break;
+	case op_INC:
+	case op_DEC: {
+		bool check_SP = in.op == op_INC && in.d == 15;  // (its cmp changes the x86 flags, so a branch can't use them)
+		load(in.d, eax);
+		put({0x66, in.op == op_INC ? 0x05 : 0x2D, in.value & 0xFF, (in.value >> 8) & 0xFF});  // add/sub ax, value
+		flags(i, in.op == op_INC ? after_add : after_subtract, !check_SP);
+		store(eax, in.d);
+		if (check_SP) {
+			put({0x3D}); put32(heap_start);                // cmp eax, heap_start
+			exit_if(x86_AE, jit_stack_overflow, i + 1);
+		}
+		break;
+	}
+	case op_LSL:    one({0x66, 0xD1, 0xE0}, after_shift); break;       // shl ax, 1
+	case op_LSR:    one({0x66, 0xD1, 0xE8}, after_shift); break;       // shr ax, 1
+	case op_ASL:    one({0x66, 0xD1, 0xE0}, after_add); break;         // (with OF as HERA's overflow)
+	case op_ASR:    one({0x66, 0xD1, 0xF8}, after_shift); break;       // sar ax, 1
+	case op_LSL8:   one({0x66, 0xC1, 0xE0, 8}, after_logical); break;  // shl ax, 8
+	case op_LSR8:   one({0x66, 0xC1, 0xE8, 8}, after_logical); break;  // shr ax, 8
+	case op_MOVE:   load(in.a, eax); test(); flags(i, after_logical); store(eax, in.d); break;
+	case op_NOT:
+		load(in.a, eax);
+		put({0x66, 0xF7, 0xD0});                           // not ax
+		test();
+		flags(i, after_logical);
+		set(ecx, 0xFFFF);
+		store(ecx, 11);
+		store(eax, in.d);
+		break;
+	case op_CMP:    load(in.a, eax); load(in.b, ecx); alu(0x39); flags(i, after_subtract); break;
+	case op_NEG:    load(0, eax); load(in.a, ecx); alu(0x29); flags(i, after_subtract); store(eax, in.d); break;
+	case op_SETC:
+	case op_CLRC:
+		if (live_out[i] & flag_c) put({0x41, 0xC6, 0x47, STATE(c), in.op == op_SETC});  // mov byte [r15 + c], 0 or 1
+		break;
+	case op_CBON:
+	case op_CCBOFF:  // (there's none)
+	case op_NOP:
+		break;
+	case op_LOAD:
+		address();
+		put({0x41, 0x0F, 0xB7, 0x04, 0x46});               // movzx eax, word [r14 + rax*2]
+		test();
+		flags(i, after_logical);
+		store(eax, in.d);
+		break;
+	case op_STORE:
+		address();
+		load(in.d, ecx);
+		put({0x66, 0x41, 0x89, 0x0C, 0x46});               // mov [r14 + rax*2], cx
+		break;
+	case op_BRANCH:
+		if (fused >= 0) {
+			go_to(fused, in.value);
+			unfused.push_back(i);
+		} else {
+			branch_on_stored_flags(in);
+		}
+		break;
+	case op_CALL:  // R13 is where to come back to, and FP and R[a] change places
+		load(14, eax);
+		load(in.a, ecx);
+		store(ecx, 14);
+		store(eax, in.a);
+		set(eax, uint32_t(i + 1));
+		store(eax, 13);
+		go_to(-1, in.value);
+		break;
+	case op_RETURN:
+		load(in.b, edx);
+		load(14, eax);
+		load(in.a, ecx);
+		store(ecx, 14);
+		store(eax, in.a);
+		set(eax, uint32_t(i + 1));
+		store(eax, in.b);
+		put({0x81, 0xFA}); put32(uint32_t(n));             // cmp edx, n
+		exit_if(x86_AE, jit_ran_off_the_end, -1);
+		put({0x48, 0xB8});                                 // mov rax, (the table)
+		table_at.push_back(bytes.size());
+		put64(0);
+		put({0xFF, 0x24, 0xD0});                           // jmp [rax + rdx*8]
+		break;
+	case op_NATIVE:
+		load(in.a, edx);
+		for (int h : caller_saved) push_or_pop(0x50, h);
+		put({0x4C, 0x89, 0xFF});                           // mov rdi, r15
+		put({0xBE}); put32(uint32_t(in.value));            // mov esi, routine
+		put({0x48, 0xB8}); put64(uint64_t(&jit_native));   // mov rax, jit_native
+		put({0xFF, 0xD0});                                 // call rax
+		for (int k = 5; k >= 0; k--) push_or_pop(0x58, caller_saved[k]);
+		put({0x85, 0xC0});                                 // test eax, eax
+		exit_if(x86_NE, jit_native_error, i + 1);
+		break;
+	case op_HALT:
+		load(0, eax);
+		go_to(-1, n + 1);
+		break;
+	}
+}
+
+bool HERA_jit::translate()
+{
+	if (n == 0 || code[0].op != op_CBON) return false;
+	for (const decoded_insn &i : code)
+		if (i.op == op_CCBOFF) return false;
+	find_targets_and_flags();
+
+	// start: save what C++ needs kept, and load the registers from the jit_state (rdi) and memory (rsi)
+	put({0x53, 0x55, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57});  // push rbx, rbp, r12, r13, r14, r15
+	put({0x48, 0x83, 0xEC, 0x08});                                        // sub rsp, 8 (so calls are 16-byte aligned)
+	put({0x49, 0x89, 0xFF, 0x49, 0x89, 0xF6});                            // mov r15, rdi; mov r14, rsi
+	for (int r = 0; r < 16; r++)
+		if (int h = host_register[r]; h >= 0)
+			put({0x41 | (h >= 8 ? 4 : 0), 0x0F, 0xB7, 0x47 | (h & 7) << 3, 2 * r});  // movzx h, word [r15 + 2r]
+
+	at.assign(n + 2, 0);
+	for (unsigned long i = 0; i < n; i++) {
+		at[i] = bytes.size();
+		translate(i);
+	}
+	at[n] = bytes.size();
+	put({0x41, 0xC7, 0x47, STATE(pc)}); put32(uint32_t(n));  // mov dword [r15 + pc], n
+	set(eax, jit_ran_off_the_end);
+
+	// the end: put the registers back in the jit_state, and return eax
+	at[n + 1] = bytes.size();
+	for (int r = 0; r < 16; r++)
+		if (int h = host_register[r]; h >= 0)
+			put({0x66, 0x41 | (h >= 8 ? 4 : 0), 0x89, 0x47 | (h & 7) << 3, 2 * r});  // mov [r15 + 2r], h16
+	put({0x48, 0x83, 0xC4, 0x08});                                        // add rsp, 8
+	put({0x41, 0x5F, 0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x5D, 0x5B, 0xC3});  // pop r15, r14, r13, r12, rbp, rbx; ret
+
+	for (const error_exit &e : error_exits) {
+		patch32(e.site, bytes.size());
+		if (e.pc < 0) put({0x41, 0x89, 0x57, STATE(pc)});  // mov [r15 + pc], edx
+		else { put({0x41, 0xC7, 0x47, STATE(pc)}); put32(uint32_t(e.pc)); }
+		set(eax, e.why);
+		go_to(-1, n + 1);
+	}
+
+	// a RETURN to a branch that uses the x86 flags goes here instead, and uses the stored ones
+	entry.assign(at.begin(), at.begin() + n);
+	for (unsigned long i : unfused) {
+		entry[i] = bytes.size();
+		branch_on_stored_flags(code[i]);
+		go_to(-1, i + 1);
+	}
+
+	for (const jump &j : jumps)
+		patch32(j.site, at[j.to]);
+	return true;
+}
+
+int HERA_jit_run(HERA_machine &machine, std::ostream &errors)
+{
+	HERA_jit jit(machine);
+	if (!jit.translate()) return -1;
+
+	unsigned long size = jit.bytes.size();
+	void *space = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (space == MAP_FAILED) return -1;
+	uint8_t *x86 = (uint8_t *) space;
+	std::vector<const uint8_t *> table(jit.entry.size());
+	for (unsigned long i = 0; i < table.size(); i++) table[i] = x86 + jit.entry[i];
+	uint64_t table_address = uint64_t(table.data());
+	for (unsigned long at : jit.table_at) memcpy(&jit.bytes[at], &table_address, 8);
+	memcpy(x86, jit.bytes.data(), size);
+	if (mprotect(space, size, PROT_READ | PROT_EXEC) != 0) {
+		munmap(space, size);
+		return -1;
+	}
+
+	string error;
+	jit_state state = {};
+	memcpy(state.R, machine.R, sizeof state.R);
+	state.machine = &machine;
+	state.error = &error;
+	int why = ((int (*)(jit_state *, uint16_t *)) space)(&state, machine.memory.data());
+	munmap(space, size);
+	memcpy(machine.R, state.R, sizeof state.R);
+
+	switch (why) {
+	case jit_halt:            machine.out->flush(); return 0;
+	case jit_stack_overflow:  return machine.fail(state.pc, "stack overflow", errors);
+	case jit_native_error:    return machine.fail(state.pc, error, errors);
+	default:                  return machine.fail(state.pc, "ran off the end of the program", errors);
+	}
+}
+
+#else
+
+int HERA_jit_run(HERA_machine &, std::ostream &)
+{
+	return -1;
+}
+
+#endif
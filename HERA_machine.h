@@ -0,0 +1,63 @@
+#if ! defined HERA_MACHINE_H
+#define HERA_MACHINE_H
+
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <set>
+#include <vector>
+#include "util.h"
+
+// A HERA program as HERA_interpreter.cpp loads it, for the interpreter and the JIT (HERA_jit.cpp);
+//  nothing else should need this (see HERA_interpreter.h)
+
+enum HERA_opcode : unsigned char {
+	op_SETLO, op_SETHI, op_SET, op_AND, op_OR, op_ADD, op_SUB, op_MUL, op_XOR, op_INC, op_DEC,
+	op_LSL, op_LSR, op_LSL8, op_LSR8, op_ASL, op_ASR, op_SETC, op_CLRC, op_CBON, op_CCBOFF,
+	op_LOAD, op_STORE, op_BRANCH, op_CALL, op_NATIVE, op_RETURN, op_HALT, op_NOP,
+	op_MOVE, op_CMP, op_NEG, op_NOT,
+};
+
+// the library routines we do in C++ (see HERA_interpreter.h); DIV and MOD are div and mod
+enum native_routine { native_print, native_printint, native_printbool, native_putchar_ord, native_getchar_ord,
+		      native_getint, native_getline, native_flush, native_div, native_mod, native_routines };
+
+struct decoded_insn {
+	HERA_opcode op;
+	unsigned char d, a, b;  // registers (for op_BRANCH, a is which branch: BR, BL, BGE, BLE, BG, BULE, BUG, BZ, BNZ, BC, BNC, BS, BNS, BV, BNV)
+	int value;              // constant, offset, or where to go (instruction number; or native_routine)
+};
+
+const int stack_start = 0, heap_start = 0x4000, heap_end = 0xBFFF, data_start = 0xC000;
+
+struct statement;
+
+struct HERA_machine {
+	std::vector<decoded_insn> code;
+	std::vector<int> cycles;            // for each instruction, from cost.h
+	std::vector<string> where;          // and where it came from
+	std::map<string, int> labels;       // LABEL's are instruction numbers, DLABEL's are addresses
+	std::set<string> code_labels;
+	std::vector<std::pair<int, string>> label_at;  // (instruction number, label), in order
+	std::vector<uint16_t> memory = std::vector<uint16_t>(65536, 0);
+	uint16_t R[16] = {0};
+	int unget_cell = -1, heap_cell = heap_start, heap_last = heap_end;
+
+	std::istream *in;
+	std::ostream *out;
+	std::vector<unsigned long long> counts;                       // for a profile: how many times each instruction ran
+	std::vector<unsigned long> calls, native_calls;               // and how many CALLs went to each instruction (or native)
+
+	void load(const std::vector<statement> &program);
+	int value(const string &arg, const string &where) const;
+	int reg(const string &arg, const string &where) const;
+	bool native(int routine, uint16_t fp, string &error);
+	template <bool profiling> int run(std::ostream &errors);
+	int fail(unsigned long pc, const string &message, std::ostream &errors);  // after instruction pc-1
+};
+
+// Run the program as x86-64 code (see HERA_jit.cpp), the same way HERA_machine::run does, and return what it does;
+//  or return -1, having run nothing, if it can't (not on x86-64 Linux, or a program it doesn't handle)
+int HERA_jit_run(HERA_machine &machine, std::ostream &errors);
+
+#endif
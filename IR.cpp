@@ -0,0 +1,210 @@
+#include <algorithm>
+#include "IR.h"
+#include "regalloc.h"
+#include "peephole.h"
+#include "cost.h"
+
+/*
+ * Building the IR from the HERA_code output, and turning it into the final HERA code
+ */
+
+static thread_local IR_program *the_current_program = 0;
+
+IR_program *IR_program::current()
+{
+	return the_current_program;
+}
+
+void IR_program::set_current(IR_program *p)
+{
+	the_current_program = p;
+}
+
+
+// union-find, for building webs
+struct web_finder {
+	std::vector<int> up;
+	int make() { up.push_back(up.size()); return up.size() - 1; }
+	int find(int x) { while (up[x] != x) x = up[x] = up[up[x]]; return x; }
+	void join(int a, int b) { up[find(a)] = find(b); }
+};
+
+IR_function IR_function_from_HERA(const string &label, int params, int save_slots, const HERA_insns &emitted)
+{
+	IR_function f;
+	f.label = label;
+	f.params = params;
+	f.save_slots = save_slots;
+	f.code = emitted;
+	HERA_insns &code = f.code;
+	int n = code.size();
+
+	int registers = 1;
+	for (const HERA_insn &insn : code)
+		for (const HERA_operand &a : insn.args)
+			registers = std::max(registers, HERA_register_number(a) + 1);
+	auto register_of = [](const HERA_operand &a) { int r = HERA_register_number(a); return r > 0 ? r : -1; };
+	HERA_blocks blocks = HERA_find_blocks(code);
+	HERA_liveness live = HERA_find_liveness(code, blocks, registers, register_of);
+	int nb = blocks.count();
+
+	// each definition is a node, as is each register that's live at the start of a block;
+	//  a use joins the node(s) that reach it, and the end of a block joins the starts of its successors
+	web_finder webs;
+	std::vector<int> node_register;
+	std::vector<std::vector<int>> start_node(nb, std::vector<int>(registers, -1)), end_node(nb);
+	std::vector<std::vector<int>> operand_node(n);
+	for (int b = 0; b < nb; b++)
+		for (int r = 1; r < registers; r++)
+			if (live.live_in[b][r]) {
+				start_node[b][r] = webs.make();
+				node_register.push_back(r);
+			}
+	for (int b = 0; b < nb; b++) {
+		std::vector<int> current = start_node[b];
+		for (int i = blocks.first[b]; i < blocks.first[b+1]; i++) {
+			operand_node[i].assign(code[i].args.size(), -1);
+			for (unsigned j = 0; j < code[i].args.size(); j++) {
+				HERA_operand_role role = HERA_role(code[i], j);
+				int r = register_of(code[i].args[j]);
+				if (r > 0 && (role == HERA_use || role == HERA_use_def)) {
+					if (current[r] < 0) {  // can't happen if liveness is right, but don't crash
+						current[r] = webs.make();
+						node_register.push_back(r);
+					}
+					operand_node[i][j] = current[r];
+				}
+			}
+			for (unsigned j = 0; j < code[i].args.size(); j++) {
+				HERA_operand_role role = HERA_role(code[i], j);
+				int r = register_of(code[i].args[j]);
+				if (r > 0 && role == HERA_def) {
+					current[r] = operand_node[i][j] = webs.make();
+					node_register.push_back(r);
+				}
+			}
+		}
+		end_node[b] = current;
+	}
+	for (int b = 0; b < nb; b++)
+		for (int s : blocks.successors[b])
+			for (int r = 1; r < registers; r++)
+				if (live.live_in[s][r])
+					webs.join(end_node[b][r], start_node[s][r]);
+
+	// and each web is a temporary
+	std::vector<int> temporary_of_node(node_register.size(), -1);
+	for (int i = 0; i < n; i++)
+		for (unsigned j = 0; j < code[i].args.size(); j++)
+			if (operand_node[i][j] >= 0) {
+				int root = webs.find(operand_node[i][j]);
+				if (temporary_of_node[root] < 0)
+					temporary_of_node[root] = f.new_temporary(node_register[root]);
+				code[i].args[j] = HERA_temporary(temporary_of_node[root]);
+			}
+
+	f.update_cfg();
+	return f;
+}
+
+
+// does "code" mention "operand" anywhere?
+static bool mentions(const HERA_insns &code, const HERA_operand &operand)
+{
+	for (const HERA_insn &insn : code)
+		if (std::find(insn.args.begin(), insn.args.end(), operand) != insn.args.end()) return true;
+	return false;
+}
+
+// the code for a function: save what we need to, run the body, restore, and return
+//
+// A "leaf" that CALLs nothing (e.g. after inline.h) only saves PC_ret and FP_alt if the body
+//  uses them (the spill code might use PC_ret, and an inlined call sets up a frame at FP_alt).
+//  If it also doesn't look at SP (other than to INC and DEC it), nothing else uses the stack while
+//  it runs, so it doesn't need to move SP past its save slots.
+static HERA_insns function_code(const IR_function &f)
+{
+	HERA_insns body = allocate_registers(f);
+	unsigned long long written = HERA_registers_written(body);
+	auto slot = [&f](int r) { return HERA_number(2+f.params+r); };
+	bool calls = false, looks_at_SP = false;
+	for (const HERA_insn &insn : body) {
+		if (insn.op == HERA_CALL) calls = true;
+		if (insn.op != HERA_INC && insn.op != HERA_DEC && std::find(insn.args.begin(), insn.args.end(), HERA_SP) != insn.args.end())
+			looks_at_SP = true;
+	}
+	bool save_PC_ret = calls || mentions(body, HERA_PC_ret), save_FP_alt = calls || mentions(body, HERA_FP_alt);
+	bool move_SP = calls || looks_at_SP;
+
+	HERA_insns code = { HERA_insn(HERA_LABEL, {HERA_label(f.label)}) };
+	if (save_PC_ret) code.push_back(HERA_insn(HERA_STORE, {HERA_PC_ret, HERA_number(0), HERA_FP}));
+	if (save_FP_alt) code.push_back(HERA_insn(HERA_STORE, {HERA_FP_alt, HERA_number(1), HERA_FP}));
+	code.push_back(HERA_text("//save registers \n"));
+	if (move_SP) code.push_back(HERA_insn(HERA_INC, {HERA_SP, HERA_number(f.save_slots)}));
+	for (int i = 1; i <= f.save_slots && i < 64; i++)  // save only the registers the body writes
+		if (written & (1ull << i)) code.push_back(HERA_insn(HERA_STORE, {HERA_register(i), slot(i), HERA_FP}));
+
+	code.insert(code.end(), body.begin(), body.end());
+
+	for (int i = 1; i <= f.save_slots && i < 64; i++)
+		if (written & (1ull << i)) code.push_back(HERA_insn(HERA_LOAD, {HERA_register(i), slot(i), HERA_FP}));
+	if (move_SP) code.push_back(HERA_insn(HERA_DEC, {HERA_SP, HERA_number(f.save_slots)}));
+	if (save_PC_ret) code.push_back(HERA_insn(HERA_LOAD, {HERA_PC_ret, HERA_number(0), HERA_FP}));
+	if (save_FP_alt) code.push_back(HERA_insn(HERA_LOAD, {HERA_FP_alt, HERA_number(1), HERA_FP}));
+	code.push_back(HERA_insn(HERA_RETURN, {HERA_FP_alt, HERA_PC_ret}));
+	code.push_back(HERA_text("\n"));
+	return code;
+}
+
+void IR_emit_HERA(IR_program &program, HERA_emitter &out, peephole_report &report, cost_report *costs)
+{
+	out << "#include \"Tiger-stdlib-stack-data.hera\"\n\n";
+	out << program.data;
+	out << "CBON()\n\n";  // was SETCB for HERA 2.3
+	if (program.main.save_slots > 0) out << "INC(SP, " << str(program.main.save_slots) << ")\n";
+	HERA_insns main_code = allocate_registers(program.main);
+	peephole_optimize(main_code, report);
+	if (costs) costs->add("", 0, program.main.save_slots, main_code);
+	if (program.mark_lines) cost_remove_line_marks(main_code);
+	HERA_write(main_code, out);
+	out << "\n\nHALT()\n\n";
+
+	for (const IR_function &f : program.functions) {
+		HERA_insns code = function_code(f);
+		peephole_optimize(code, report);
+		if (costs) costs->add(f.label, f.params, f.save_slots, code);
+		if (program.mark_lines) cost_remove_line_marks(code);
+		HERA_write(code, f.cache_group < 0 ? out : program.cache_groups[f.cache_group].code);
+	}
+	for (const function_group &group : program.cache_groups) {
+		if (costs && group.from_cache) costs->add_cached(group.function_labels, HERA_parse(group.code.as_string()));
+		out << group.code;
+	}
+
+	out << "#include \"Tiger-stdlib-stack.hera\"\n";
+}
+
+
+static void print_function(const IR_function &f, std::ostream &out)
+{
+	out << (f.is_main() ? string("main program") : "function " + f.label)
+	    << ": " << f.params << " params, " << f.save_slots << " save slots, "
+	    << f.temporaries() << " temporaries\n";
+	for (int b = 0; b < f.cfg.count(); b++) {
+		out << "  block " << b << " (to";
+		for (int s : f.cfg.successors[b]) out << " " << s;
+		out << ")\n";
+		HERA_insns block(f.code.begin() + f.cfg.first[b], f.code.begin() + f.cfg.first[b+1]);
+		HERA_emitter text;
+		HERA_write(block, text);
+		text.write_to(out);
+	}
+	out << "\n";
+}
+
+void IR_print(const IR_program &program, std::ostream &out)
+{
+	print_function(program.main, out);
+	for (const IR_function &f : program.functions)
+		print_function(f, out);
+}
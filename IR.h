@@ -0,0 +1,69 @@
+#if ! defined IR_H
+#define IR_H
+
+#include <iostream>
+#include <vector>
+#include "HERA_IR.h"
+#include "cache.h"
+
+// The intermediate representation of a Tiger program, between the AST and the HERA we print:
+//  the data the program needs, and the code of the main program and of each function,
+//  each kept separately, as a control flow graph of basic blocks of instructions.
+//
+// The instructions are HERA instructions, but on temporaries (%t0, %t1, ...) rather than registers:
+//  A_root_::lower_to_IR runs HERA_code (which picks registers with the result_reg numbering, and
+//  builds the HERA_insns directly)
+//  for the main program and each function body, and then gives each value its own temporary,
+//  one for each "web" of definitions and uses of one of those registers that reach each other.
+//  Everything is a 16-bit word on HERA (and the Tiger types have been checked by then), so what we
+//  keep about each temporary is the register it came from, its "home", which is a register
+//  it can always go back to, and says where it goes if it's spilled (see regalloc.h).
+//
+// IR_emit_HERA then allocates registers for each function and writes out the whole HERA program,
+//  including the code to save and restore registers in each function,
+//  after a last clean-up by the peephole optimizer (see peephole.h).
+//  With --cache-dir, the final code of each function in a cache group goes into the group,
+//  and the groups' code (including any that came from the cache) goes at the end.
+//  For --cost-report, it also adds each function's final code to a cost_report (see cost.h).
+//
+// Passes over the IR (e.g. optimizations) go between the two, and should call update_cfg()
+//  after changing the code.
+
+struct IR_function {
+	string label;        // where CALL goes; "" for the main program
+	int params = 0;      // argument slots; see layout_frames.cpp for these two
+	int save_slots = 0;  // slots for saving (and spilling) registers; for main, just for spilling
+	HERA_insns code;
+	std::vector<int> temporary_home;  // for each temporary, the register it came from
+	HERA_blocks cfg;
+	int cache_group = -1;  // for --cache-dir, which of IR_program::cache_groups it belongs to
+
+	int new_temporary(int home) { temporary_home.push_back(home); return temporary_home.size() - 1; }
+	int temporaries() const { return temporary_home.size(); }
+	void update_cfg() { cfg = HERA_find_blocks(code); }
+	bool is_main() const { return label == ""; }
+};
+
+struct IR_program {
+	HERA_emitter data;  // from HERA_data
+	IR_function main;
+	std::vector<IR_function> functions;  // in the order they're lowered, so inner ones first
+	string cache_dir;  // for --cache-dir; "" if we're not using the cache
+	std::vector<function_group> cache_groups;  // see cache.h; cached ones have no IR_functions
+	bool mark_lines = false;  // for --cost-report, HERA_code marks the source lines (see cost.h)
+
+	// A_fundec_::HERA_code adds each function to the "current" program;
+	//  each thread lowers one program at a time (see A_root_::lower_to_IR)
+	static IR_program *current();
+	static void set_current(IR_program *p);
+};
+
+// Turn HERA_code's output for the main program or a function body into an IR_function
+IR_function IR_function_from_HERA(const string &label, int params, int save_slots, const HERA_insns &code);
+
+struct peephole_report;
+struct cost_report;
+void IR_emit_HERA(IR_program &program, HERA_emitter &out, peephole_report &report, cost_report *costs = 0);
+void IR_print(const IR_program &program, std::ostream &out);  // for -di
+
+#endif
@@ -10,9 +10,13 @@
  *  Add "ST-2024" to your CMakeList.txt file, so it gets built and used.
  */
 
+#include <chrono>
+#include <iostream>
+#include <vector>
 #include <logic.h>
 #include "errormsg.h"
 #include "ST-2024.h"
+#include "ST-hashed.h"
 #include "types.h"
 #include <hc_list.h>	// gets files from /home/courses/include folder, thanks to -I flag on compiler
 #include <hc_list_helpers.h>
@@ -152,7 +156,8 @@ void ST_examples()
    }
 }
 
-void ST_test() // NOTE: This is supposed to throw&catch some exceptions, since it's testing error cases.
+// The axioms from ST-2024.h, checked for either implementation (ST or ST_hashed)
+template <class ST_example> static void ST_axioms_test()
 {
 	try {
 		// empty ST
@@ -165,7 +170,7 @@ void ST_test() // NOTE: This is supposed to throw&catch some exceptions, since i
 			lookup(to_Symbol("Pat"), t1);
 			assert(false && "lookup should have failed above");
 		}
-		catch(ST_example::undefined_symbol missing) {
+		catch(typename ST_example::undefined_symbol missing) {
 			assert(Symbols_are_equal(missing.name, to_Symbol("Pat")));
 		}
 
@@ -173,7 +178,7 @@ void ST_test() // NOTE: This is supposed to throw&catch some exceptions, since i
 			lookup(to_Symbol("Dave"), t0);
 			assert(false && "lookup should have failed above");
 		}
-		catch(ST_example::undefined_symbol missing) {
+		catch(typename ST_example::undefined_symbol missing) {
 			assert(Symbols_are_equal(missing.name, to_Symbol("Dave")));
 		}
 
@@ -182,7 +187,7 @@ void ST_test() // NOTE: This is supposed to throw&catch some exceptions, since i
 			fuse(t1, ST_example(to_Symbol("Dave"), example_sym_info(15, 0)));
 			assert(false && "fuse should have failed above");
 		}
-		catch(ST_example::duplicate_symbol dup) {
+		catch(typename ST_example::duplicate_symbol dup) {
 			assert(Symbols_are_equal(to_Symbol("Dave"), dup.name));
 		}
 
@@ -197,7 +202,7 @@ void ST_test() // NOTE: This is supposed to throw&catch some exceptions, since i
 			lookup(to_Symbol("Pat"), t1);
 			assert(false && "lookup should have failed above");
 		}
-		catch(ST_example::undefined_symbol missing) {
+		catch(typename ST_example::undefined_symbol missing) {
 			assert(Symbols_are_equal(missing.name, to_Symbol("Pat")));
 		}
 
@@ -224,7 +229,7 @@ void ST_test() // NOTE: This is supposed to throw&catch some exceptions, since i
 			fuse(t12, t342a);
 			assert(false && "fuse should have failed above");
 		}
-		catch(ST_example::duplicate_symbol dup) {
+		catch(typename ST_example::duplicate_symbol dup) {
 			assert(Symbols_are_equal(to_Symbol("Pat"), dup.name));
 		}
 
@@ -236,6 +241,18 @@ void ST_test() // NOTE: This is supposed to throw&catch some exceptions, since i
 		assert(lookup(to_Symbol("Kris"), t12342a).pos == 40);
 
 		assert(lookup(to_Symbol("Pat"), t12).pos == 20);
+
+		// tables built with merge, merged onto each other (all of inner's scopes still come first)
+		ST_example big;
+		for (int i = 0; i < 9; i++)
+			big = fuse(ST_example(to_Symbol("n" + str(i)), example_sym_info(i, 0)), big);
+		ST_example nested = merge(ST_example(to_Symbol("Dave"), example_sym_info(11, 0)), merge(big, t34));
+		ST_example all = merge(nested, merge(big, t12342a));
+		assert(lookup(to_Symbol("Dave"), all).pos == 11);
+		assert(lookup(to_Symbol("n3"), all).pos == 3);
+		assert(lookup(to_Symbol("Kris"), all).pos == 40);
+		assert(lookup(to_Symbol("Pat"), all).pos == 25);
+		assert(!is_name_there(to_Symbol("Dave"), merge(big, t34)));
 	}
 	catch (...) {
 		assert(false && "test_st got an unexpected exception");
@@ -243,6 +260,60 @@ void ST_test() // NOTE: This is supposed to throw&catch some exceptions, since i
 }
 
 
+void ST_test() // NOTE: This is supposed to throw&catch some exceptions, since it's testing error cases.
+{
+	// Symbols are interned, so same spelling means same pointer (and same hash)
+	assert(to_Symbol("Dave") == to_Symbol(string("Da") + "ve"));
+	assert(to_Symbol("Dave") != to_Symbol("Pat"));
+	assert(Symbol_hash(to_Symbol("Dave")) == Symbol_hash(to_Symbol(string("Dave"))));
+
+	ST_axioms_test<ST<example_sym_info>>();
+	ST_axioms_test<ST_hashed<example_sym_info>>();
+}
+
+
+// Time the two implementations on the patterns the compiler uses, with big tables:
+//   "fuse":  build one 10,000-symbol scope, one symbol at a time (like a long list of declarations)
+//   "merge": 10,000 nested scopes of one symbol each (like create_variable), then one more big merge
+//   "lookup": find every symbol, in both of the above
+// Run tiger with --st-benchmark to see the results.
+template <class table> static void ST_benchmark_one(const char *name, const std::vector<Symbol> &names)
+{
+	using clock = std::chrono::steady_clock;
+	auto ms = [](clock::duration d) { return str(int(std::chrono::duration_cast<std::chrono::milliseconds>(d).count())); };
+	long checksum = 0;
+
+	auto start = clock::now();
+	table one_scope;
+	for (int i = 0; i < int(names.size()); i++)
+		one_scope = fuse(table(names[i], example_sym_info(i, 0)), one_scope);
+	auto fused = clock::now();
+	table nested;
+	for (int i = 0; i < int(names.size()); i++)
+		nested = merge(table(names[i], example_sym_info(i, 0)), nested);
+	table both = merge(one_scope, nested);
+	auto merged = clock::now();
+	for (Symbol n : names)
+		checksum += lookup(n, one_scope).pos + lookup(n, nested).pos + lookup(n, both).pos;
+	auto looked_up = clock::now();
+
+	std::cout << name << ": fuse " << ms(fused - start) << " ms, merge " << ms(merged - fused) <<
+		" ms, lookup " << ms(looked_up - merged) << " ms  (checksum " << checksum << ")" << std::endl;
+}
+
+void ST_benchmark()
+{
+	const int how_many = 10000;
+	std::vector<Symbol> names;
+	for (int i = 0; i < how_many; i++)
+		names.push_back(to_Symbol("sym" + str(i)));
+
+	std::cout << "Symbol table benchmark, " << how_many << " symbols" << std::endl;
+	ST_benchmark_one<ST<example_sym_info>>("ST (list)       ", names);
+	ST_benchmark_one<ST_hashed<example_sym_info>>("ST_hashed (trie)", names);
+}
+
+
 // IMPLEMENTATION
 
 
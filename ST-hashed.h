@@ -0,0 +1,87 @@
+///////////////////////////////////////////////////////////////////////
+// Hash-indexed version of the symbol table from ST-2024.h           //
+//   Same operations and axioms; see ST-2024.h for the documentation //
+///////////////////////////////////////////////////////////////////////
+
+#if ! defined ST_HASHED_H
+#define ST_HASHED_H 1
+
+// ST_hashed has exactly the interface of ST (constructors, fuse, merge, lookup, is_name_there,
+//  the duplicate_symbol/undefined_symbol exceptions, and __repr__), so either can be used
+//  in the typedefs in AST.h.
+//
+// The difference is the representation. ST keeps one linked list and copies the whole
+//  "inner" list on every merge, so lookup and merge are both O(n) in the number of symbols.
+// ST_hashed keeps a chain of scopes, each of which is a persistent hash trie
+//  (a "hash array mapped trie", 32-way branching on 5 bits of the Symbol's hash at a time).
+//  Tries are never changed once built, so tables can share them freely, just like ST shares nodes.
+//
+//  lookup/is_name_there:  O(1) per scope on the chain (a trie is at most 13 levels deep, usually 2-3)
+//  merge(inner, outer):   O(1) --- either a small "inner" is inserted into outer's innermost trie,
+//                                  or one new scope goes in front of outer's, which shares inner's
+//                                  whole chain of scopes (so lookup goes through that chain first)
+//  fuse(s1, s2):          inserts the smaller table into the larger, checking for duplicates
+//
+// As allowed by the comment on "fuse" in ST-2024.h, fuse requires tables built only by
+//  constructors and fuse (i.e., not the result of a merge).
+
+#include <memory>
+#include <list>
+#include "symbol.h"
+typedef Symbol name_type;
+
+
+template <class symbol_info> class ST_hashed;
+template <class symbol_info> struct ST_trie_node;
+template <class symbol_info> struct ST_scope;
+
+template <class symbol_info> bool is_name_there(const name_type &look_for_me, const ST_hashed<symbol_info> &in_this_table);
+template <class symbol_info> symbol_info &lookup(const name_type &must_find_this, const ST_hashed<symbol_info> &in_this_table);
+template <class symbol_info> ST_hashed<symbol_info> fuse(const ST_hashed<symbol_info> &s1, const ST_hashed<symbol_info> &s2);
+template <class symbol_info> ST_hashed<symbol_info> merge(const ST_hashed<symbol_info> &inner, const ST_hashed<symbol_info> &outer);
+
+
+template <class symbol_info> class ST_hashed {
+public:
+	ST_hashed();
+	ST_hashed(const name_type &name, const symbol_info &info);
+	explicit ST_hashed(std::pair<const name_type &, const symbol_info &>);
+	explicit ST_hashed(std::list<std::pair<const name_type &, const symbol_info &>>);
+
+	friend bool is_name_there<symbol_info>(const name_type &look_for_me, const ST_hashed<symbol_info> &in_this_table);
+	friend symbol_info &lookup<symbol_info>(const name_type &must_find_this, const ST_hashed<symbol_info> &in_this_table);
+	string __repr__();
+	string __str__()  { return this->__repr__(); }
+
+	class duplicate_symbol { // error type for exceptions
+	public:
+		name_type name;
+		duplicate_symbol(const name_type &n) : name(n) {}
+	};
+
+	class undefined_symbol {  // another exception type
+	public:
+		name_type name;
+		undefined_symbol(const name_type &n) : name(n) {}
+	};
+
+private:
+	typedef std::shared_ptr<const ST_scope<symbol_info>> scope_ptr;
+	scope_ptr innermost; // Null pointer means empty ST
+
+	explicit ST_hashed(scope_ptr s) : innermost(s) {}
+	symbol_info *check_for(const name_type &name) const;
+
+	friend ST_hashed<symbol_info> fuse<symbol_info>(const ST_hashed<symbol_info> &s1, const ST_hashed<symbol_info> &s2);
+	friend ST_hashed<symbol_info> merge<symbol_info>(const ST_hashed<symbol_info> &inner, const ST_hashed<symbol_info> &outer);
+};
+
+template <class symbol_info>  ST_hashed<symbol_info> FuseOneScope(const ST_hashed<symbol_info> &s1, const ST_hashed<symbol_info> &s2) { return fuse(s1, s2); }
+template <class symbol_info>  ST_hashed<symbol_info> MergeAndShadow(const ST_hashed<symbol_info> &inner, const ST_hashed<symbol_info> &outer) { return merge(inner, outer); }
+
+void ST_benchmark();  // time ST vs. ST_hashed on big tables; in ST-2024.cpp, next to ST_test
+
+
+#include "ST-hashed.t"
+
+#endif
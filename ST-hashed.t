@@ -0,0 +1,242 @@
+#include <bit>
+#include <vector>
+#include <logic.h>
+
+// A trie node has one slot per hash "digit" (5 bits of the hash) that's in use;
+//  "bitmap" says which digits those are, so slot i is for the i'th 1 bit in the bitmap.
+// A slot holds either one name (and its info) or a sub-trie for the next 5 bits.
+// Once the hash bits run out (only if two different names have identical hashes),
+//  the node just keeps a plain list of names, and the bitmap isn't used.
+
+template <class symbol_info> struct ST_trie_node {
+	typedef std::shared_ptr<const ST_trie_node<symbol_info>> ptr;
+	struct slot {
+		name_type n;        // 0 if this slot is a sub-trie
+		symbol_info *iptr;  // shared, as in ST
+		ptr child;
+	};
+	unsigned int bitmap = 0;
+	std::vector<slot> slots;
+};
+
+// A scope is usually one trie; but a merge of a table with several scopes onto another
+//  makes a scope that just points to the inner table's whole chain, which is searched
+//  (innermost first) before going on to "outer", so the merge doesn't have to copy that chain.
+template <class symbol_info> struct ST_scope {
+	typename ST_trie_node<symbol_info>::ptr trie;
+	int count;      // number of names in trie
+	bool shadows;   // true if a merge has folded some names into this trie, so it's not a simple "one scope"
+	std::shared_ptr<const ST_scope<symbol_info>> outer;  // null for the outermost scope
+	std::shared_ptr<const ST_scope<symbol_info>> inner_chain = 0;  // if not null, this scope is that chain, and trie is null
+};
+
+
+// THE TRIE OPERATIONS
+
+const int ST_trie_bits_per_level = 5;
+const int ST_trie_hash_bits = 8 * sizeof(size_t);
+
+template <class symbol_info> symbol_info *ST_trie_find(const ST_trie_node<symbol_info> *node, const name_type &name)
+{
+	size_t hash = Symbol_hash(name);
+	for (int shift = 0; node; shift += ST_trie_bits_per_level) {
+		if (shift >= ST_trie_hash_bits) {
+			for (auto &s : node->slots)
+				if (Symbols_are_equal(s.n, name))
+					return s.iptr;
+			return 0;
+		}
+		unsigned int bit = 1u << ((hash >> shift) & 31);
+		if (!(node->bitmap & bit))
+			return 0;
+		auto &s = node->slots[std::popcount(node->bitmap & (bit - 1))];
+		if (!s.child)
+			return Symbols_are_equal(s.n, name) ? s.iptr : 0;
+		node = s.child.get();
+	}
+	return 0;
+}
+
+// Return a new trie that is "node" plus name-->iptr, leaving "node" itself unchanged
+//  (only the nodes along the path to "name" are copied).
+// If "name" was already there, set already_there, and only replace its info if "replace" is set.
+template <class symbol_info> typename ST_trie_node<symbol_info>::ptr ST_trie_insert(const typename ST_trie_node<symbol_info>::ptr &node,
+																					  const name_type &name, symbol_info *iptr,
+																					  int shift, bool replace, bool &already_there)
+{
+	auto result = node ? std::make_shared<ST_trie_node<symbol_info>>(*node) : std::make_shared<ST_trie_node<symbol_info>>();
+
+	if (shift >= ST_trie_hash_bits) {
+		for (auto &s : result->slots)
+			if (Symbols_are_equal(s.n, name)) {
+				already_there = true;
+				if (replace) s.iptr = iptr;
+				return result;
+			}
+		result->slots.push_back({name, iptr, 0});
+		return result;
+	}
+
+	unsigned int bit = 1u << ((Symbol_hash(name) >> shift) & 31);
+	int index = std::popcount(result->bitmap & (bit - 1));
+	if (!(result->bitmap & bit)) {
+		result->bitmap |= bit;
+		result->slots.insert(result->slots.begin() + index, {name, iptr, 0});
+	} else {
+		auto &s = result->slots[index];
+		if (s.child) {
+			s.child = ST_trie_insert<symbol_info>(s.child, name, iptr, shift + ST_trie_bits_per_level, replace, already_there);
+		} else if (Symbols_are_equal(s.n, name)) {
+			already_there = true;
+			if (replace) s.iptr = iptr;
+		} else {  // two names share this digit, so push both down a level
+			bool ignore = false;
+			auto sub = ST_trie_insert<symbol_info>(0, s.n, s.iptr, shift + ST_trie_bits_per_level, false, ignore);
+			sub = ST_trie_insert<symbol_info>(sub, name, iptr, shift + ST_trie_bits_per_level, false, ignore);
+			s = {0, 0, sub};
+		}
+	}
+	return result;
+}
+
+template <class symbol_info, class F> void ST_trie_for_each(const ST_trie_node<symbol_info> *node, F do_this)
+{
+	if (node)
+		for (auto &s : node->slots)
+			if (s.child)
+				ST_trie_for_each(s.child.get(), do_this);
+			else
+				do_this(s.n, s.iptr);
+}
+
+
+// PUBLIC FUNCTIONS
+
+template <class symbol_info> ST_hashed<symbol_info>::ST_hashed()
+{
+}
+
+template <class symbol_info> ST_hashed<symbol_info>::ST_hashed(const name_type &name, const symbol_info &info)
+{
+	bool ignore = false;
+	innermost = scope_ptr(new ST_scope<symbol_info>{ST_trie_insert<symbol_info>(0, name, new symbol_info(info), 0, false, ignore), 1, false, 0});
+}
+
+template <class symbol_info> ST_hashed<symbol_info>::ST_hashed(std::pair<const name_type &, const symbol_info &> entry) :
+	ST_hashed(entry.first, entry.second)
+{
+}
+
+template <class symbol_info> ST_hashed<symbol_info>::ST_hashed(std::list<std::pair<const name_type &, const symbol_info &>> entries)
+{
+	for (auto entry: entries) {
+		*this = FuseOneScope(ST_hashed(entry), *this);
+	}
+}
+
+template <class symbol_info> ST_hashed<symbol_info> fuse(const ST_hashed<symbol_info> &s1, const ST_hashed<symbol_info> &s2)
+{
+	if (!s1.innermost) return s2;
+	if (!s2.innermost) return s1;
+	precondition(!s1.innermost->outer && !s1.innermost->shadows && !s2.innermost->outer && !s2.innermost->shadows &&
+				 "ST_hashed can only fuse tables that were not built with merge");
+
+	// insert the smaller one into the bigger one
+	const ST_scope<symbol_info> &big   = s1.innermost->count >= s2.innermost->count ? *s1.innermost : *s2.innermost;
+	const ST_scope<symbol_info> &small = s1.innermost->count >= s2.innermost->count ? *s2.innermost : *s1.innermost;
+	auto trie = big.trie;
+	ST_trie_for_each(small.trie.get(), [&trie](const name_type &n, symbol_info *iptr) {
+		bool already_there = false;
+		trie = ST_trie_insert<symbol_info>(trie, n, iptr, 0, false, already_there);
+		if (already_there)
+			throw typename ST_hashed<symbol_info>::duplicate_symbol(n);
+	});
+	return ST_hashed<symbol_info>(typename ST_hashed<symbol_info>::scope_ptr(new ST_scope<symbol_info>{trie, big.count + small.count, false, 0}));
+}
+
+// Merging a one-scope table of at most this many names just inserts them into the innermost
+//  trie of "outer" (replacing anything they shadow), so that the common pattern of
+//  merging one new variable at a time onto a table doesn't build up a long chain of scopes.
+const int ST_hashed_small_merge = 8;
+
+template <class symbol_info> ST_hashed<symbol_info> merge(const ST_hashed<symbol_info> &inner, const ST_hashed<symbol_info> &outer)
+{
+	if (!inner.innermost) return outer;
+	if (!outer.innermost) return inner;
+
+	typedef typename ST_hashed<symbol_info>::scope_ptr scope_ptr;
+	const ST_scope<symbol_info> &in = *inner.innermost, &out = *outer.innermost;
+	if (!in.outer && !in.inner_chain && in.count <= ST_hashed_small_merge && !out.inner_chain) {
+		auto trie = out.trie;
+		int count = out.count;
+		ST_trie_for_each(in.trie.get(), [&trie, &count](const name_type &n, symbol_info *iptr) {
+			bool already_there = false;
+			trie = ST_trie_insert<symbol_info>(trie, n, iptr, 0, true, already_there);
+			if (!already_there) count++;
+		});
+		return ST_hashed<symbol_info>(scope_ptr(new ST_scope<symbol_info>{trie, count, true, out.outer}));
+	} else if (!in.outer && !in.inner_chain) {
+		// put inner's one trie in front of outer's scopes
+		return ST_hashed<symbol_info>(scope_ptr(new ST_scope<symbol_info>{in.trie, in.count, true, outer.innermost}));
+	} else {
+		// one scope for all of inner's, which shares its chain rather than copying it
+		return ST_hashed<symbol_info>(scope_ptr(new ST_scope<symbol_info>{0, 0, true, outer.innermost, inner.innermost}));
+	}
+}
+
+template <class symbol_info> bool is_name_there(const name_type &look_for_me, const ST_hashed<symbol_info> &in_this_table)
+{
+	return in_this_table.check_for(look_for_me) != 0;
+}
+
+template <class symbol_info> symbol_info &lookup(const name_type &must_find_this, const ST_hashed<symbol_info> &in_this_table)
+{
+	symbol_info *it = in_this_table.check_for(must_find_this);
+	if (it == 0)
+		throw typename ST_hashed<symbol_info>::undefined_symbol(must_find_this);
+	else
+		return *it;
+}
+
+
+// PRIVATE OPERATIONS
+
+// the info for "name" in the first scope of "chain" that has it (going through the chains that merges share), or 0
+template <class symbol_info> symbol_info *ST_scope_find(const ST_scope<symbol_info> *chain, const name_type &name)
+{
+	for (auto s = chain; s; s = s->outer.get())
+		if (symbol_info *found = s->inner_chain ? ST_scope_find(s->inner_chain.get(), name) : ST_trie_find(s->trie.get(), name))
+			return found;
+	return 0;
+}
+
+// check for "name", innermost scope first; return ptr to its info or 0 if not there
+template <class symbol_info> symbol_info *ST_hashed<symbol_info>::check_for(const name_type &name) const
+{
+	return ST_scope_find(innermost.get(), name);
+}
+
+
+// PRINTING
+
+template <class symbol_info, class F> void ST_scope_for_each(const ST_scope<symbol_info> *chain, F do_this)
+{
+	for (auto s = chain; s; s = s->outer.get())
+		if (s->inner_chain)
+			ST_scope_for_each(s->inner_chain.get(), do_this);
+		else
+			ST_trie_for_each(s->trie.get(), do_this);
+}
+
+template <class symbol_info> string ST_hashed<symbol_info>::__repr__()
+{
+	String result = "ST(";
+	bool first = true;
+	ST_scope_for_each(innermost.get(), [&result, &first](const name_type &n, symbol_info *iptr) {
+		if (!first) result = result + ", ";
+		result = result + repr(n) + "-->" + repr(*iptr);
+		first = false;
+	});
+	result = result + ")";
+	return result;
+}
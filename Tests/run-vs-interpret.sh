@@ -0,0 +1,32 @@
+#!/bin/sh
+# Tests/run-vs-interpret.sh TIGER: run each program here (the .tig's, and the .hera's, which test
+#  the machine itself) with "TIGER --interpret" and with "TIGER --run", which has to give the same output
+#  and exit status, and if there's a PROGRAM.out, that output; PROGRAM.in, if it's there, is the input.
+# (ctest runs this; see CMakeLists.txt)
+
+TIGER=${1:-tiger}
+cd "$(dirname "$0")" || exit 2
+OUT=${TMPDIR:-/tmp}/tiger-tests.$$
+mkdir -p "$OUT" || exit 2
+failed=0
+for program in *.tig *.hera; do
+    name=${program%.*}
+    input=/dev/null
+    if test -f "$name.in"; then input=$name.in; fi
+    for how in interpret run; do
+        "$TIGER" --$how "$program" < "$input" > "$OUT/$name.$how" 2>&1
+        echo "exit status $?" >> "$OUT/$name.$how"
+    done
+    if ! cmp -s "$OUT/$name.interpret" "$OUT/$name.run"; then
+        echo "$program: --run and --interpret differ:"
+        diff "$OUT/$name.interpret" "$OUT/$name.run"
+        failed=1
+    elif test -f "$name.out" && ! diff "$name.out" "$OUT/$name.run" > /dev/null; then
+        echo "$program: not the expected output:"
+        diff "$name.out" "$OUT/$name.run"
+        failed=1
+    fi
+done
+rm -rf "$OUT"
+if test $failed = 0; then echo "all agree"; fi
+exit $failed
@@ -0,0 +1,59 @@
+#include <vector>
+#include "attribute.h"
+#include "AST.h"
+#include "phases.h"
+
+/*
+ * The bookkeeping for attributes of AST nodes; see attribute.h
+ */
+
+struct computing {
+	const void *which;
+	const char *name;
+	AST_node_ *owner;
+};
+static thread_local std::vector<computing> being_computed;  // innermost last
+static thread_local bool tracing_on = false;
+
+void set_attribute_tracing(bool on)
+{
+	tracing_on = on;
+}
+
+bool attribute_computation::tracing()
+{
+	return tracing_on;
+}
+
+attribute_computation::attribute_computation(const void *which, const char *name, AST_node_ *owner)
+{
+	being_computed.push_back({which, name, owner});
+	attributes_in_this_thread++;
+}
+
+attribute_computation::~attribute_computation()
+{
+	being_computed.pop_back();
+}
+
+void attribute_computation::trace(const string &value)
+{
+	const computing &me = being_computed.back();
+	A_pos where = me.owner->pos();
+	EM_output() << string(2 * (being_computed.size() - 1), ' ')
+		    << me.name << " at " << str(where) << " = " << value << std::endl;
+}
+
+void attribute_computation::cycle(const void *which)
+{
+	// the innermost entry is the second request for "which"; find the first, and list everything from there
+	int first = int(being_computed.size()) - 1;
+	while (first > 0 && being_computed[first - 1].which != which) first--;
+	if (first > 0) first--;
+	string chain;
+	for (int i = first; i < int(being_computed.size()); i++) {
+		A_pos where = being_computed[i].owner->pos();
+		chain += (i == first ? "" : " needs ") + string(being_computed[i].name) + " at " + str(where);
+	}
+	being_computed.back().owner->EM_error("Cyclic attribute definition: " + chain, true);
+}
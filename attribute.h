@@ -0,0 +1,61 @@
+#if ! defined ATTRIBUTE_H
+#define ATTRIBUTE_H
+
+#include "util.h"
+#include "lazy.h"
+
+// Attributes of AST nodes (result_reg, typecheck, etc.), built on lazy<T> (see lazy.h):
+//  each is computed by its node's init_ method the first time it's asked for, and just looked up after that.
+//  Asking for an attribute while it's still being computed (i.e., it depends on itself)
+//  is a fatal error that lists the attributes in the cycle, e.g.
+//	result_fp_plus at 3.5-12 needs regular_fp_plus at 4.1-9 needs result_fp_plus at 3.5-12
+//
+// To give a class in AST.h an attribute "x" of type T, give it a "T init_x()" method and
+//	AST_ATTRIBUTE(T, x);
+//  which declares "stored_x"; then "x()" is just "return stored_x.get();"
+//
+// With -dt, we print each attribute value as we compute it, indented by how many
+//  other attributes were waiting for it (so what each one needed is listed just before it).
+
+class AST_node_;
+
+void set_attribute_tracing(bool on);   // for this thread; compile_tiger_program sets it for -dt
+
+// Keeps track of the attributes that are being computed right now (in this thread), innermost last
+class attribute_computation {
+public:
+	attribute_computation(const void *which, const char *name, AST_node_ *owner);
+	~attribute_computation();
+	void trace(const string &value);  // if we're tracing, print this attribute's value
+	static bool tracing();
+	static void cycle(const void *which);  // "which" was asked for while it was being computed: fatal error
+};
+
+template <class T> class attribute : private lazy<T> {
+public:
+	attribute(AST_node_ *owner, const char *name, std::function<T ()> init) : lazy<T>(init), owner(owner), name(name) {}
+	attribute(const attribute &) = delete;  // the init function belongs to "owner"
+	attribute &operator=(const attribute &) = delete;
+
+	const T &get() const {
+		if (this->is_ready()) return lazy<T>::get();
+		attribute_computation computing(this, name, owner);
+		try {
+			const T &value = lazy<T>::get();
+			if (attribute_computation::tracing()) computing.trace(repr(value));
+			return value;
+		} catch (const typename lazy<T>::cyclic_definition &) {
+			attribute_computation::cycle(this);
+			throw;  // not reached, since cycle reports a fatal error
+		}
+	}
+	bool ready() const { return this->is_ready(); }  // has it been computed yet?
+
+private:
+	AST_node_ *owner;
+	const char *name;
+};
+
+#define AST_ATTRIBUTE(T, x) attribute<T> stored_##x{this, #x, [this]() { return this->init_##x(); }}
+
+#endif
@@ -0,0 +1,186 @@
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <filesystem>
+#include <unistd.h>
+#include "compile.h"
+#include "phases.h"
+
+/*
+ * tiger --bench: compile big made-up Tiger programs, each at two sizes, and check
+ *  that doubling the size doesn't much more than double the work, and that nothing
+ *  got a lot slower (or made a lot more allocations) than in the baseline file.
+ *  "make tiger-bench" runs it with bench-baseline.txt; see the User Manual.
+ */
+
+// The programs, each made from its "size"
+static string nested_lets(int n)  // let var v0 ... in let var v1 ... in ... end end
+{
+	string program;
+	for (int i = 0; i < n; i++)
+		program += "let var v" + str(i) + " : int := " + str(i) + " in\n";
+	program += "printint(v0 + v" + str(n / 2) + " + v" + str(n - 1) + ")\n";
+	for (int i = 0; i < n; i++)
+		program += "end\n";
+	return program;
+}
+
+static string long_sequence(int n)  // (x := x + 0; x := x + 1; ...)
+{
+	string program = "let var x : int := 0 in (\n";
+	for (int i = 0; i < n; i++)
+		program += "x := x + " + str(i % 100) + ";\n";
+	return program + "printint(x)) end\n";
+}
+
+static string many_functions(int n)  // one A_fundecList_ of n functions, each calling the one before
+{
+	string program = "let\n  function f0(x: int): int = x + 1\n";
+	for (int i = 1; i < n; i++)
+		program += "  function f" + str(i) + "(x: int): int = f" + str(i - 1) + "(x) + 1\n";
+	return program + "in printint(f" + str(n - 1) + "(0)) end\n";
+}
+
+static string many_strings(int n)  // n different string literals
+{
+	string program = "(\n";
+	for (int i = 0; i < n; i++)
+		program += "print(\"string number " + str(i) + "\");\n";
+	return program + "printint(" + str(n) + "))\n";
+}
+
+static string deep_arithmetic(int n)  // (1 + (2 * (3 - ... ))), n deep
+{
+	const char *ops[] = {" + ", " * ", " - "};
+	string program = "printint(";
+	for (int i = 0; i < n; i++)
+		program += "(" + str(i % 10 + 1) + ops[i % 3];
+	program += "x";
+	program += string(n, ')');
+	return "let var x : int := 2 in " + program + ") end\n";
+}
+
+struct benchmark {
+	const char *name;
+	string (*program)(int size);
+	int size;  // and then twice that
+};
+
+static const benchmark benchmarks[] = {
+	{"nested_lets",     nested_lets,     100},
+	{"long_sequence",   long_sequence,   1000},
+	{"many_functions",  many_functions,  500},
+	{"many_strings",    many_strings,    1000},
+	{"deep_arithmetic", deep_arithmetic, 500},
+};
+
+// How much worse than the baseline counts as a regression: time is noisy (and depends on the machine),
+//  but the number of allocations should be the same every time
+static const double slower_than_baseline = 2.0, slack_seconds = 0.02;
+static const double more_allocations_than_baseline = 1.1;
+// Doubling the size should about double the work; this much more is a super-linear blowup
+static const double growth_limit = 3.0, growth_slack_seconds = 0.05;
+
+struct bench_result {
+	double seconds = 0;
+	unsigned long allocations = 0;
+	long peak_RSS_kb = 0;
+};
+
+static bool run_one(const benchmark &b, int size, const compile_options &options, const string &dir, bench_result &result)
+{
+	string filename = dir + "/" + b.name + "_" + str(size) + ".tig";
+	{
+		std::ofstream out(filename);
+		out << b.program(size);
+	}
+
+	HERA_emitter code;
+	phase_timer phases;
+	phase_timer::set_current(&phases);
+	bool ok = compile_tiger_program(filename, code, options) == 0;
+	phases.stop();
+	phase_timer::set_current(0);
+	std::filesystem::remove(filename);
+
+	phase_numbers total = phases.total();
+	result.seconds = total.seconds;
+	result.allocations = total.allocations;
+	result.peak_RSS_kb = total.peak_RSS_kb;
+
+	char line[200];
+	snprintf(line, sizeof line, "%-16s %6d %10.4f s %12lu allocations %8ld KB peak RSS%s",
+		 b.name, size, total.seconds, total.allocations, total.peak_RSS_kb, ok ? "" : "  (COMPILE FAILED)");
+	std::cout << line << std::endl;
+	std::cout << "   ";
+	for (const phase_numbers &p : phases.numbers()) {
+		snprintf(line, sizeof line, " %s %.4f s/%lu", p.name.c_str(), p.seconds, p.allocations);
+		std::cout << line;
+	}
+	std::cout << std::endl;
+	return ok;
+}
+
+int tiger_benchmark(const String &baseline_file, bool update_baseline)
+{
+	compile_options options;
+	options.throw_on_fatal = true;
+	string dir = (std::filesystem::temp_directory_path() / ("tiger-bench-" + str(int(getpid())))).string();
+	std::filesystem::create_directories(dir);
+
+	std::map<string, bench_result> baseline;  // "name size" -> numbers
+	std::ifstream in(baseline_file);
+	string line;
+	while (std::getline(in, line)) {
+		if (line == "" || line[0] == '#') continue;
+		std::istringstream words(line);
+		string name;
+		int size;
+		bench_result r;
+		if (words >> name >> size >> r.seconds >> r.allocations >> r.peak_RSS_kb)
+			baseline[name + " " + str(size)] = r;
+	}
+	if (!update_baseline && baseline.empty())
+		std::cout << "No baseline in " << baseline_file << " (use --bench --update to make one)" << std::endl;
+
+	int problems = 0;
+	std::ostringstream new_baseline;
+	new_baseline << "# tiger --bench baseline: benchmark size seconds allocations peak_RSS_kb\n";
+	for (const benchmark &b : benchmarks) {
+		bench_result small, big;
+		bool ok = run_one(b, b.size, options, dir, small) && run_one(b, 2 * b.size, options, dir, big);
+		if (!ok) {
+			problems++;
+			continue;
+		}
+		for (const auto &[size, r] : {std::pair(b.size, small), std::pair(2 * b.size, big)}) {
+			new_baseline << b.name << " " << size << " " << r.seconds << " " << r.allocations << " " << r.peak_RSS_kb << "\n";
+			auto was = baseline.find(string(b.name) + " " + str(size));
+			if (update_baseline || was == baseline.end()) continue;
+			if (r.seconds > was->second.seconds * slower_than_baseline + slack_seconds) {
+				std::cout << "  REGRESSION: " << b.name << " " << size << " took " << r.seconds << " s, baseline " << was->second.seconds << " s" << std::endl;
+				problems++;
+			}
+			if (r.allocations > was->second.allocations * more_allocations_than_baseline) {
+				std::cout << "  REGRESSION: " << b.name << " " << size << " made " << r.allocations << " allocations, baseline " << was->second.allocations << std::endl;
+				problems++;
+			}
+		}
+		if (big.seconds > small.seconds * growth_limit + growth_slack_seconds ||
+		    big.allocations > small.allocations * growth_limit) {
+			std::cout << "  SUPER-LINEAR: " << b.name << " went from " << small.seconds << " s, " << small.allocations << " allocations to " <<
+				big.seconds << " s, " << big.allocations << " allocations when its size doubled" << std::endl;
+			problems++;
+		}
+	}
+	std::filesystem::remove_all(dir);
+
+	if (update_baseline) {
+		std::ofstream out(baseline_file);
+		out << new_baseline.str();
+		std::cout << "Wrote " << baseline_file << std::endl;
+		return out ? 0 : 1;
+	}
+	std::cout << (problems == 0 ? "No problems" : str(problems) + " problems") << std::endl;
+	return problems > 0;
+}
@@ -0,0 +1,285 @@
+#include <cctype>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <thread>
+#include <unistd.h>
+#include "cache.h"
+#include "AST.h"
+#include "IR.h"
+#include "frames.h"
+
+/*
+ * The cache of function groups for tiger --cache-dir: the files (see cache.h),
+ *  and the A_functionDec_ methods that decide whether to use them and what goes in them
+ */
+
+static const string cache_format = "tiger function group cache 2";
+
+// Something that changes when the compiler does, so we don't use code an older version generated
+static string compiler_identity()
+{
+	std::error_code ignored;
+	std::filesystem::path me = std::filesystem::read_symlink("/proc/self/exe", ignored);
+	if (me.empty()) return "";
+	auto when = std::filesystem::last_write_time(me, ignored);
+	return me.string() + " " + str(long(when.time_since_epoch().count()));
+}
+
+string cache_hash(const string &text)  // 64-bit FNV-1a, which is the same everywhere (unlike std::hash)
+{
+	static const string identity = cache_format + "\n" + compiler_identity() + "\n";
+	unsigned long long h = 14695981039346656037ULL;
+	for (const string *s : {&identity, &text})
+		for (char c : *s) {
+			h ^= (unsigned char) c;
+			h *= 1099511628211ULL;
+		}
+	char hex[17];
+	snprintf(hex, sizeof hex, "%016llx", h);
+	return hex;
+}
+
+static string file_name(const string &dir, const string &key)
+{
+	return (std::filesystem::path(dir) / (key + ".group")).string();
+}
+
+
+// Labels, and the placeholders for them, are "words" of letters, digits, "_", and "@"
+static bool word_char(char c)
+{
+	return isalnum((unsigned char) c) || c == '_' || c == '@';
+}
+
+// Go through the words of HERA code, skipping over strings (in LP_STRING),
+//  calling "f" for each word and putting whatever it returns in its place
+static string each_word(const string &text, const std::function<string(const string &)> &f)
+{
+	string result;
+	unsigned long i = 0;
+	while (i < text.length()) {
+		unsigned long j = i + 1;
+		if (text[i] == '"') {  // repr turns any " in the string itself into \042
+			unsigned long close = text.find('"', i + 1);
+			j = close == string::npos ? text.length() : close + 1;
+			result += text.substr(i, j - i);
+		} else if (word_char(text[i])) {
+			while (j < text.length() && word_char(text[j])) j++;
+			result += f(text.substr(i, j - i));
+		} else {
+			result += text[i];
+		}
+		i = j;
+	}
+	return result;
+}
+
+// the labels defined in "text", i.e., each X in LABEL(X) or DLABEL(X), added to "labels" if they're not there yet
+static void defined_labels(const string &text, std::vector<string> &labels)
+{
+	string previous;
+	each_word(text, [&](const string &word) {
+		if ((previous == "LABEL" || previous == "DLABEL") && std::find(labels.begin(), labels.end(), word) == labels.end())
+			labels.push_back(word);
+		previous = word;
+		return word;
+	});
+}
+
+
+bool cache_read(const string &dir, function_group &group)
+{
+	std::ifstream in(file_name(dir, group.key), std::ios::binary);
+	string line, key;
+	int dependencies, functions;
+	if (!std::getline(in, line) || line != cache_format || !std::getline(in, key) || key != group.key)
+		return false;
+	if (!(in >> line >> dependencies) || line != "dependencies") return false;
+	in.ignore();
+	for (int i = 0; i < dependencies; i++) {
+		if (!std::getline(in, line)) return false;
+		unsigned long tab = line.find('\t');
+		if (tab == string::npos) return false;
+		group.dependencies[line.substr(0, tab)] = line.substr(tab + 1);
+	}
+	if (!(in >> line >> functions) || line != "functions") return false;
+	group.function_labels.assign(functions, "");
+	for (HERA_emitter *part : {&group.data, &group.code}) {
+		unsigned long length;
+		if (!(in >> line >> length)) return false;
+		in.ignore();
+		string text(length, '\0');
+		if (!in.read(&text[0], length)) return false;
+		*part << text;
+	}
+	return true;
+}
+
+void cache_fill_in_labels(function_group &group, int number)
+{
+	std::map<string, string> names;
+	for (unsigned i = 0; i < group.function_labels.size(); i++)
+		names["@" + str(i)] = group.function_labels[i];
+	for (const auto &outside : group.outside_labels)
+		names["@x_" + outside.first] = outside.second;
+	auto fill_in = [&](const string &word) {
+		if (word[0] != '@') return word;
+		auto n = names.find(word);
+		return n != names.end() ? n->second : "cache" + str(number) + "_" + word.substr(1);
+	};
+	for (HERA_emitter *part : {&group.data, &group.code}) {
+		string text = each_word(part->as_string(), fill_in);
+		part->clear();
+		*part << text;
+	}
+	group.from_cache = true;
+}
+
+void cache_write(const string &dir, const function_group &group)
+{
+	string data = group.data.as_string(), code = group.code.as_string();
+	std::vector<string> labels = group.function_labels;  // so they're @0, @1, ...
+	defined_labels(data, labels);
+	defined_labels(code, labels);
+	std::map<string, string> placeholders;
+	for (unsigned i = 0; i < labels.size(); i++)
+		placeholders[labels[i]] = "@" + str(i);
+	for (const auto &outside : group.outside_labels)
+		placeholders[outside.second] = "@x_" + outside.first;
+	auto placeholder = [&](const string &word) {
+		auto p = placeholders.find(word);
+		return p == placeholders.end() ? word : p->second;
+	};
+	data = each_word(data, placeholder);
+	code = each_word(code, placeholder);
+
+	std::error_code ignored;
+	std::filesystem::create_directories(dir, ignored);
+	// write it under another name and then rename it, so nobody (e.g. another tiger) sees half a file
+	std::ostringstream temporary;
+	temporary << file_name(dir, group.key) << ".tmp" << getpid() << "_" << std::this_thread::get_id();
+	{
+		std::ofstream out(temporary.str(), std::ios::binary);
+		out << cache_format << "\n" << group.key << "\n";
+		out << "dependencies " << group.dependencies.size() << "\n";
+		for (const auto &d : group.dependencies)
+			out << d.first << "\t" << d.second << "\n";
+		out << "functions " << group.function_labels.size() << "\n";
+		out << "data " << data.length() << "\n" << data;
+		out << "code " << code.length() << "\n" << code;
+		if (!out) {
+			EM_warning("Could not write " + temporary.str() + " for the cache");
+			return;
+		}
+	}
+	std::filesystem::rename(temporary.str(), file_name(dir, group.key), ignored);
+}
+
+
+/*
+ * The A_functionDec_ side of things
+ */
+
+static string describe(const function_type_info &f)
+{
+	string params;
+	for (HaverfordCS::list<Ty_ty> p = f.param_types; !empty(p); p = rest(p)) {
+		Ty_ty t = head(p);
+		params += " " + repr(t);
+	}
+	Ty_ty result = f.return_type;
+	return repr(result) + " (" + params + " ) fp " + str(f.fp) + " frame " + str(f.frame);
+}
+
+// The cache_group attribute: which of the current program's cache_groups this is, after reading
+//  its file if it's there and still fits, or -1 if we're not using the cache for it
+int A_functionDec_::init_cache_group()
+{
+	IR_program *program = IR_program::current();
+	if (program == 0 || program->cache_dir == "" || this->result_frames() != 0)
+		return -1;  // groups inside functions are part of their function's group
+
+	int number = program->cache_groups.size();
+	program->cache_groups.emplace_back();
+	function_group &group = program->cache_groups.back();
+	group.key = cache_hash(this->print_rep(0, false) +
+			       "\nfp_plus " + str(this->result_fp_plus()) +
+			       "\nframes " + str(this->result_frames()) +
+			       "\nwhere_stack " + str(this->result_where_stack()) +
+			       "\nfor " + str(this->my_for_loop()) +
+			       (static_links_cached() ? "\nstatic links cached" : ""));
+	std::vector<string> labels;
+	theFunctions->function_labels(labels);
+
+	if (cache_read(program->cache_dir, group) && group.function_labels.size() == labels.size()) {
+		bool same = true;
+		for (const auto &d : group.dependencies)
+			if (this->outside(d.first, group.outside_labels) != d.second) { same = false; break; }
+		if (same) {
+			group.function_labels = labels;
+			cache_fill_in_labels(group, number);
+			return number;
+		}
+	}
+	string key = group.key;
+	group = function_group();  // start over, and fill it in as we generate the code
+	group.key = key;
+	group.function_labels = labels;
+	return number;
+}
+
+// Look up "what" (a dependency, e.g. "function f") from here, as the group did, and say what we found
+string A_functionDec_::outside(const string &what, std::map<string, string> &labels)
+{
+	std::istringstream words(what);
+	string kind, name;
+	int ceiling = 0;
+	words >> kind >> name >> ceiling;
+	Symbol s = to_Symbol(name);
+	if (kind == "function") {
+		function_binding f = this->resolve_function(s);
+		labels[name] = name + f.info.unique_id;
+		return describe(f.info);
+	} else if (kind == "variable") {
+		variable_binding v = this->resolve_variable(s, ceiling);
+		return repr(v);
+	} else if (kind == "implicit_type") {
+		Ty_ty t = this->implicit_type_init(s);
+		return repr(t);
+	}
+	return "?";  // not something we'd have written
+}
+
+void A_functionDec_::note_dependency(const string &what, const string &found)
+{
+	if (recording_group >= 0)
+		IR_program::current()->cache_groups[recording_group].dependencies[what] = found;
+}
+
+// The lookups that go outside the group (the group's own functions are in my_local_functions)
+function_binding A_functionDec_::resolve_function(Symbol name)
+{
+	tiger_standard_library mine = this->my_local_functions();
+	if (is_name_there(name, mine)) return function_binding(this, lookup(name, mine));
+	function_binding f = parent()->resolve_function(name);
+	if (recording_group >= 0) {
+		note_dependency("function " + str(name), describe(f.info));
+		IR_program::current()->cache_groups[recording_group].outside_labels[str(name)] = str(name) + f.info.unique_id;
+	}
+	return f;
+}
+
+variable_binding A_functionDec_::resolve_variable(Symbol name, int ceiling)
+{
+	variable_binding v = AST_node_::resolve_variable(name, ceiling);
+	note_dependency("variable " + str(name) + " " + str(ceiling), repr(v));
+	return v;
+}
+
+Ty_ty A_functionDec_::implicit_type_init(Symbol name)
+{
+	Ty_ty t = AST_node_::implicit_type_init(name);
+	note_dependency("implicit_type " + str(name), repr(t));
+	return t;
+}
@@ -0,0 +1,47 @@
+#if ! defined CACHE_H
+#define CACHE_H
+
+#include <map>
+#include <vector>
+#include "util.h"
+#include "HERA_emitter.h"
+
+// tiger --cache-dir DIR keeps the final HERA code (and data) of each group of functions, i.e. each
+//  A_functionDec_ that isn't inside another function, in a file in DIR, so recompiling a program after
+//  changing some of its functions only generates code, allocates registers, and optimizes for the groups
+//  that changed. (The program is still parsed and type checked, which is quick, and typecheck doesn't
+//  look inside functions anyway.)
+//
+// A group's file is named by a hash of its AST, printed without positions, and of where it is
+//  (its frame offsets, etc.; see A_functionDec_::init_cache_group in cache.cpp).
+//  The file also lists what the group looked up outside itself, e.g. the signature and frame of each
+//  function it calls, or the type and frame offset of each outer variable it uses, and is only used
+//  if those all come out the same in the program we're compiling now.
+//
+// The labels in a file are placeholders, filled in to fit the program being compiled:
+//  "@0", "@1", ... for the ones the group defines (starting with its functions, in order), and
+//  "@x_f" for the label of function "f" outside the group.
+
+struct function_group {
+	string key;                                // the hash, which is also the file name
+	bool from_cache = false;                   // if so, data and code are ready to use as is
+	std::map<string, string> dependencies;     // what it looked up -> what it found, e.g. "function f" -> its types, label, and frame
+	std::map<string, string> outside_labels;   // for each function it calls outside the group, e.g. "f" -> "f_lkudge3"
+	std::vector<string> function_labels;       // of the group's own functions, in order
+	HERA_emitter data, code;
+};
+
+string cache_hash(const string &text);  // for the key
+
+// Read the file for group.key, if there is one, into the group (with the placeholders still in it);
+//  return false if there isn't one we can use
+bool cache_read(const string &dir, function_group &group);
+
+// Once the dependencies check out, fill in the labels: outside_labels and function_labels have to be set,
+//  and the group's other labels get names starting with "cache<number>_"
+void cache_fill_in_labels(function_group &group, int number);
+
+// Write the group's file, with its labels turned into placeholders
+void cache_write(const string &dir, const function_group &group);
+
+#endif
@@ -0,0 +1,242 @@
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include "compile.h"
+#include "errormsg.h"
+#include "AST.h"
+#include "IR.h"
+#include "peephole.h"
+#include "cost.h"
+#include "HERA_interpreter.h"
+#include "phases.h"
+#include "frames.h"
+#include "tigerParseDriver.h"
+
+using std::cerr;
+using std::endl;
+
+int compile_tiger_program(const String &filename, HERA_emitter &code, const compile_options &options)
+{
+	// give up after options.max_errors errors,
+	// with compiler debugging ON if the "-d" flag was used when we started
+	EM_reset(filename, options.max_errors, options.debug, options.crash_on_fatal, options.throw_on_fatal);
+	reset_unique_numbers();
+	set_attribute_tracing(options.trace_attributes);
+	set_static_links_cached(options.cache_static_links);
+
+	try {
+		tigerParseDriver driver;  // the AST lives in driver's arena, so it's all gone when we return
+		phase_start("parse");
+		int result = driver.parse(filename);
+		if (!EM_recorded_any_errors()) {
+			if (result != 0) {
+				EM_error("Strange result in compile.cpp: parser failed but EM module reported no errors",
+					 true, Position::undefined()); // true = fatal error
+			}
+
+			EM_debug("Parsing Successful", driver.AST->pos());
+
+
+			// Could do static checks, e.g. type checking, here if we want to do them all before any code generation
+
+			if (options.show_ast) EM_output() << "Printing AST due to -da or -dA flag:" << endl << repr(driver.AST) << endl;
+
+			if (! EM_recorded_any_errors()) {
+				phase_start("typecheck");
+				driver.AST->typecheck();
+				IR_program program;
+				program.cache_dir = options.cache_dir;
+				program.mark_lines = options.cost_report;
+				driver.AST->lower_to_IR(program);
+				if (options.show_ir) { EM_output() << "Printing IR due to -di flag:" << endl; IR_print(program, EM_output()); }
+				peephole_report peepholes;
+				cost_report costs;
+				phase_start("emit");  // register allocation and the peephole optimizer
+				IR_emit_HERA(program, code, peepholes, options.cost_report ? &costs : 0);
+				if (options.peephole_report) { EM_output() << "Peephole optimizer for " << filename << ":" << endl; peepholes.print(EM_output()); }
+				if (options.cost_report) { EM_output() << "Cost of the code for " << filename << ":" << endl; costs.print(EM_output()); }
+				if (! EM_recorded_any_errors()) {
+					if (!program.cache_groups.empty()) phase_start("cache write");
+					for (const function_group &group : program.cache_groups)
+						if (!group.from_cache) cache_write(options.cache_dir, group);
+					return 0; // no errors
+				}
+			}
+		}
+		EM_warning("Not generating HERA code due to above errors.");
+		return EM_recorded_any_errors(); // got errors somewhere, or would have returned 0 above
+	} catch (const EM_fatal_error &) {
+		return 2;  // same as the exit status for a fatal error in the one-file-per-run mode
+	}
+}
+
+String HERA_file_name_for(const String &tiger_file_name)
+{
+	const String tig = ".tig";
+	if (tiger_file_name.length() > tig.length() &&
+	    tiger_file_name.compare(tiger_file_name.length() - tig.length(), tig.length(), tig) == 0)
+		return tiger_file_name.substr(0, tiger_file_name.length() - tig.length()) + ".hera";
+	else
+		return tiger_file_name + ".hera";
+}
+
+// where to look for Tiger-stdlib-stack.hera, after the program's own directory (see CMakeLists.txt)
+#if ! defined TIGER_STDLIB_DIR
+#define TIGER_STDLIB_DIR "."
+#endif
+
+int run_HERA_program(const HERA_emitter &code, const String &hera_file_name, const compile_options &options)
+{
+	HERA_profile profile;
+	int result = HERA_run(code.as_string(), hera_file_name, {".", TIGER_STDLIB_DIR}, std::cin, std::cout, cerr,
+			      options.run == "profile" ? &profile : 0, options.run == "run");
+	if (options.run == "profile") {
+		std::cout.flush();
+		cerr << endl;  // in case the program's output didn't end its line
+		profile.print(cerr);
+	}
+	return result;
+}
+
+// for --time-phases, after the "write" phase
+void report_phases(phase_timer &phases, const String &filename, const compile_options &options)
+{
+	if (phase_timer::current() != &phases) return;
+	phases.stop();
+	phases.print(cerr, filename, options.time_phases == "json");
+	phase_timer::set_current(0);
+}
+
+static bool write_HERA_file(const String &filename, const HERA_emitter &code)
+{
+	std::ofstream outfile(HERA_file_name_for(filename));
+	code.write_to(outfile);
+	outfile.close();
+	if (!outfile) {
+		cerr << "Could not write " << HERA_file_name_for(filename) << endl;
+		return false;
+	}
+	return true;
+}
+
+// compile one file for --batch or --server, return true if it worked
+static bool compile_tiger_file_to_HERA_file(const String &filename, const compile_options &options)
+{
+	HERA_emitter code;
+	phase_timer phases;
+	if (options.time_phases != "") phase_timer::set_current(&phases);
+	bool ok = compile_tiger_program(filename, code, options) == 0;
+	phase_start("write");
+	ok = ok && write_HERA_file(filename, code);
+	report_phases(phases, filename, options);
+	return ok;
+}
+
+// The results of one file, for the threads of a parallel batch
+struct batch_result {
+	bool done = false;
+	bool ok = false;
+	String messages;  // what would have gone to cerr
+	HERA_emitter code;
+	phase_timer phases;
+};
+
+static int compile_tiger_batch_in_parallel(const std::vector<String> &filenames, const compile_options &options, int jobs)
+{
+	std::vector<batch_result> results(filenames.size());
+	std::mutex results_lock;
+	std::condition_variable another_one_done;
+	std::atomic<unsigned long> next_file(0);
+
+	auto compile_files = [&]() {
+		unsigned long i;
+		while ((i = next_file++) < filenames.size()) {
+			std::ostringstream messages;
+			EM_set_output(&messages);
+			HERA_emitter code;
+			phase_timer phases;
+			if (options.time_phases != "") phase_timer::set_current(&phases);
+			bool ok;
+			try {
+				ok = compile_tiger_program(filenames[i], code, options) == 0;
+			} catch (...) {
+				messages << "Yikes! Uncaught compiler exception (this REALLY should not happen)" << endl;
+				ok = false;
+			}
+			EM_set_output(0);
+			phases.stop();  // and "write" is timed on the main thread
+			phase_timer::set_current(0);
+
+			std::lock_guard<std::mutex> l(results_lock);
+			results[i].ok = ok;
+			results[i].messages = messages.str();
+			results[i].code = std::move(code);
+			results[i].phases = std::move(phases);
+			results[i].done = true;
+			another_one_done.notify_all();
+		}
+	};
+	std::vector<std::thread> workers;
+	for (int t = 0; t < jobs; t++)
+		workers.emplace_back(compile_files);
+
+	// report on the files in order, as soon as each one (and all before it) are done
+	int failures = 0;
+	for (unsigned long i = 0; i < filenames.size(); i++) {
+		batch_result this_one;
+		{
+			std::unique_lock<std::mutex> l(results_lock);
+			another_one_done.wait(l, [&]() { return results[i].done; });
+			this_one = std::move(results[i]);
+		}
+		cerr << this_one.messages;
+		if (options.time_phases != "") phase_timer::set_current(&this_one.phases);
+		phase_start("write");
+		if (!(this_one.ok && write_HERA_file(filenames[i], this_one.code)))
+			failures++;
+		report_phases(this_one.phases, filenames[i], options);
+	}
+
+	for (std::thread &w : workers)
+		w.join();
+	return failures;
+}
+
+int compile_tiger_batch(const std::vector<String> &filenames, compile_options options)
+{
+	options.throw_on_fatal = true;
+	int jobs = options.jobs > 0 ? options.jobs : std::thread::hardware_concurrency();
+	if (jobs > int(filenames.size())) jobs = filenames.size();
+
+	int failures = 0;
+	if (jobs > 1) {
+		failures = compile_tiger_batch_in_parallel(filenames, options, jobs);
+	} else {
+		for (const String &f : filenames) {
+			if (!compile_tiger_file_to_HERA_file(f, options))
+				failures++;
+		}
+	}
+	if (failures > 0) cerr << failures << " of " << filenames.size() << " files had errors" << endl;
+	return failures > 0;
+}
+
+int compile_tiger_server(std::istream &requests, std::ostream &replies, compile_options options)
+{
+	options.throw_on_fatal = true;
+	int failures = 0;
+	String filename;
+	while (std::getline(requests, filename)) {
+		if (filename == "") continue;
+		if (compile_tiger_file_to_HERA_file(filename, options))
+			replies << "ok " << filename << " " << HERA_file_name_for(filename) << endl;  // endl flushes, so the client sees it now
+		else {
+			replies << "failed " << filename << endl;
+			failures++;
+		}
+	}
+	return failures > 0;
+}
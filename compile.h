@@ -0,0 +1,61 @@
+#if ! defined COMPILE_H
+#define COMPILE_H
+
+#include <iostream>
+#include <vector>
+#include "util.h"
+#include "HERA_emitter.h"
+
+// Compiling Tiger programs, one at a time (as main usually does) or many in one process
+
+struct compile_options {
+	bool debug = false;           // -d
+	bool show_ast = false;        // -da or -dA
+	bool show_ir = false;         // -di
+	bool peephole_report = false; // -dp
+	bool trace_attributes = false; // -dt
+	bool crash_on_fatal = false;  // -dc
+	bool throw_on_fatal = false;  // give up on just this program after a fatal error, rather than exiting
+	int max_errors = 8;
+	String time_phases;           // --time-phases: "text", or "json" for --time-phases=json
+	bool cost_report = false;     // --cost-report: instruction counts and estimated cycles of the code (see cost.h)
+	String run;                   // --run, --interpret or --profile: "run", "interpret" or "profile" the program, rather than printing its code
+	bool cache_static_links = false; // --static-links=cached: functions find outer frames once, on entry (see frames.h)
+	String cache_dir;             // --cache-dir DIR: reuse the code of unchanged functions (see cache.h)
+	int jobs = 1;                 // for --batch, how many files to compile at once (-j), or 0 for one per processor
+	String HERA_main_file;        // --HERA-main FILE: also write the code as a HERA_main.cc, for HERA-C
+};
+
+// Compile one program (or standard input, for "-"), appending its complete HERA code to "code".
+// All the per-program state (error counts, the lexical scanner, label and other unique numbers)
+//  is reset first, so this can be called over and over in one process.
+// Returns 0 if there were no errors, in which case "code" is ready to use; nonzero otherwise.
+int compile_tiger_program(const String &filename, HERA_emitter &code, const compile_options &options);
+
+// tiger --batch f1.tig f2.tig ... : compile each file to its own .hera file (f1.hera, f2.hera, ...)
+//  With options.jobs > 1, that many threads compile files at once, but each file's error messages
+//  are still printed (and its .hera file written) in the order the files were given.
+//  returns 0 if all compiled without errors
+int compile_tiger_batch(const std::vector<String> &filenames, compile_options options);
+
+// tiger --server : read one file name per line from "requests", compile it as --batch does,
+//  and answer with one line per file on "replies" ("ok f.tig f.hera" or "failed f.tig"), until end of input
+int compile_tiger_server(std::istream &requests, std::ostream &replies, compile_options options);
+
+String HERA_file_name_for(const String &tiger_file_name);  // f.tig -> f.hera
+
+// tiger --run (or --interpret, or --profile) f.tig: run the code from compile_tiger_program (or a .hera file)
+//  with HERA_run (see HERA_interpreter.h), with standard input and output, and for --profile, print
+//  the profile on standard error; returns 0 if the program got to its HALT
+int run_HERA_program(const HERA_emitter &code, const String &hera_file_name, const compile_options &options);
+
+// tiger --bench [--update] [baseline]: compile big made-up programs, at two sizes each, and report anything
+//  that grows faster than linearly or got worse than in the baseline file (or write a new baseline); see bench.cpp
+int tiger_benchmark(const String &baseline_file, bool update_baseline);
+
+// For --time-phases: compile_tiger_program times its phases with phase_timer::current(), if the caller set it,
+//  and the caller then times writing the code ("write"), and calls this to print them all and unset it
+class phase_timer;
+void report_phases(phase_timer &phases, const String &filename, const compile_options &options);
+
+#endif
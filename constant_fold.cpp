@@ -0,0 +1,76 @@
+#include "AST.h"
+
+/*
+ * Constant folding: the has_constant_value and constant_value attributes,
+ *  which HERA_code uses to SET the value of constant expressions rather than computing it,
+ *  and to leave out the code for "if" branches and "while" loops that can't run
+ */
+
+// what HERA would have in a register after computing "v" (it's a 16-bit machine)
+static int HERA_word(long v)
+{
+	v &= 0xffff;
+	return v >= 0x8000 ? v - 0x10000 : v;
+}
+
+bool A_intExp_::init_has_constant_value(int &result)
+{
+	result = HERA_word(value);
+	return true;
+}
+
+bool A_boolExp_::init_has_constant_value(int &result)
+{
+	result = value ? 1 : 0;
+	return true;
+}
+
+bool A_arithExp_::init_has_constant_value(int &result)
+{
+	if (!(_left->has_constant_value() && _right->has_constant_value())) return false;
+	long l = _left->constant_value();
+	long r = _right->constant_value();
+	switch (_oper) {
+	case A_plusOp:
+		result = HERA_word(l + r);
+		return true;
+	case A_minusOp:
+		result = HERA_word(l - r);
+		return true;
+	case A_timesOp:
+		result = HERA_word(l * r);
+		return true;
+	default:
+		return false;  // leave it to HERA_code to complain about anything else
+	}
+}
+
+bool A_condExp_::init_has_constant_value(int &result)
+{
+	if (!(_left->has_constant_value() && _right->has_constant_value())) return false;
+	int l = _left->constant_value();
+	int r = _right->constant_value();
+	switch (_oper) {
+	case A_eqOp:  result = l == r; return true;
+	case A_neqOp: result = l != r; return true;
+	case A_ltOp:  result = l <  r; return true;
+	case A_leOp:  result = l <= r; return true;
+	case A_gtOp:  result = l >  r; return true;
+	case A_geOp:  result = l >= r; return true;
+	default:
+		return false;
+	}
+}
+
+// For x+0, 0+x, x-0, x*1, and 1*x, return x, which is all we need to compute; otherwise return 0
+A_exp A_arithExp_::identity_operand()
+{
+	int identity_on_right = (_oper == A_timesOp) ? 1 : 0;
+	if ((_oper == A_plusOp || _oper == A_minusOp || _oper == A_timesOp) &&
+	    _right->has_constant_value() && _right->constant_value() == identity_on_right)
+		return _left;
+	if ((_oper == A_plusOp || _oper == A_timesOp) &&
+	    _left->has_constant_value() && _left->constant_value() == identity_on_right)
+		return _right;
+	return 0;
+}
@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include "cost.h"
+
+/*
+ * Counting instructions and estimating cycles for tiger --cost-report; see cost.h
+ */
+
+HERA_insn cost_line_mark(int line)
+{
+	HERA_insn mark;
+	mark.line = line;
+	return mark;
+}
+
+void cost_remove_line_marks(HERA_insns &code)
+{
+	code.erase(std::remove_if(code.begin(), code.end(), [](const HERA_insn &insn) { return insn.op == HERA_TEXT && insn.line != 0; }),
+		   code.end());
+}
+
+// how many HERA machine instructions an instruction (or pseudo-instruction) turns into
+int cost_machine_instructions(const HERA_insn &insn)
+{
+	if (insn.op == HERA_TEXT || insn.op == HERA_LABEL || insn.op == HERA_DLABEL) return 0;
+	if (insn.op == HERA_SET) return 2;                                // SETLO, SETHI
+	if (HERA_is_branch(insn) || insn.op == HERA_CALL) return 3;      // SET(Rt, label), then the real one
+	return 1;
+}
+
+static bool goes_to_memory_or_PC(const HERA_insn &insn)
+{
+	return insn.op == HERA_LOAD || insn.op == HERA_STORE || insn.op == HERA_CALL || insn.op == HERA_RETURN || HERA_is_branch(insn);
+}
+
+int cost_cycles(const HERA_insn &insn)
+{
+	return cost_machine_instructions(insn) + (goes_to_memory_or_PC(insn) ? 1 : 0);
+}
+
+void cost_report::add(const string &label, int params, int save_slots, const HERA_insns &code)
+{
+	function_cost f;
+	f.label = label;
+	f.frame_words = label == "" ? save_slots : 3 + params + save_slots;
+
+	// how many loops each block is in: a branch back up the code closes a loop from where it goes to
+	HERA_blocks blocks = HERA_find_blocks(code);
+	std::vector<int> depth(blocks.count(), 0);
+	for (int b = 0; b < blocks.count(); b++)
+		for (int s : blocks.successors[b])
+			if (s <= b) {
+				f.loops++;
+				for (int in = s; in <= b; in++) depth[in]++;
+			}
+
+	// code before the first mark (saving registers, for a function) goes with the first line
+	int line = 0;
+	for (const HERA_insn &insn : code)
+		if (insn.op == HERA_TEXT && (line = insn.line) != 0) break;
+
+	for (int b = 0; b < blocks.count(); b++) {
+		double weight = std::pow(double(loop_weight), std::min(depth[b], 6));
+		for (int i = blocks.first[b]; i < blocks.first[b+1]; i++) {
+			const HERA_insn &insn = code[i];
+			if (insn.op == HERA_TEXT) {
+				if (insn.line != 0) line = insn.line;
+				continue;
+			}
+			int machine = cost_machine_instructions(insn);
+			double cycles = weight * cost_cycles(insn);
+			int counts = insn.op == HERA_LABEL || insn.op == HERA_DLABEL ? 0 : 1;
+			for (cost_numbers *n : {(cost_numbers *) &f, &lines[line]}) {
+				n->instructions += counts;
+				n->machine_instructions += machine;
+				n->cycles += cycles;
+			}
+			if (insn.op == HERA_CALL && insn.args.size() == 2) {
+				calls[insn.args[1].name].first++;
+				calls[insn.args[1].name].second += weight;
+			}
+			if ((insn.op == HERA_LOAD || insn.op == HERA_STORE) && insn.args.size() == 3 && insn.args[2] == HERA_FP)
+				f.frame_words = std::max(f.frame_words, insn.args[1].n + 1);
+		}
+	}
+	functions.push_back(f);
+}
+
+// we don't know the parameters and save slots of these, but the code's own use of FP will show how big the frame is
+void cost_report::add_cached(const std::vector<string> &function_labels, const HERA_insns &code)
+{
+	HERA_insns function;
+	string label;
+	for (const HERA_insn &insn : code) {
+		if (insn.op == HERA_LABEL && insn.args.size() == 1 &&
+		    std::find(function_labels.begin(), function_labels.end(), insn.args[0].name) != function_labels.end()) {
+			if (label != "") add(label, 0, 0, function);
+			label = insn.args[0].name;
+			function.clear();
+		}
+		function.push_back(insn);
+	}
+	if (label != "") add(label, 0, 0, function);
+}
+
+void cost_report::print(std::ostream &out) const
+{
+	char line[200];
+	snprintf(line, sizeof line, "  %-24s %8s %8s %14s %6s %6s", "function", "instrs", "machine", "est. cycles", "loops", "frame");
+	out << line << "\n";
+	cost_numbers total;
+	for (const function_cost &f : functions) {
+		snprintf(line, sizeof line, "  %-24s %8d %8d %14.0f %6d %6d", f.label == "" ? "main program" : f.label.c_str(),
+			 f.instructions, f.machine_instructions, f.cycles, f.loops, f.frame_words);
+		out << line << "\n";
+		total.instructions += f.instructions;
+		total.machine_instructions += f.machine_instructions;
+	}
+	snprintf(line, sizeof line, "  %-24s %8d %8d", "total", total.instructions, total.machine_instructions);
+	out << line << "\n";
+	out << "  (estimated cycles are for one run of each, with each loop going around " << loop_weight << " times)\n";
+
+	if (!calls.empty()) {
+		snprintf(line, sizeof line, "  %-24s %8s %14s", "calls to", "CALLs", "est. times");
+		out << line << "\n";
+		for (const auto &[callee, count] : calls) {
+			snprintf(line, sizeof line, "  %-24s %8d %14.0f", callee.c_str(), count.first, count.second);
+			out << line << "\n";
+		}
+	}
+
+	snprintf(line, sizeof line, "  %-24s %8s %8s %14s", "line", "instrs", "machine", "est. cycles");
+	out << line << "\n";
+	for (const auto &[number, n] : lines) {
+		snprintf(line, sizeof line, "  %-24s %8d %8d %14.0f", number == 0 ? "?" : str(number).c_str(),
+			 n.instructions, n.machine_instructions, n.cycles);
+		out << line << "\n";
+	}
+}
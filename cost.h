@@ -0,0 +1,61 @@
+#if ! defined COST_H
+#define COST_H
+
+#include <iostream>
+#include <map>
+#include <vector>
+#include "HERA_IR.h"
+
+// tiger --cost-report: what the final HERA code of each function (and the main program) will cost,
+//  worked out from the same HERA_insns that IR_emit_HERA writes out, after the peephole optimizer.
+//
+// For each function, and each line of the Tiger program, it counts
+//  - instructions, as written (SET, BR, CALL, ... count as one each), and
+//  - machine instructions, once the HERA pseudo-instructions are expanded (SET is SETLO and SETHI,
+//    a branch or CALL to a label also sets Rt first, and LABEL's are nothing at all),
+// and it estimates the cycles for running it once, i.e. for one call of a function:
+//  each machine instruction is one cycle, and anything that goes to memory (LOAD, STORE) or
+//  changes the PC (branches, CALL, RETURN) is one more; code inside a loop (which we find from
+//  the branches that go back up the code) is counted as if the loop ran loop_weight times.
+// None of that is from real HERA hardware, but it's enough to compare one version of the code with another.
+//
+// It also lists each function's frame size in words (see layout_frames.cpp), which is the biggest
+//  of 3 + parameters + save slots and the highest offset from FP that the code uses, and how many
+//  times each function is called, from where (e.g. tstrcmp, for each string comparison).
+//
+// Lines come from marks (HERA_text's with a "line" and no text) that HERA_code puts in front of each
+//  expression in a sequence (or argument list), each declaration, and each function body, when
+//  IR_program::mark_lines is set; IR_emit_HERA takes them out again before writing the code.
+//  Code reused from --cache-dir has no such marks, so it only counts for its function.
+
+const int loop_weight = 10;
+
+HERA_insn cost_line_mark(int line);          // for HERA_code
+void cost_remove_line_marks(HERA_insns &code);
+
+// The model, for one instruction, once (tiger --profile uses these too, see HERA_interpreter.h)
+int cost_machine_instructions(const HERA_insn &insn);
+int cost_cycles(const HERA_insn &insn);
+
+struct cost_numbers {
+	int instructions = 0;
+	int machine_instructions = 0;
+	double cycles = 0;  // estimated, per run (with each loop running loop_weight times)
+};
+
+struct cost_report {
+	struct function_cost : cost_numbers {
+		string label;  // "" for the main program
+		int loops = 0;
+		int frame_words = 0;
+	};
+	std::vector<function_cost> functions;
+	std::map<int, cost_numbers> lines;                // by line of the Tiger program; 0 for code we don't know the line of
+	std::map<string, std::pair<int, double>> calls;  // for each function called: how many CALLs, and estimated times per run of their callers
+
+	void add(const string &label, int params, int save_slots, const HERA_insns &code);
+	void add_cached(const std::vector<string> &function_labels, const HERA_insns &code);  // a whole group from --cache-dir
+	void print(std::ostream &out) const;  // for --cost-report
+};
+
+#endif
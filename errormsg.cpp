@@ -9,14 +9,17 @@ using namespace std;
 #include "util.h"
 #include "errormsg.h"
 
-static int EM_errCount;
-static int EM_maxErrs;
+// All of this is per-thread, so that different threads can compile different files at once (tiger --batch -j)
+static thread_local int EM_errCount;
+static thread_local int EM_maxErrs;
 // static ScannerPosition EM_tokPos; not needed with location.hh, I hope...
-static bool EM_showingDebug;
-static bool EM_crashOnFatal;
+static thread_local bool EM_showingDebug;
+static thread_local bool EM_crashOnFatal;
+static thread_local bool EM_throwOnFatal;
+static thread_local std::ostream *EM_out = 0;  // 0 means cerr
 
-static string fileName;
-static int lineNum;
+static thread_local string fileName;
+static thread_local int lineNum;
 
 typedef struct intList_ {int i; struct intList_ *rest;} *IntList;
 static IntList intList(int i, IntList rest) 
@@ -26,7 +29,7 @@ static IntList intList(int i, IntList rest)
 	return l;
 }
 
-static IntList linePos=NULL;
+static thread_local IntList linePos=NULL;
 
 #if 0  /* cutting this out since it's now in tigerParseDriver */
 #if ! defined ERRORMSG_SKIP_LEX
@@ -34,12 +37,13 @@ static bool set_lex_input(bool use_stdin, const char *fname);  // set stuff for
 #endif
 #endif
 
-void EM_reset(string fname, int max_errors, bool show_debug, bool crash_compiler_on_fatal_error)
+void EM_reset(string fname, int max_errors, bool show_debug, bool crash_compiler_on_fatal_error, bool throw_on_fatal_error)
 {
 	EM_errCount = 0;
 	EM_maxErrs  = max_errors;
 	EM_showingDebug = show_debug;
 	EM_crashOnFatal = crash_compiler_on_fatal_error;
+	EM_throwOnFatal = throw_on_fatal_error;
 	//	EM_tokPos = 1;  not needed with location.hh, I hope...
 	fileName=fname;
 	lineNum=1;
@@ -99,12 +103,22 @@ static string EM_intpos_to_string(int position, const string &divider)
 }
 #endif
 
+void EM_set_output(std::ostream *where)
+{
+	EM_out = where;
+}
+
+std::ostream &EM_output()
+{
+	return EM_out ? *EM_out : cerr;
+}
+
 static void EM_core(string message, Position pos)
 {
 #if USING_LOCATION_FROM_BISON
-	cerr << str(pos) << ": " << message << endl;
+	EM_output() << str(pos) << ": " << message << endl;
 #else
-	cerr << fileName << " " << str(pos) << ": " << message << endl;
+	EM_output() << fileName << " " << str(pos) << ": " << message << endl;
 #endif
 }
 
@@ -115,9 +129,11 @@ void EM_error(string message, bool fatal, Position position)
 	EM_errCount++;
 	EM_core(message, position);
 	if (fatal || (EM_maxErrs > 0 && EM_errCount >= EM_maxErrs)) {
-		fprintf(stderr, "Giving up due to fatal error or too many errors\n");
+		EM_output() << "Giving up due to fatal error or too many errors" << endl;
 		if (fatal && EM_crashOnFatal)
 			abort(); // get into the debugger, I hope
+		else if (EM_throwOnFatal)
+			throw EM_fatal_error();
 		else
 			exit(2);
 	}
@@ -150,7 +166,7 @@ Position Position::fromLex(ScannerPosition posAttributeInLex) {
 	if (it.l.begin.filename == 0 && it.l.end.filename == 0) {
 		it.l.begin.filename = &fileName; // use the one from EM_reset ...
 		it.l.end.filename   = &fileName; // @TODO: figure out why flex doesn't give this
-		static bool whinedAlready = false;
+		static thread_local bool whinedAlready = false;
 		if (!whinedAlready) {
 			EM_debug("Huh, had to build Position from flex info that lacked file name, by using hack", it);
 			whinedAlready=true;
@@ -212,6 +228,15 @@ string Position::__str__()
 #endif
 }
 
+int Position::line()
+{
+#if USING_LOCATION_FROM_BISON
+	return undef ? 0 : l.begin.line;
+#else
+	return s < 0 ? 0 : atoi(EM_intpos_to_string(s, ".").c_str());
+#endif
+}
+
 string Position::__repr__()
 {
 #if USING_LOCATION_FROM_BISON
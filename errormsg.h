@@ -1,6 +1,7 @@
 #if ! defined ERRORMSG_H
 #define ERRORMSG_H
 
+#include <ostream>
 #include "util.h"
 
 #define USING_LOCATION_FROM_BISON 1
@@ -22,6 +23,7 @@ public:
 
 	string __repr__();
 	string __str__();
+	int line();  // where it starts, or 0 if it's undefined
 
 private: // actually, these are just 'discouraged' style; remove this line if you really want to call them rather than using the named static operations above
 	Position();
@@ -51,7 +53,16 @@ bool EM_recorded_any_errors();
 //  show_debug controls printing of EM_debug messages
 //  crash_compiler_on_fatal_error can be turned on to cause fatal errors to call "abort", hopefully triggering debugger at that point
 
-void EM_reset(string filename, int max_errors=-1, bool show_debug=false, bool crash_compiler_on_fatal_error=false);
+//  throw_on_fatal_error makes fatal errors (or too many errors) throw EM_fatal_error rather than exit,
+//   so that compiling many files in one process (tiger --batch) can give up on just one of them
+
+void EM_reset(string filename, int max_errors=-1, bool show_debug=false, bool crash_compiler_on_fatal_error=false, bool throw_on_fatal_error=false);
+struct EM_fatal_error {};  // see throw_on_fatal_error above
+
+// Where errors, warnings, and debugging output go (for this thread); the default, or 0, means cerr.
+//  tiger --batch -j uses this to collect each file's messages, to print them in order.
+void EM_set_output(std::ostream *where);
+std::ostream &EM_output();
 
 //
 // These should ONLY be called from the lexical scanner, so we just declare them there
@@ -0,0 +1,285 @@
+#include <algorithm>
+#include <map>
+#include <set>
+#include "frames.h"
+#include "regalloc.h"
+
+/*
+ * Trimming frame set-up; see frames.h
+ */
+
+static bool is_load_from(const HERA_insn &insn, int offset, const HERA_operand &base)
+{
+	return insn.op == HERA_LOAD && insn.args.size() == 3 && insn.args[1].is_number(offset) && insn.args[2] == base;
+}
+
+// Where each call in f sets up the static link for the function it calls: the STORE(r, 2, FP_alt),
+//  and the MOVE(r, FP), or LOAD(r, 2, FP) and LOAD(r, 2, r)s, that find it (which nothing else uses),
+//  and the comment before them
+struct static_link_setup {
+	string callee;
+	std::vector<int> insns;
+	bool reads_link;  // does it start from our own static link?
+};
+
+static std::vector<static_link_setup> static_link_setups(const IR_function &f)
+{
+	std::vector<static_link_setup> setups;
+	int frame = -1;  // where the last MOVE(FP_alt, SP) was
+	for (int i = 0; i < int(f.code.size()); i++) {
+		const HERA_insn &insn = f.code[i];
+		if (insn.op == HERA_MOVE && insn.args == std::vector<HERA_operand>{HERA_FP_alt, HERA_SP}) frame = i;
+		if (insn.op != HERA_CALL || insn.args.size() != 2 || insn.args[0] != HERA_FP_alt) continue;
+		for (int j = frame + 1; frame >= 0 && j < i; j++) {
+			const HERA_insn &store = f.code[j];
+			if (store.op != HERA_STORE || !store.args[1].is_number(2) || store.args[2] != HERA_FP_alt) continue;
+			static_link_setup setup = {insn.args[1].name, {j}, false};
+			int set = HERA_previous_insn(f.code, j);
+			while (set >= 0 && f.code[set].args.size() > 0 && f.code[set].args[0] == store.args[0] &&
+			       (f.code[set].op == HERA_MOVE || is_load_from(f.code[set], 2, HERA_FP) || is_load_from(f.code[set], 2, store.args[0]))) {
+				setup.insns.push_back(set);
+				if (f.code[set].op == HERA_MOVE) break;
+				if (f.code[set].args[2] == HERA_FP) {
+					setup.reads_link = true;
+					break;
+				}
+				set = HERA_previous_insn(f.code, set);
+			}
+			if (set > 0 && f.code[set-1].op == HERA_TEXT && f.code[set-1].text.rfind("//set static link", 0) == 0)
+				setup.insns.push_back(set-1);
+			setups.push_back(setup);
+			break;
+		}
+		frame = -1;
+	}
+	return setups;
+}
+
+// take out the static link for each call in "f" to a function in "no_link"
+static void leave_out_static_links(IR_function &f, const std::set<string> &no_link)
+{
+	std::vector<bool> drop(f.code.size(), false);
+	for (const static_link_setup &setup : static_link_setups(f))
+		if (no_link.count(setup.callee))
+			for (int i : setup.insns) drop[i] = true;
+	HERA_insns kept;
+	for (unsigned i = 0; i < f.code.size(); i++)
+		if (!drop[i]) kept.push_back(f.code[i]);
+	if (kept.size() != f.code.size()) {
+		f.code = std::move(kept);
+		f.update_cfg();
+	}
+}
+
+// In a function that doesn't CALL anything, LOAD each parameter that's read more than once and
+//  never assigned just once, at the start, if its temporary gets a register.
+// A function inlined into it (see inline.h) assigns our parameters through its static link, which is
+//  our FP: it's MOVE'd from FP to set up the inlined frame, and LOADed from FP_alt's slot 2 in the body.
+//  So a STORE through anything that's ever set that way counts as assigning, too.
+static void parameters_in_temporaries(IR_function &f)
+{
+	int last = HERA_previous_insn(f.code, f.code.size());  // the STORE of the result, which doesn't count as assigning
+	std::vector<HERA_operand> our_frame = {HERA_FP};
+	for (const HERA_insn &insn : f.code)
+		if ((insn.op == HERA_MOVE && insn.args[1] == HERA_FP) || is_load_from(insn, 2, HERA_FP_alt))
+			our_frame.push_back(insn.args[0]);
+	std::vector<int> loads(f.params, 0);
+	std::vector<bool> assigned(f.params, false);
+	for (int i = 0; i < int(f.code.size()); i++) {
+		const HERA_insn &insn = f.code[i];
+		if (insn.op == HERA_CALL) return;
+		if ((insn.op != HERA_LOAD && insn.op != HERA_STORE) || insn.args.size() != 3) continue;
+		int p = insn.args[1].n - 3;
+		if (p < 0 || p >= f.params) continue;
+		if (insn.op == HERA_LOAD && insn.args[2] == HERA_FP) loads[p]++;
+		else if (insn.op == HERA_STORE && i != last && std::find(our_frame.begin(), our_frame.end(), insn.args[2]) != our_frame.end())
+			assigned[p] = true;
+	}
+
+	for (int p = 0; p < f.params; p++) {
+		if (loads[p] < 2 || assigned[p]) continue;
+		IR_function trial = f;
+		int slot = 3 + p;
+		int t = trial.new_temporary(home_past_registers(f));
+		for (HERA_insn &insn : trial.code)
+			if (is_load_from(insn, slot, HERA_FP)) insn = HERA_insn(HERA_MOVE, {insn.args[0], HERA_temporary(t)});
+		trial.code.insert(trial.code.begin(), HERA_insn(HERA_LOAD, {HERA_temporary(t), HERA_number(slot), HERA_FP}));
+		trial.update_cfg();
+		if (all_get_registers(trial, {t})) f = std::move(trial);
+	}
+}
+
+// Which of the program's functions nothing could need the static link of (see frames.h)
+static std::set<string> need_no_link(const IR_program &program)
+{
+	std::map<string, const IR_function *> lowered;
+	std::set<int> chains;  // cache groups in which some function follows static links
+	for (const IR_function &f : program.functions) {
+		lowered[f.label] = &f;
+		std::vector<HERA_operand> links = {HERA_Rt};  // what holds a static link (IR_optimize_loops puts them in temporaries)
+		for (const HERA_insn &insn : f.code)
+			if (is_load_from(insn, 2, HERA_FP)) links.push_back(insn.args[0]);
+		for (const HERA_insn &insn : f.code)
+			if (insn.op == HERA_LOAD && insn.args.size() == 3 && insn.args[1].is_number(2) &&
+			    std::find(links.begin(), links.end(), insn.args[2]) != links.end())
+				chains.insert(f.cache_group);
+	}
+
+	// which ones look at their static link themselves, and which pass it on (or a link found from it)
+	std::set<string> need;
+	std::map<string, std::vector<string>> passes_on;
+	for (const IR_function &f : program.functions) {
+		std::vector<bool> in_setup(f.code.size(), false);
+		for (const static_link_setup &setup : static_link_setups(f)) {
+			for (int i : setup.insns) in_setup[i] = true;
+			if (setup.reads_link) passes_on[f.label].push_back(setup.callee);
+		}
+		bool reads_link = chains.count(f.cache_group);
+		for (int i = 0; i < int(f.code.size()); i++)
+			if (!in_setup[i] && is_load_from(f.code[i], 2, HERA_FP)) reads_link = true;
+		if (reads_link) need.insert(f.label);
+	}
+	// and a function needs its static link if it passes it on to one that does, or that we can't
+	//  leave it out for (one of the library's doesn't get one at all)
+	for (bool more = true; more; ) {
+		more = false;
+		for (const auto &[label, callees] : passes_on) {
+			if (need.count(label)) continue;
+			int group = lowered[label]->cache_group;
+			for (const string &callee : callees)
+				if (need.count(callee) || !lowered.count(callee) || (group >= 0 && lowered[callee]->cache_group != group)) {
+					need.insert(label);
+					more = true;
+					break;
+				}
+		}
+	}
+	std::set<string> no_link;
+	for (const IR_function &f : program.functions)
+		if (!need.count(f.label)) no_link.insert(f.label);
+	return no_link;
+}
+
+void IR_trim_frames(IR_program &program)
+{
+	std::map<string, const IR_function *> lowered;
+	for (const IR_function &f : program.functions)
+		lowered[f.label] = &f;
+	std::set<string> no_link = need_no_link(program);
+	for (IR_function &f : program.functions) {
+		std::set<string> here;  // the ones we can leave out from this group
+		for (const string &label : no_link)
+			if (f.cache_group < 0 || lowered[label]->cache_group == f.cache_group) here.insert(label);
+		leave_out_static_links(f, here);
+		parameters_in_temporaries(f);
+	}
+	leave_out_static_links(program.main, no_link);
+}
+
+
+// A walk up the static links in a function: LOAD(x, 2, FP), then LOAD(x, 2, x) depth-1 times
+//  (x is Rt, for a variable, or a temporary, for a call's static link or a loop's, see loops.h)
+struct static_link_walk { int first, last, depth; };
+
+static std::vector<static_link_walk> static_link_walks(const HERA_insns &code)
+{
+	std::vector<static_link_walk> walks;
+	for (int i = 0; i < int(code.size()); i++) {
+		if (!is_load_from(code[i], 2, HERA_FP)) continue;
+		const HERA_operand &x = code[i].args[0];
+		static_link_walk w = {i, i, 1};
+		for (int j = HERA_next_insn(code, i); j >= 0 && is_load_from(code[j], 2, x) && code[j].args[0] == x; j = HERA_next_insn(code, j))
+			w.last = j, w.depth++;
+		if (x == HERA_Rt) {  // then the variable's LOAD or STORE, which can use the outer frame directly
+			int user = HERA_next_insn(code, w.last);
+			if (user < 0 || (code[user].op != HERA_LOAD && code[user].op != HERA_STORE) || code[user].args.size() != 3 ||
+			    code[user].args[2] != HERA_Rt || code[user].args[0] == HERA_Rt)
+				continue;
+		}
+		walks.push_back(w);
+	}
+	return walks;
+}
+
+// f, with the walks to the frames in "cached" (depth -> temporary) done once, at the start
+static IR_function with_cached_links(const IR_function &f, const std::map<int, int> &cached)
+{
+	IR_function result = f;
+	HERA_insns &code = result.code;
+	std::vector<bool> drop(code.size(), false);
+	for (const static_link_walk &w : static_link_walks(f.code)) {
+		auto c = cached.find(w.depth);
+		if (c == cached.end()) continue;
+		HERA_operand frame = HERA_temporary(c->second);
+		HERA_operand x = code[w.first].args[0];
+		for (int i = w.first; i <= w.last; i++)
+			if (code[i].op != HERA_TEXT) drop[i] = true;
+		if (x == HERA_Rt) {
+			code[HERA_next_insn(code, w.last)].args[2] = frame;
+		} else {
+			code[w.first] = HERA_insn(HERA_MOVE, {x, frame});
+			drop[w.first] = false;
+		}
+	}
+	HERA_insns entry;
+	int deepest = 0;  // (each one starts from the one before, if it can)
+	for (const auto &[depth, t] : cached) {
+		HERA_operand frame = HERA_temporary(t);
+		if (deepest == 0) entry.push_back(HERA_insn(HERA_LOAD, {frame, HERA_number(2), HERA_FP}));
+		else entry.push_back(HERA_insn(HERA_LOAD, {frame, HERA_number(2), HERA_temporary(cached.at(deepest))}));
+		for (int d = deepest + 2; d <= depth; d++) entry.push_back(HERA_insn(HERA_LOAD, {frame, HERA_number(2), frame}));
+		deepest = depth;
+	}
+	HERA_insns kept = entry;
+	for (unsigned i = 0; i < code.size(); i++)
+		if (!drop[i]) kept.push_back(code[i]);
+	code = std::move(kept);
+	result.update_cfg();
+	return result;
+}
+
+// Cache the walks f does more than once, the ones that save the most LOADs first, as long as each one's
+//  temporary gets a register
+static void cache_static_links(IR_function &f)
+{
+	std::map<int, int> walked;  // depth -> how many LOADs each walk to it does, in all
+	for (const static_link_walk &w : static_link_walks(f.code))
+		walked[w.depth] += w.depth;
+	std::vector<std::pair<int, int>> by_savings;  // (LOADs, depth)
+	for (const auto &[depth, loads] : walked)
+		if (loads >= 2 * depth) by_savings.push_back({loads, depth});
+	std::sort(by_savings.rbegin(), by_savings.rend());
+
+	std::map<int, int> cached;  // depth -> its temporary
+	IR_function with_temporaries = f, best = f;
+	for (const auto &[loads, depth] : by_savings) {
+		IR_function trial = with_temporaries;
+		std::map<int, int> more = cached;
+		more[depth] = trial.new_temporary(home_past_registers(f));
+		IR_function changed = with_cached_links(trial, more);
+		if (all_get_registers(changed, {more[depth]})) {  // (and the ones before still do)
+			cached = more;
+			with_temporaries = std::move(trial);
+			best = std::move(changed);
+		}
+	}
+	f = std::move(best);
+}
+
+static thread_local bool caching_static_links = false;
+
+void set_static_links_cached(bool on)
+{
+	caching_static_links = on;
+}
+
+bool static_links_cached()
+{
+	return caching_static_links;
+}
+
+void IR_cache_static_links(IR_program &program)
+{
+	for (IR_function &f : program.functions)
+		cache_static_links(f);
+}
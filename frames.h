@@ -0,0 +1,41 @@
+#if ! defined FRAMES_H
+#define FRAMES_H
+
+#include "IR.h"
+
+// Trimming the work each call does with frames, on the IR (see IR.h), before registers are allocated
+//  (the frame layout itself is in layout_frames.cpp; function_code in IR.cpp leaves out the
+//  prologue and epilogue a "leaf" function doesn't need):
+//
+// - A call finds the static link it passes the same way a variable in that frame is found: its own FP,
+//   if it's calling a function declared in its body, or by following static links from its own.
+//   It only sets it (FP_alt+2) if the function it calls might look at it: the library never does,
+//   and one of the program's functions does if it LOADs from FP+2 (other than to pass it on to a function
+//   that doesn't, as a recursive function that uses no outer variables does), or if any function
+//   declared with it (in its cache group, with --cache-dir) follows a chain of static links, which
+//   could go through its frame. With --cache-dir, a function in a group only leaves out the static link
+//   for calls within the group, since another group might come from the cache next time, while the
+//   main program (which is never cached) can for any function whose IR is here.
+//
+// - In a function that CALLs nothing, only its own code (including functions inlined into it, which
+//   assign its parameters through their static links) can change its parameters while it runs, so
+//   a parameter it reads more than once and never assigns is LOADed once, into a temporary of its own,
+//   if allocate_registers can give that a register (otherwise it's left in its slot).
+
+void IR_trim_frames(IR_program &program);
+
+// With --static-links=cached, a function that follows the static links to the same outer frame
+//  more than once (for its variables, or a call's static link) follows them just once, at the start,
+//  into a temporary, so each of those uses takes no LOADs to get to the frame, however deep it is.
+//  Frames that save the most LOADs go first, and each only if its temporary gets a register
+//  (which it then keeps across calls, since functions save the registers they use), so a function
+//  with no registers to spare still walks the links each time.
+//  Static links never change, so this doesn't need to know what's in between.
+//  To leave room for those registers, a function's frame has a save slot for each frame it's nested
+//  in (up to the 10 registers), as well as those it needs for its expressions (see layout_frames.cpp).
+
+void IR_cache_static_links(IR_program &program);
+void set_static_links_cached(bool on);  // for this thread; compile_tiger_program sets it for --static-links=cached
+bool static_links_cached();
+
+#endif
@@ -0,0 +1,95 @@
+#include <map>
+#include <set>
+#include "inline.h"
+#include "regalloc.h"
+
+/*
+ * Inlining small leaf functions; see inline.h
+ */
+
+// a function we can copy into its callers: small, and it never CALLs anything or uses FP_alt
+static bool can_inline(const IR_function &f)
+{
+	int instructions = 0;
+	for (const HERA_insn &insn : f.code) {
+		if (insn.op == HERA_CALL || insn.op == HERA_RETURN || insn.op == HERA_HALT) return false;
+		for (const HERA_operand &a : insn.args)
+			if (a == HERA_FP_alt || a == HERA_PC_ret) return false;
+		if (insn.op != HERA_TEXT && insn.op != HERA_LABEL) instructions++;
+	}
+	return instructions <= inline_limit;
+}
+
+// the body of "callee", for a call from "caller" (which gets new temporaries for it, listed in "added");
+//  labels get "suffix" so each copy has its own
+static HERA_insns inlined_body(const IR_function &callee, IR_function &caller, const string &suffix, std::vector<int> &added)
+{
+	std::set<string> labels;
+	bool uses_SP = false;
+	for (const HERA_insn &insn : callee.code) {
+		if (insn.op == HERA_LABEL) labels.insert(insn.args[0].name);
+		for (const HERA_operand &a : insn.args)
+			if (a == HERA_SP) uses_SP = true;
+	}
+
+	std::map<int, int> temporary;
+	HERA_insns code;
+	code.push_back(HERA_text("//inlined " + callee.label + "\n"));
+	// its variables go after its save slots (see layout_frames.cpp), which it doesn't use now, so skip them
+	if (uses_SP && callee.save_slots > 0) code.push_back(HERA_insn(HERA_INC, {HERA_SP, HERA_number(callee.save_slots)}));
+	for (HERA_insn insn : callee.code) {
+		for (HERA_operand &a : insn.args) {
+			int t = HERA_temporary_number(a);
+			if (t >= 0) {
+				if (!temporary.count(t)) {
+					temporary[t] = caller.new_temporary(callee.temporary_home[t]);
+					added.push_back(temporary[t]);
+				}
+				a = HERA_temporary(temporary[t]);
+			} else if (a == HERA_FP) {
+				a = HERA_FP_alt;
+			} else if ((insn.op == HERA_LABEL || HERA_is_branch(insn)) && a.kind == HERA_operand::label && labels.count(a.name)) {
+				a.name += suffix;
+			}
+		}
+		code.push_back(insn);
+	}
+	if (uses_SP && callee.save_slots > 0) code.push_back(HERA_insn(HERA_DEC, {HERA_SP, HERA_number(callee.save_slots)}));
+	return code;
+}
+
+// inline the calls in "caller" to the functions in "small", if their temporaries all get registers;
+//  "copies" numbers the copies, for their labels
+static void inline_calls(IR_function &caller, const std::map<string, const IR_function *> &small, int &copies)
+{
+	IR_function inlined = caller;
+	inlined.code.clear();
+	std::vector<int> added;
+	for (const HERA_insn &insn : caller.code) {
+		auto callee = insn.op == HERA_CALL && insn.args.size() == 2 ? small.find(insn.args[1].name) : small.end();
+		if (callee == small.end() || callee->second->cache_group != caller.cache_group) {
+			inlined.code.push_back(insn);
+			continue;
+		}
+		HERA_insns body = inlined_body(*callee->second, inlined, "_inline" + str(++copies), added);
+		inlined.code.insert(inlined.code.end(), body.begin(), body.end());
+	}
+	if (added.empty()) return;
+
+	inlined.update_cfg();
+	if (all_get_registers(inlined, added)) caller = std::move(inlined);
+}
+
+void IR_inline_small_functions(IR_program &program)
+{
+	std::map<string, const IR_function *> small;
+	for (const IR_function &f : program.functions)
+		if (can_inline(f)) small[f.label] = &f;
+	if (small.empty()) return;
+
+	int copies = 0;
+	for (IR_function &f : program.functions)
+		if (!small.count(f.label))  // (so the ones we copy don't change while we're copying them)
+			inline_calls(f, small, copies);
+	inline_calls(program.main, small, copies);
+}
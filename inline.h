@@ -0,0 +1,24 @@
+#if ! defined INLINE_H
+#define INLINE_H
+
+#include "IR.h"
+
+// Inlining small functions into their callers, on the IR (see IR.h), before registers are allocated.
+//
+// A call to a function still sets up the callee's frame at FP_alt (the static link and the arguments),
+//  but if the function is a small "leaf" (no more than inline_limit instructions, and no CALLs of its own),
+//  the CALL is replaced by a copy of the function's body, which then uses FP_alt for its frame
+//  instead of FP, and gets its own temporaries and labels; so there's no CALL, RETURN, or saving
+//  and restoring registers. (The library routines that are that small are done without even a frame,
+//  by A_callExp_::HERA_code.)
+//
+// The copied temporaries have to get registers of their own: if allocate_registers can't give them
+//  one each (without putting everything back in its home register), the caller keeps its CALLs.
+//  With --cache-dir, a function is only inlined into callers in its own cache group, so that the code
+//  doesn't depend on which groups came from the cache.
+
+const int inline_limit = 24;
+
+void IR_inline_small_functions(IR_program &program);
+
+#endif
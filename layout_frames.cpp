@@ -1,7 +1,50 @@
 #include "AST.h"
+#include "HERA_IR.h"
+#include "frames.h"
 
 void layout_frames(AST_node_ *root)
 {
 	// do what it takes to set up frames
 }
 
+// A function's frame is
+//	FP+0        PC_ret (saved by the function)
+//	FP+1        FP_alt (saved by the function)
+//	FP+2        static link
+//	FP+3 ...    the argument slots: the parameters, or one slot if there are none, since
+//	            the result is returned in FP+3
+//	then        saved_register_slots() slots for saving registers (and spills, see regalloc.h),
+//	then        the variables of the body, in the order they are declared.
+//
+// We need to know where the variables go before we generate code for the body,
+//  but only know which registers it uses after register allocation, so we leave room for
+//  the registers the result_reg numbering would have used, which is as many as we could need
+//  (the allocator never uses more); the function only saves the ones it actually writes.
+
+int A_fundec_::number_of_params()
+{
+	if (head(this->type_field_list()) == Ty_Void()) return 0;
+	return length(this->type_field_list());
+}
+
+int A_fundec_::argument_slots()
+{
+	return std::max(1, this->number_of_params());
+}
+
+// With --static-links=cached, there's one more for each frame this one is nested in, so the
+//  function can keep its way to each of them in a register (see frames.h).
+int A_fundec_::saved_register_slots()
+{
+	int slots = _body->result_reg();
+	if (static_links_cached())
+		slots += std::min(this->result_frames(), std::max(0, HERA_allocatable_registers - slots));
+	return slots;
+}
+
+// The main program doesn't save registers, but if its expressions run past R10 in the
+//  result_reg numbering, its frame starts with a slot for each extra register, for spills.
+int A_root_::spill_slots()
+{
+	return std::max(0, main_expr->result_reg() - HERA_allocatable_registers);
+}
@@ -20,7 +20,7 @@
 // Note that T must have a constructor that does not require arguments
 template <class T> class lazy {
 public:
-	lazy<T>(std::function<T ()> init_function);
+	lazy(std::function<T ()> init_function);
 
 	const T &get() const;	// get the value if it has been set, or throw a lazy::cyclic_definition exception if not yet set
 
@@ -32,15 +32,16 @@ public:
 		cyclic_definition(const lazy<T> &what);
 	};
 
-private:
+protected:
 	// what state is it currently in?
 	bool is_empty() const;
 	bool is_running() const;
 	bool is_ready() const;
 
+private:
 	std::function<T ()> my_initializer;
 	mutable enum { empty, running, ready } current_state;
-	mutable T *my_ptr;
+	mutable T my_value;
 };
 
 
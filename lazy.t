@@ -6,23 +6,21 @@
  *  rather than putting it in a separate ".cc" file that includes lazy.h.
  */
 
-template <class T> lazy<T>::lazy(std::function<T ()> init_function)
+template <class T> lazy<T>::lazy(std::function<T ()> init_function) : my_initializer(init_function), current_state(empty), my_value()
 {
-	current_state = empty;
-	my_initializer = init_function;
 }
 
 template <class T> const T &lazy<T>::get() const
 {
 	if (is_ready()) {
-		return *my_ptr;
+		return my_value;
 	} else if (is_running()) {
 		throw cyclic_definition(*this);
 	} else {
 		current_state = running;
-		my_ptr = new T(my_initializer());
+		my_value = my_initializer();
 		current_state = ready;
-		return *my_ptr;
+		return my_value;
 	}
 }
 
@@ -0,0 +1,368 @@
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <set>
+#include "loops.h"
+#include "regalloc.h"
+
+/*
+ * Optimizing for loops; see loops.h
+ */
+
+static const char cond_prefix[] = "my_for_cond_", post_prefix[] = "my_for_post_";
+
+static bool is_frame_slot(const HERA_insn &insn, HERA_op op, int slot)
+{
+	return insn.op == op && insn.args.size() == 3 && insn.args[1].is_number(slot) && insn.args[2] == HERA_FP;
+}
+
+static int find_label(const HERA_insns &code, const string &label)
+{
+	for (int i = 0; i < int(code.size()); i++)
+		if (code[i].op == HERA_LABEL && code[i].args.size() == 1 && code[i].args[0].name == label) return i;
+	return -1;
+}
+
+// keep the variable of the loop at "cond" in a temporary, if it gets a register
+static void promote(IR_function &f, const string &cond)
+{
+	int start = find_label(f.code, cond);
+	int end = find_label(f.code, post_prefix + cond.substr(strlen(cond_prefix)));
+	if (start < 0 || end < start) return;
+	int first = HERA_next_insn(f.code, start);  // the LOAD for the comparison
+	if (first < 0 || first >= end || f.code[first].op != HERA_LOAD || f.code[first].args[2] != HERA_FP) return;
+	int slot = f.code[first].args[1].n;
+
+	int increment = -1;  // the one STORE to the slot
+	bool calls = false;  // or an inlined function, which finds our frame through its static link in FP_alt
+	for (int i = start; i < end; i++) {
+		if (f.code[i].op == HERA_CALL) calls = true;
+		for (auto &arg : f.code[i].args)
+			if (arg == HERA_FP_alt) calls = true;
+		if (is_frame_slot(f.code[i], HERA_STORE, slot)) {
+			if (increment >= 0) return;
+			increment = i;
+		}
+	}
+	if (increment < 0) return;
+
+	IR_function trial = f;
+	int t = trial.new_temporary(home_past_registers(f));
+	HERA_operand v = HERA_temporary(t);
+	for (int i = start; i < end; i++)
+		if (is_frame_slot(trial.code[i], HERA_LOAD, slot))
+			trial.code[i] = HERA_insn(HERA_MOVE, {trial.code[i].args[0], v});
+	HERA_operand counter = trial.code[increment].args[0];
+	int inc = HERA_previous_insn(trial.code, increment), load = HERA_previous_insn(trial.code, inc);
+	if (load >= start && trial.code[load].op == HERA_MOVE && trial.code[load].args == std::vector<HERA_operand>{counter, v} &&
+	    trial.code[inc].op == HERA_INC && trial.code[inc].args[0] == counter) {
+		// just INC(v, 1), since the counter's temporary isn't used anywhere else
+		trial.code[inc].args[0] = v;
+		trial.code[increment] = trial.code[load] = HERA_insn();
+	} else {
+		trial.code[increment] = HERA_insn(HERA_MOVE, {v, counter});
+	}
+	if (calls) trial.code.insert(trial.code.begin() + increment + 1, HERA_insn(HERA_STORE, {v, HERA_number(slot), HERA_FP}));
+	trial.code.insert(trial.code.begin() + start, HERA_insn(HERA_LOAD, {v, HERA_number(slot), HERA_FP}));
+	trial.update_cfg();
+	if (all_get_registers(trial, {t})) f = std::move(trial);
+}
+
+static void promote_loop_variables(IR_function &f)
+{
+	std::vector<string> loops;
+	for (const HERA_insn &insn : f.code)
+		if (insn.op == HERA_LABEL && insn.args.size() == 1 && insn.args[0].name.rfind(cond_prefix, 0) == 0)
+			loops.push_back(insn.args[0].name);
+	for (const string &cond : loops)
+		promote(f, cond);
+}
+
+
+// The loops in f's control flow graph, from its back edges (to a block that dominates the one they come from):
+//  for each loop's header (the block they go back to), the blocks in the loop
+static std::map<int, std::set<int>> find_loops(const IR_function &f)
+{
+	const HERA_blocks &cfg = f.cfg;
+	int nb = cfg.count();
+	std::vector<bool> reached(nb, false);
+	std::vector<int> work;
+	if (nb > 0) work.push_back(0);
+	while (!work.empty()) {
+		int b = work.back();
+		work.pop_back();
+		if (reached[b]) continue;
+		reached[b] = true;
+		for (int s : cfg.successors[b]) work.push_back(s);
+	}
+
+	std::vector<std::vector<bool>> dominators(nb, std::vector<bool>(nb, true));
+	if (nb > 0) {
+		dominators[0].assign(nb, false);
+		dominators[0][0] = true;
+	}
+	for (bool changed = true; changed; ) {
+		changed = false;
+		for (int b = 1; b < nb; b++) {
+			std::vector<bool> d(nb, true);
+			for (int p : cfg.predecessors[b])
+				for (int x = 0; x < nb; x++) d[x] = d[x] && dominators[p][x];
+			d[b] = true;
+			if (d != dominators[b]) {
+				dominators[b] = d;
+				changed = true;
+			}
+		}
+	}
+
+	std::map<int, std::set<int>> loops;
+	for (int b = 0; b < nb; b++)
+		for (int h : cfg.successors[b]) {
+			if (!reached[b] || !dominators[b][h]) continue;
+			std::set<int> &blocks = loops[h];
+			blocks.insert(h);
+			for (work = {b}; !work.empty(); ) {
+				int x = work.back();
+				work.pop_back();
+				if (blocks.insert(x).second)
+					for (int p : cfg.predecessors[x]) work.push_back(p);
+			}
+		}
+	return loops;
+}
+
+// what we can take out of a loop: arithmetic on values that don't change in it, and LOADs from
+//  memory that nothing in it could STORE to
+static const std::set<HERA_op> hoistable = {
+	HERA_SET, HERA_ADD, HERA_SUB, HERA_MUL, HERA_AND, HERA_OR, HERA_XOR, HERA_LSL, HERA_LSR, HERA_ASL, HERA_ASR, HERA_LSL8, HERA_LSR8, HERA_LOAD,
+};
+
+enum loop_changes { everything, memory_only };
+
+// Take what we can out of the loop with header block h (see loops.h), and strength-reduce its
+//  multiplications of the induction variables (if "changes" is everything), if the new
+//  temporaries all get registers; return false if they don't
+static bool optimize_loop(IR_function &f, int h, const std::set<int> &blocks, loop_changes changes)
+{
+	const HERA_blocks &cfg = f.cfg;
+	HERA_insns code = f.code;
+	int n = code.size(), label = cfg.first[h];
+	if (code[label].op != HERA_LABEL) return true;
+	// the new code goes just before the header's label, at the end of the one block that comes
+	//  into the loop from outside, which has to fall into it, and not look at the flags we'd change
+	std::vector<int> outside;
+	for (int p : cfg.predecessors[h])
+		if (!blocks.count(p)) outside.push_back(p);
+	int last = HERA_previous_insn(code, label);
+	if (outside.size() != 1 || outside[0] != h - 1 || last < 0 || HERA_is_unconditional(code[last]) ||
+	    (HERA_is_branch(code[last]) && code[last].args[0] == code[label].args[0]) || !HERA_flags_dead_after(code, label))
+		return true;
+
+	std::vector<bool> in_loop(n, false);
+	for (int b : blocks)
+		for (int i = cfg.first[b]; i < cfg.first[b+1]; i++) in_loop[i] = true;
+
+	// what the loop might change in memory
+	bool calls = false, other_stores = false;
+	std::set<int> frame_stores;
+	std::set<std::pair<int, int>> outer_stores;  // (how many static links out, offset)
+	// each walk up the static links, LOAD(Rt, 2, FP), LOAD(Rt, 2, Rt), ..., to the instruction that uses Rt
+	struct chain { int first, depth, user; };
+	std::vector<chain> chains;
+	for (int i = 0; i < n; i++) {
+		if (!in_loop[i]) continue;
+		const HERA_insn &insn = code[i];
+		if (insn.op == HERA_CALL) calls = true;
+		// an inlined function following its static link (see inline.h) can STORE to this frame or any outer one,
+		//  through registers we don't keep track of, so that's as bad as a CALL
+		if (insn.op == HERA_LOAD && insn.args.size() == 3 && insn.args[1].is_number(2) && insn.args[2] == HERA_FP_alt) calls = true;
+		if (insn.op == HERA_LOAD && insn.args == std::vector<HERA_operand>{HERA_Rt, HERA_number(2), HERA_FP}) {
+			chain c = {i, 1, HERA_next_insn(code, i)};
+			while (c.user >= 0 && in_loop[c.user] && code[c.user].op == HERA_LOAD &&
+			       code[c.user].args == std::vector<HERA_operand>{HERA_Rt, HERA_number(2), HERA_Rt}) {
+				c.depth++;
+				c.user = HERA_next_insn(code, c.user);
+			}
+			if (c.user >= 0 && in_loop[c.user] && (code[c.user].op == HERA_LOAD || code[c.user].op == HERA_STORE) &&
+			    code[c.user].args.size() == 3 && code[c.user].args[2] == HERA_Rt && code[c.user].args[0] != HERA_Rt)
+				chains.push_back(c);
+		}
+		if (insn.op == HERA_STORE && insn.args.size() == 3) {
+			if (insn.args[2] == HERA_FP) frame_stores.insert(insn.args[1].n);
+			else if (insn.args[2] != HERA_FP_alt && insn.args[2] != HERA_Rt) other_stores = true;  // (Rt ones are below)
+		}
+	}
+	for (const chain &c : chains)
+		if (code[c.user].op == HERA_STORE) outer_stores.insert({c.depth, code[c.user].args[1].n});
+	for (int i = 0; i < n; i++)  // a STORE through Rt that isn't at the end of a chain could go anywhere
+		if (in_loop[i] && code[i].op == HERA_STORE && code[i].args.size() == 3 && code[i].args[2] == HERA_Rt &&
+		    std::none_of(chains.begin(), chains.end(), [i](const chain &c) { return c.user == i; }))
+			other_stores = true;
+
+	IR_function trial = f;
+	std::vector<bool> drop(n, false);
+	std::map<int, HERA_insns> insert_before;  // at each instruction
+	HERA_insns &preheader = insert_before[label];
+	std::vector<int> added;  // the temporaries that need registers
+
+	// the walks up the static links: one temporary for each depth, set up before the loop
+	std::map<int, int> link;         // depth -> its temporary
+	std::map<int, int> link_depth;   // and back
+	for (const chain &c : chains) {
+		if (!link.count(c.depth)) {
+			int t = trial.new_temporary(home_past_registers(f));
+			link[c.depth] = t;
+			link_depth[t] = c.depth;
+			added.push_back(t);
+		}
+		for (int i = c.first; i < c.user; i++)
+			if (code[i].op != HERA_TEXT) drop[i] = true, code[i] = HERA_insn();
+		code[c.user].args[2] = HERA_temporary(link[c.depth]);
+	}
+	for (const auto &[depth, t] : link) {
+		preheader.push_back(HERA_insn(HERA_LOAD, {HERA_temporary(t), HERA_number(2), HERA_FP}));
+		for (int d = 1; d < depth; d++) preheader.push_back(HERA_insn(HERA_LOAD, {HERA_temporary(t), HERA_number(2), HERA_temporary(t)}));
+	}
+
+	// which temporaries are defined where
+	int nt = trial.temporaries();
+	std::vector<int> defs(nt, 0), defs_in_loop(nt, 0);
+	for (int i = 0; i < n; i++)
+		for (unsigned j = 0; j < code[i].args.size(); j++) {
+			int t = HERA_temporary_number(code[i].args[j]);
+			HERA_operand_role role = HERA_role(code[i], j);
+			if (t < 0 || (role != HERA_def && role != HERA_use_def)) continue;
+			defs[t]++;
+			if (in_loop[i]) defs_in_loop[t]++;
+		}
+	auto invariant = [&](const HERA_operand &operand) {
+		int t = HERA_temporary_number(operand);
+		if (t >= 0) return defs_in_loop[t] == 0;
+		return operand.kind == HERA_operand::number || operand.kind == HERA_operand::label || operand == HERA_register(0);
+	};
+	auto memory_unchanged = [&](const HERA_insn &load) {
+		if (calls) return false;
+		int offset = load.args[1].n;
+		const HERA_operand &base = load.args[2];
+		if (base == HERA_FP) return !frame_stores.count(offset);
+		int t = HERA_temporary_number(base);
+		if (link_depth.count(t)) return !outer_stores.count({link_depth[t], offset});
+		return !other_stores && invariant(base);
+	};
+
+	// 1. take out the instructions that compute the same thing every time, as long as that makes more of them
+	for (bool changed = true; changed; ) {
+		changed = false;
+		for (int i = 0; i < n; i++) {
+			HERA_insn &insn = code[i];
+			if (!in_loop[i] || !hoistable.count(insn.op) || insn.args.empty()) continue;
+			if (changes == memory_only && insn.op != HERA_LOAD) continue;
+			int t = HERA_temporary_number(insn.args[0]);
+			if (t < 0 || defs[t] != 1) continue;
+			bool ok = insn.op == HERA_LOAD ? insn.args.size() == 3 && memory_unchanged(insn) : true;
+			for (unsigned j = 1; ok && j < insn.args.size(); j++)
+				if (!(insn.op == HERA_LOAD && j == 2 && insn.args[j] == HERA_FP) && !invariant(insn.args[j])) ok = false;
+			if (!ok || !HERA_flags_dead_after(code, i)) continue;
+			preheader.push_back(insn);
+			insn = HERA_insn();
+			drop[i] = true;
+			defs_in_loop[t] = 0;
+			added.push_back(t);
+			changed = true;
+		}
+	}
+
+	// 2. MUL(x, v, k) where v goes up by 1 each time it changes in the loop, and k doesn't change:
+	//    keep v*k in a temporary, which goes up by k when v does
+	std::map<std::pair<int, int>, int> product;  // (v, k) -> the temporary for v*k, by their temporaries
+	for (int i = 0; i < n && changes == everything; i++) {
+		HERA_insn &mul = code[i];
+		if (!in_loop[i] || mul.op != HERA_MUL || !HERA_flags_dead_after(code, i)) continue;
+		for (int side = 1; side <= 2; side++) {
+			HERA_operand v = mul.args[side], k = mul.args[3 - side];
+			int vt = HERA_temporary_number(v);
+			if (vt < 0 || !invariant(k) || HERA_temporary_number(k) < 0) continue;
+			// (v might be a copy, or a copy of a copy, ..., of the induction variable, made in the same block)
+			for (int at = i; vt >= 0 && defs[vt] == 1; ) {
+				int copy = HERA_previous_insn(code, at);
+				while (copy >= 0 && in_loop[copy] && code[copy].op != HERA_LABEL && !HERA_is_branch(code[copy]) &&
+				       !(code[copy].args.size() > 0 && code[copy].args[0] == v))
+					copy = HERA_previous_insn(code, copy);
+				if (copy < 0 || !in_loop[copy] || code[copy].op != HERA_MOVE || code[copy].args[0] != v) break;
+				HERA_operand source = code[copy].args[1];
+				for (int j = copy + 1; j < i; j++)
+					if (code[j].args.size() > 0 && code[j].args[0] == source) vt = -1;
+				v = source;
+				vt = vt < 0 ? -1 : HERA_temporary_number(v);
+				at = copy;
+			}
+			if (vt < 0) continue;
+			// the one change to v in the loop has to be INC(v, 1)
+			int increment = -1;
+			for (int j = 0; j < n; j++)
+				if (in_loop[j] && !code[j].args.empty() && code[j].args[0] == v && HERA_role(code[j], 0) != HERA_use)
+					increment = increment == -1 && code[j].op == HERA_INC && code[j].args[1].is_number(1) ? j : -2;
+			if (increment < 0 || defs[vt] != 2) continue;
+
+			int kt = HERA_temporary_number(k);
+			auto known = product.find({vt, kt});
+			int s;
+			if (known != product.end()) {
+				s = known->second;
+			} else {
+				s = trial.new_temporary(home_past_registers(f));
+				product[{vt, kt}] = s;
+				added.push_back(s);
+				preheader.push_back(HERA_insn(HERA_MUL, {HERA_temporary(s), v, k}));
+				insert_before[increment].push_back(HERA_insn(HERA_ADD, {HERA_temporary(s), HERA_temporary(s), k}));
+			}
+			mul = HERA_insn(HERA_MOVE, {mul.args[0], HERA_temporary(s)});
+			break;
+		}
+	}
+
+	if (added.empty()) return true;
+	trial.code.clear();
+	for (int i = 0; i < n; i++) {
+		auto before = insert_before.find(i);
+		if (before != insert_before.end())
+			trial.code.insert(trial.code.end(), before->second.begin(), before->second.end());
+		if (!drop[i]) trial.code.push_back(code[i]);
+	}
+	trial.update_cfg();
+	if (!all_get_registers(trial, added)) return false;
+	f = std::move(trial);
+	return true;
+}
+
+// Optimize each loop, innermost first (so what comes out of an inner loop can then come out of the one
+//  around it), which means finding the loops again after each change
+static void optimize_loops(IR_function &f)
+{
+	std::set<string> done;  // the headers' labels
+	for (;;) {
+		f.update_cfg();
+		auto loops = find_loops(f);
+		int next = -1;
+		for (const auto &[h, blocks] : loops) {
+			const HERA_insn &first = f.code[f.cfg.first[h]];
+			if (first.op == HERA_LABEL && !done.count(first.args[0].name) &&
+			    (next < 0 || blocks.size() < loops[next].size()))
+				next = h;
+		}
+		if (next < 0) return;
+		done.insert(f.code[f.cfg.first[next]].args[0].name);
+		if (!optimize_loop(f, next, loops[next], everything))
+			optimize_loop(f, next, loops[next], memory_only);
+	}
+}
+
+void IR_optimize_loops(IR_program &program)
+{
+	for (IR_function &f : program.functions) {
+		promote_loop_variables(f);
+		optimize_loops(f);
+	}
+	promote_loop_variables(program.main);
+	optimize_loops(program.main);
+}
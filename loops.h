@@ -0,0 +1,47 @@
+#if ! defined LOOPS_H
+#define LOOPS_H
+
+#include "IR.h"
+
+// Optimizing loops, on the IR (see IR.h), before registers are allocated.
+//
+// A_forExp_::HERA_code keeps the loop variable in its slot in the frame, and the bound in a register:
+//	    STORE(lo, slot, FP)
+//	    MOVE(hi, ...)
+//	LABEL(my_for_cond_N)
+//	    LOAD(c, slot, FP)
+//	    CMP(c, hi)
+//	    BG(my_for_post_N)
+//	    ... the body, which LOADs the variable from its slot ...
+//	    LOAD(c, slot, FP)
+//	    INC(c, 1)
+//	    STORE(c, slot, FP)
+//	    BR(my_for_cond_N)
+//	LABEL(my_for_post_N)
+// so each time around, it goes to memory at least three times for the variable.
+//
+// IR_optimize_loops first gives the variable a temporary of its own for the whole loop,
+//  LOADed once before it, so the LOADs become MOVEs (which allocate_registers mostly makes disappear)
+//  and the INC works on the register. If the loop CALLs anything, or has a function inlined into
+//  it (see inline.h, which finds this frame through FP_alt), the slot is still updated each time
+//  around, for any function declared in the body that looks at the variable (Tiger doesn't let
+//  anything assign to it). Like inline.h, it keeps a loop as it was if the new temporary wouldn't
+//  get a register.
+//
+// Then, for each loop (for or while, found from the back edges of the control flow graph, innermost first),
+//  IR_optimize_loops puts just before it (if it's only entered by falling into it) anything that gives
+//  the same result every time around:
+// - each walk up the static links to an outer function's frame (LOAD(Rt, 2, FP), LOAD(Rt, 2, Rt), ...)
+//   is done once, into a temporary for that many links up;
+// - arithmetic on temporaries that don't change in the loop, and LOADs from slots (in this frame or an outer
+//   one) or other memory that nothing in the loop STOREs to, if it doesn't CALL anything (or have a function
+//   inlined into it that follows its static link, and so might STORE to any of those frames).
+// And it strength-reduces MUL(x, i, k), where i only changes by INC(i, 1) and k doesn't change:
+//  x is a temporary set to i*k before the loop that gets an ADD of k just before each INC.
+// Nothing is moved where something might look at the flags it sets. If the new temporaries
+//  don't all get registers, it tries again with just the walks up the static links and the LOADs,
+//  and then leaves the loop alone.
+
+void IR_optimize_loops(IR_program &program);
+
+#endif
@@ -0,0 +1,132 @@
+#include "peephole.h"
+
+/*
+ * The peephole optimizer; see peephole.h
+ */
+
+static bool small_number(const HERA_operand &operand, int &n)
+{
+	if (operand.kind != HERA_operand::number || operand.n < 0 || operand.n > 9999) return false;
+	n = operand.n;
+	return true;
+}
+
+
+// MOVE(Rx, Rx), which register allocation leaves when both sides of a MOVE get the same register
+static bool self_move(HERA_insns &code, int i)
+{
+	const HERA_insn &move = code[i];
+	if (move.op != HERA_MOVE || move.args.size() != 2 || move.args[0] != move.args[1] || !HERA_flags_dead_after(code, i))
+		return false;
+	code.erase(code.begin() + i);
+	return true;
+}
+
+// STORE(Ra, k, Rb) then LOAD(Rc, k, Rb): the value is still in Ra
+static bool store_then_load(HERA_insns &code, int i)
+{
+	int j = HERA_next_insn(code, i);
+	if (j < 0) return false;
+	const HERA_insn &store = code[i], &load = code[j];
+	if (store.op != HERA_STORE || load.op != HERA_LOAD || store.args.size() != 3 || load.args.size() != 3 ||
+	    store.args[1] != load.args[1] || store.args[2] != load.args[2])
+		return false;
+	if (load.args[0] != store.args[0]) {
+		code[j] = HERA_insn(HERA_MOVE, {load.args[0], store.args[0]});  // sets the same flags as the LOAD
+	} else if (HERA_flags_dead_after(code, j)) {
+		code.erase(code.begin() + j);
+	} else {
+		return false;
+	}
+	return true;
+}
+
+// BR(L) when L is the next thing anyway (possibly after some other labels)
+static bool branch_to_next(HERA_insns &code, int i)
+{
+	if (code[i].op != HERA_BR || code[i].args.size() != 1) return false;
+	for (int j = HERA_next_insn(code, i); j >= 0 && code[j].op == HERA_LABEL; j = HERA_next_insn(code, j))
+		if (code[j].args.size() == 1 && code[j].args[0] == code[i].args[0]) {
+			code.erase(code.begin() + i);
+			return true;
+		}
+	return false;
+}
+
+// INC or DEC of a register right before another INC or DEC of it, e.g. INC(SP, 3) then DEC(SP, 3),
+//  which can be one instruction, or none
+static bool inc_dec_pair(HERA_insns &code, int i)
+{
+	int j = HERA_next_insn(code, i);
+	if (j < 0) return false;
+	const HERA_insn &first = code[i], &second = code[j];
+	int a, b;
+	if ((first.op != HERA_INC && first.op != HERA_DEC) || (second.op != HERA_INC && second.op != HERA_DEC) ||
+	    first.args.size() != 2 || second.args.size() != 2 || first.args[0] != second.args[0] ||
+	    !small_number(first.args[1], a) || !small_number(second.args[1], b))
+		return false;
+	int total = (first.op == HERA_INC ? a : -a) + (second.op == HERA_INC ? b : -b);
+	if (total > 64 || total < -64 || !HERA_flags_dead_after(code, j))  // INC and DEC only go up to 64
+		return false;
+	HERA_operand reg = first.args[0];
+	code.erase(code.begin() + j);
+	if (total == 0) {
+		code.erase(code.begin() + i);
+	} else {
+		code[i].op = total > 0 ? HERA_INC : HERA_DEC;
+		code[i].args = {reg, HERA_number(total > 0 ? total : -total)};
+	}
+	return true;
+}
+
+// SET(Rx, a) right before SET(Rx, b): the first one doesn't matter
+static bool set_then_set(HERA_insns &code, int i)
+{
+	int j = HERA_next_insn(code, i);
+	if (j < 0 || code[i].op != HERA_SET || code[j].op != HERA_SET || code[i].args.size() != 2 || code[j].args.size() != 2 ||
+	    code[i].args[0] != code[j].args[0])
+		return false;
+	code.erase(code.begin() + i);
+	return true;
+}
+
+static const struct {
+	const char *name;
+	bool (*apply)(HERA_insns &code, int i);
+} rules[] = {
+	{"MOVE(Rx, Rx)",           self_move},
+	{"STORE then LOAD",        store_then_load},
+	{"BR to next instruction", branch_to_next},
+	{"INC/DEC then INC/DEC",   inc_dec_pair},
+	{"SET then SET",           set_then_set},
+};
+
+void peephole_optimize(HERA_insns &code, peephole_report &report)
+{
+	for (bool changed = true; changed; ) {
+		changed = false;
+		for (int i = 0; i < int(code.size()); i++)
+			for (const auto &rule : rules) {
+				if (i >= int(code.size())) break;
+				unsigned long before = code.size();
+				if (rule.apply(code, i)) {
+					report.used[rule.name]++;
+					report.removed[rule.name] += before - code.size();
+					changed = true;
+				}
+			}
+	}
+}
+
+void peephole_report::print(std::ostream &out) const
+{
+	int total = 0;
+	for (const auto &rule : rules) {
+		auto u = used.find(rule.name), r = removed.find(rule.name);
+		int times = u == used.end() ? 0 : u->second;
+		int gone = r == removed.end() ? 0 : r->second;
+		out << "  " << rule.name << ": used " << times << " times, took out " << gone << " instructions\n";
+		total += gone;
+	}
+	out << "  total: took out " << total << " instructions\n";
+}
@@ -0,0 +1,24 @@
+#if ! defined PEEPHOLE_H
+#define PEEPHOLE_H
+
+#include <iostream>
+#include <map>
+#include "HERA_IR.h"
+
+// A peephole optimizer for the final code of a function (or the main program), after register allocation:
+//  a table of rules (see peephole.cpp), each of which looks at an instruction and the next one or two
+//  (skipping comments), and rewrites them if it can, e.g. taking out MOVE(R1, R1).
+//  The rules are tried everywhere, over and over, until none of them applies.
+//
+// A rule that takes out an instruction that sets flags only does so if we can see that
+//  the flags are set again before anything could look at them.
+
+// How many times each rule was used, and how many instructions that took out
+struct peephole_report {
+	std::map<string, int> used, removed;
+	void print(std::ostream &out) const;  // for -dp
+};
+
+void peephole_optimize(HERA_insns &code, peephole_report &report);
+
+#endif
@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <sys/resource.h>
+#include "phases.h"
+
+/*
+ * Timing the phases of the compiler, for tiger --time-phases; see phases.h
+ */
+
+thread_local constinit unsigned long allocations_in_this_thread = 0;
+thread_local constinit unsigned long attributes_in_this_thread = 0;
+thread_local constinit unsigned long AST_nodes_in_this_thread = 0;
+
+// Count every allocation from the heap (the arena counts its own, in ASTArena::allocate_in_current).
+//  The array and nothrow versions of new, and all the deletes, come to these by default.
+void *operator new(std::size_t size)
+{
+	allocations_in_this_thread++;
+	if (void *p = std::malloc(size > 0 ? size : 1)) return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+
+static thread_local phase_timer *the_current_timer = 0;
+
+phase_timer *phase_timer::current()
+{
+	return the_current_timer;
+}
+
+void phase_timer::set_current(phase_timer *t)
+{
+	the_current_timer = t;
+}
+
+void phase_start(const string &phase)
+{
+	if (the_current_timer) the_current_timer->start(phase);
+}
+
+static long peak_RSS_kb()
+{
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#if defined __APPLE__
+	return usage.ru_maxrss / 1024;  // bytes, on a Mac
+#else
+	return usage.ru_maxrss;
+#endif
+}
+
+void phase_timer::start(const string &phase)
+{
+	stop();
+	running = -1;
+	for (unsigned i = 0; i < phases.size(); i++)
+		if (phases[i].name == phase) running = i;
+	if (running < 0) {
+		phases.push_back(phase_numbers());
+		phases.back().name = phase;
+		running = phases.size() - 1;
+	}
+	allocations_then = allocations_in_this_thread;
+	attributes_then = attributes_in_this_thread;
+	AST_nodes_then = AST_nodes_in_this_thread;
+	started = std::chrono::steady_clock::now();
+}
+
+void phase_timer::stop()
+{
+	if (running < 0) return;
+	phase_numbers &p = phases[running];
+	p.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+	p.allocations += allocations_in_this_thread - allocations_then;
+	p.attributes += attributes_in_this_thread - attributes_then;
+	AST_nodes += AST_nodes_in_this_thread - AST_nodes_then;
+	p.AST_nodes = AST_nodes;
+	p.peak_RSS_kb = peak_RSS_kb();
+	running = -1;
+}
+
+static string json_string(const string &s)
+{
+	string result = "\"";
+	for (char c : s) {
+		if (c == '"' || c == '\\') {
+			result += '\\';
+			result += c;
+		} else if ((unsigned char) c < ' ') {
+			char escape[8];
+			snprintf(escape, sizeof escape, "\\u%04x", c);
+			result += escape;
+		} else {
+			result += c;
+		}
+	}
+	return result + "\"";
+}
+
+phase_numbers phase_timer::total() const
+{
+	phase_numbers total;
+	total.name = "total";
+	for (const phase_numbers &p : phases) {
+		total.seconds += p.seconds;
+		total.allocations += p.allocations;
+		total.attributes += p.attributes;
+		total.AST_nodes = std::max(total.AST_nodes, p.AST_nodes);
+		total.peak_RSS_kb = std::max(total.peak_RSS_kb, p.peak_RSS_kb);
+	}
+	return total;
+}
+
+void phase_timer::print(std::ostream &out, const String &filename, bool json) const
+{
+	phase_numbers total = this->total();
+
+	char line[200];
+	if (json) {
+		out << "{\"file\": " << json_string(filename) << ", \"phases\": [";
+		for (unsigned i = 0; i <= phases.size(); i++) {
+			const phase_numbers &p = i < phases.size() ? phases[i] : total;
+			snprintf(line, sizeof line, "\"seconds\": %.6f, \"allocations\": %lu, \"attributes\": %lu, \"AST_nodes\": %lu, \"peak_RSS_kb\": %ld}",
+				 p.seconds, p.allocations, p.attributes, p.AST_nodes, p.peak_RSS_kb);
+			if (i < phases.size())
+				out << (i == 0 ? "" : ", ") << "{\"name\": " << json_string(p.name) << ", " << line;
+			else
+				out << "], \"total\": {" << line;
+		}
+		out << "}" << std::endl;
+	} else {
+		out << "Phases of compiling " << filename << ":" << std::endl;
+		snprintf(line, sizeof line, "  %-16s %10s %12s %11s %10s %14s", "phase", "seconds", "allocations", "attributes", "AST nodes", "peak RSS (KB)");
+		out << line << std::endl;
+		for (unsigned i = 0; i <= phases.size(); i++) {
+			const phase_numbers &p = i < phases.size() ? phases[i] : total;
+			snprintf(line, sizeof line, "  %-16s %10.6f %12lu %11lu %10lu %14ld",
+				 p.name.c_str(), p.seconds, p.allocations, p.attributes, p.AST_nodes, p.peak_RSS_kb);
+			out << line << std::endl;
+		}
+	}
+}
@@ -0,0 +1,56 @@
+#if ! defined PHASES_H
+#define PHASES_H
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+#include "util.h"
+
+// tiger --time-phases reports, for each phase of compiling each program, how long it took,
+//  how many allocations it made (operator new, and nodes in the AST arena), how many
+//  attributes it computed, how many AST nodes there were by the end of it, and the peak RSS
+//  of the whole process so far (so with --batch -j, that's for all the threads).
+//  --time-phases=json prints one line of JSON per program instead of a table.
+//
+// The phases are marked where they happen with phase_start("typecheck") etc.,
+//  which does nothing unless this thread has a current phase_timer (like IR_program::current()).
+//  Starting a phase again (e.g. "parse" after "parent pointers", which happen in the A_root_
+//  constructor, in the middle of parsing) adds to its earlier numbers.
+//  Lexing isn't a phase of its own: the parser calls the scanner for each token.
+
+struct phase_numbers {
+	string name;
+	double seconds = 0;
+	unsigned long allocations = 0;
+	unsigned long attributes = 0;
+	unsigned long AST_nodes = 0;     // at the end of the phase
+	long peak_RSS_kb = 0;            // at the end of the phase
+};
+
+class phase_timer {
+public:
+	void start(const string &phase);  // ends the phase before, if any
+	void stop();
+	void print(std::ostream &out, const String &filename, bool json) const;
+	const std::vector<phase_numbers> &numbers() const { return phases; }
+	phase_numbers total() const;
+
+	static phase_timer *current();  // for this thread; 0 if we're not timing
+	static void set_current(phase_timer *t);
+
+private:
+	std::vector<phase_numbers> phases;  // in the order they first started
+	int running = -1;                   // which one, if any
+	std::chrono::steady_clock::time_point started;
+	unsigned long allocations_then = 0, attributes_then = 0, AST_nodes_then = 0;  // when this phase started
+	unsigned long AST_nodes = 0;  // made in all the phases so far (which can be in different threads, for --batch -j)
+};
+
+void phase_start(const string &phase);  // if we're timing this thread
+
+// What the phase_timer counts, for this thread
+extern thread_local constinit unsigned long allocations_in_this_thread;  // see phases.cpp and ASTArena.cpp
+extern thread_local constinit unsigned long attributes_in_this_thread;   // see attribute.cpp
+extern thread_local constinit unsigned long AST_nodes_in_this_thread;    // see AST_node_::AST_node_
+
+#endif
@@ -0,0 +1,199 @@
+#include <algorithm>
+#include <deque>
+#include "errormsg.h"
+#include "regalloc.h"
+
+/*
+ * Register allocation by graph coloring; see regalloc.h
+ */
+
+unsigned long long HERA_registers_written(const HERA_insns &code)
+{
+	unsigned long long written = 0;
+	for (const HERA_insn &insn : code)
+		for (unsigned j = 0; j < insn.args.size(); j++) {
+			HERA_operand_role role = HERA_role(insn, j);
+			int r = HERA_register_number(insn.args[j]);
+			if ((role == HERA_def || role == HERA_use_def) && r < 64)
+				written |= 1ull << r;
+		}
+	return written;
+}
+
+static int registers_for(const IR_function &f)
+{
+	return f.is_main() ? HERA_allocatable_registers : std::min(f.save_slots, HERA_allocatable_registers);
+}
+
+int home_past_registers(const IR_function &f)
+{
+	return registers_for(f) + 1;
+}
+
+bool all_get_registers(const IR_function &f, const std::vector<int> &temporaries)
+{
+	register_assignment picked;
+	allocate_registers(f, &picked);
+	if (picked.back_home) return false;
+	for (int t : temporaries)
+		if (picked.registers[t] == 0) return false;
+	for (int t = 0; t < f.temporaries(); t++)  // and the ones earlier passes added still do
+		if (f.temporary_home[t] >= home_past_registers(f) && picked.registers[t] == 0) return false;
+	return true;
+}
+
+HERA_insns allocate_registers(const IR_function &f, register_assignment *picked)
+{
+	const HERA_insns &code = f.code;
+	int n = code.size();
+	int nt = f.temporaries();
+	int K, slot_base;  // temporary t can be spilled to FP+(slot_base+home[t]), if its home is more than K
+	K = registers_for(f);
+	if (f.is_main())
+		slot_base = -(HERA_allocatable_registers+1);  // main's spill slots are the first things in its frame
+	else
+		slot_base = 2 + f.params;  // the save slots, after the params
+	const std::vector<int> &home = f.temporary_home;
+	std::vector<std::vector<int>> temporary(n);  // temporary number of each operand, or -1
+	for (int i = 0; i < n; i++)
+		for (const HERA_operand &a : code[i].args)
+			temporary[i].push_back(HERA_temporary_number(a));
+
+	// 1. interference, found by walking backwards through each block
+	HERA_liveness liveness = HERA_find_liveness(code, f.cfg, nt, HERA_temporary_number);
+	std::vector<std::vector<int>> neighbors(nt), move_partners(nt);
+	for (int b = 0; b < f.cfg.count(); b++) {
+		HERA_variable_set live = liveness.live_out[b];
+		for (int i = f.cfg.first[b+1] - 1; i >= f.cfg.first[b]; i--) {
+			const HERA_insn &insn = code[i];
+			int move_source = -1;
+			if (insn.op == HERA_MOVE && temporary[i][0] >= 0 && temporary[i][1] >= 0) {
+				move_source = temporary[i][1];
+				move_partners[temporary[i][0]].push_back(move_source);
+				move_partners[move_source].push_back(temporary[i][0]);
+			}
+			for (unsigned j = 0; j < insn.args.size(); j++) {
+				HERA_operand_role role = HERA_role(insn, j);
+				int t = temporary[i][j];
+				if (t < 0 || (role != HERA_def && role != HERA_use_def)) continue;
+				for (int s = 0; s < nt; s++)
+					if (live[s] && s != t && s != move_source) {
+						neighbors[t].push_back(s);
+						neighbors[s].push_back(t);
+					}
+			}
+			for (unsigned j = 0; j < insn.args.size(); j++)
+				if (temporary[i][j] >= 0 && HERA_role(insn, j) == HERA_def) live[temporary[i][j]] = false;
+			for (unsigned j = 0; j < insn.args.size(); j++) {
+				HERA_operand_role role = HERA_role(insn, j);
+				if (temporary[i][j] >= 0 && (role == HERA_use || role == HERA_use_def)) live[temporary[i][j]] = true;
+			}
+		}
+	}
+	for (auto &ns : neighbors) {
+		std::sort(ns.begin(), ns.end());
+		ns.erase(std::unique(ns.begin(), ns.end()), ns.end());
+	}
+
+	// 2. color: simplify (take out temporaries with fewer than K neighbors left, or if there are none,
+	//    the one we'd most like to spill), then select in the reverse order
+	std::vector<int> degree(nt), order;
+	std::vector<bool> removed(nt, false);
+	std::deque<int> easy;
+	for (int t = 0; t < nt; t++) {
+		degree[t] = neighbors[t].size();
+		if (degree[t] < K) easy.push_back(t);
+	}
+	auto take_out = [&](int t) {
+		removed[t] = true;
+		order.push_back(t);
+		for (int other : neighbors[t])
+			if (!removed[other] && --degree[other] == K - 1)
+				easy.push_back(other);
+	};
+	while (int(order.size()) < nt) {
+		if (!easy.empty()) {
+			int t = easy.front();
+			easy.pop_front();
+			if (!removed[t]) take_out(t);
+		} else {
+			int pick = -1;
+			for (int t = 0; t < nt; t++)
+				if (!removed[t] && (pick < 0 ||
+				                    (home[t] > K) > (home[pick] > K) ||
+				                    ((home[t] > K) == (home[pick] > K) && degree[t] > degree[pick])))
+					pick = t;
+			take_out(pick);
+		}
+	}
+
+	std::vector<int> color(nt, 0);  // 0 for spilled
+	bool back_home = false;
+	for (int k = nt - 1; k >= 0; k--) {
+		int t = order[k];
+		std::vector<bool> taken(K + 1, false);
+		for (int other : neighbors[t])
+			if (color[other]) taken[color[other]] = true;
+		for (int partner : move_partners[t])
+			if (color[partner] && !taken[color[partner]]) {
+				color[t] = color[partner];
+				break;
+			}
+		for (int r = 1; r <= K && !color[t]; r++)
+			if (!taken[r]) color[t] = r;
+		if (!color[t] && home[t] <= K) back_home = true;
+	}
+	if (back_home)
+		for (int t = 0; t < nt; t++)
+			color[t] = home[t] <= K ? home[t] : 0;
+	if (picked) {
+		picked->registers = color;
+		picked->back_home = back_home;
+	}
+
+	// 3. rewrite the code with the registers, and spill code
+	HERA_insns result;
+	result.reserve(n);
+	for (int i = 0; i < n; i++) {
+		HERA_insn insn = code[i];
+		std::vector<HERA_operand> scratch_left;
+		for (const HERA_operand &s : {HERA_Rt, HERA_PC_ret})
+			if (std::find(insn.args.begin(), insn.args.end(), s) == insn.args.end())
+				scratch_left.push_back(s);
+		std::vector<std::pair<int, HERA_operand>> scratch_for;  // (temporary, scratch register)
+		HERA_insns before, after;
+		for (int defs = 0; defs < 2; defs++)  // the uses first, so a def can share their scratch registers
+		for (unsigned j = 0; j < insn.args.size(); j++) {
+			int t = temporary[i][j];
+			HERA_operand_role role = HERA_role(code[i], j);
+			if (t < 0 || (role == HERA_def) != (defs == 1)) continue;
+			if (color[t]) {
+				insn.args[j] = HERA_register(color[t]);
+				continue;
+			}
+			auto already = std::find_if(scratch_for.begin(), scratch_for.end(), [t](auto &p) { return p.first == t; });
+			HERA_operand scratch;
+			if (already != scratch_for.end()) {
+				scratch = already->second;
+			} else if (!scratch_left.empty()) {
+				scratch = scratch_left.front();
+				scratch_left.erase(scratch_left.begin());
+				scratch_for.push_back({t, scratch});
+			} else if (role == HERA_def && !scratch_for.empty()) {
+				scratch = scratch_for.front().second;  // the uses are read before this is written
+			} else {
+				EM_error("Register allocation ran out of scratch registers for spilling", true);
+			}
+			HERA_operand slot = HERA_number(slot_base + home[t]);
+			if (role == HERA_use || role == HERA_use_def)
+				before.push_back(HERA_insn(HERA_LOAD, {scratch, slot, HERA_FP}));
+			if (role == HERA_def || role == HERA_use_def)
+				after.push_back(HERA_insn(HERA_STORE, {scratch, slot, HERA_FP}));
+			insn.args[j] = scratch;
+		}
+		result.insert(result.end(), before.begin(), before.end());
+		result.push_back(insn);
+		result.insert(result.end(), after.begin(), after.end());
+	}
+	return result;
+}
@@ -0,0 +1,46 @@
+#if ! defined REGALLOC_H
+#define REGALLOC_H
+
+#include "IR.h"
+
+// Register allocation for the code of one function body (or the main program).
+//
+// HERA_code picks registers with the result_reg numbering, which is simple but gives every
+//  subexpression "its" register, so e.g. a function body whose result_reg is 6 writes R1...R6
+//  and has to save all six, even if only two values are ever live at once.
+//  The IR has a temporary for each value instead (see IR.h), and allocate_registers
+//  picks registers for them all at once:
+//
+//   1. two temporaries "interfere" if one is defined while the other is live,
+//   2. the temporaries are colored with R1 ... R10 (or, in a function, as many of those as it has
+//      slots to save them in), by Chaitin/Briggs simplify and select, lowest register first,
+//      and trying to give both sides of a MOVE the same register,
+//   3. anything that doesn't get a register is "spilled" to its slot in the frame (see below),
+//      and loaded into Rt or PC_ret just before each use (and stored just after each definition);
+//      neither of those holds anything between instructions within a body.
+//
+// Temporaries whose home is beyond R10 ("R11" and up, for enormous expressions) can only be
+//  spilled, to a frame slot reserved for their home register (see layout_frames.cpp).
+//  If a temporary from R1..R10 doesn't get a register (which can happen since the coloring is
+//  a heuristic), we put every temporary back in its home register, which always works.
+
+// What allocate_registers picked, for passes that need to know it worked out (see all_get_registers):
+//  the register for each temporary (0 if it was spilled), and whether it had to put them all back home
+struct register_assignment {
+	std::vector<int> registers;
+	bool back_home = false;
+};
+
+HERA_insns allocate_registers(const IR_function &f, register_assignment *picked = 0);  // returns the code on registers
+
+// For passes that add temporaries to f and keep the change only if those all get registers:
+//  a home for a new temporary that it couldn't safely go back to (past the registers f can use,
+//  and there's no frame slot for it, so it has to get a register), and whether the new ones all get
+//  registers, along with any such temporaries already in f, without putting everything back home
+int home_past_registers(const IR_function &f);
+bool all_get_registers(const IR_function &f, const std::vector<int> &temporaries);
+
+// Which registers are written by "code", as a bit mask (1<<n for Rn), e.g. for saving them in a function
+unsigned long long HERA_registers_written(const HERA_insns &code);
+
+#endif
@@ -5,14 +5,30 @@
  */
 
 
-static int next_unique_number = 1;
-static int next_unique_string_number = 0;
-static int next_unique_while_number = 0;
-static int next_unique_if_arith_number = 0;
-static int next_unique_if_cond_number = 0;
-static int next_unique_for_number = 0;
-static int next_unique_skip_func_number = 0;
-static int next_unique_let_num = 0;
+// These counters are per-thread, so threads compiling different programs don't interfere
+static thread_local int next_unique_number = 1;
+static thread_local int next_unique_string_number = 0;
+static thread_local int next_unique_while_number = 0;
+static thread_local int next_unique_if_arith_number = 0;
+static thread_local int next_unique_if_cond_number = 0;
+static thread_local int next_unique_for_number = 0;
+static thread_local int next_unique_skip_func_number = 0;
+static thread_local int next_unique_let_num = 0;
+static thread_local int next_unique_call_number = 0;
+
+// start all the numbering above over again, for a new program (see compile.cpp)
+void reset_unique_numbers()
+{
+    next_unique_number = 1;
+    next_unique_string_number = 0;
+    next_unique_while_number = 0;
+    next_unique_if_arith_number = 0;
+    next_unique_if_cond_number = 0;
+    next_unique_for_number = 0;
+    next_unique_skip_func_number = 0;
+    next_unique_let_num = 0;
+    next_unique_call_number = 0;
+}
 
 //int AST_node_::fp_plus_for_me(A_exp which_child) {
 //    return which_child->regular_fp_plus();
@@ -22,18 +38,6 @@ int A_exp_::init_result_reg()  // generate unique numbers, starting from 1, each
     EM_error("Using old reg method. Please update.", false);
 	return 1;
 }
-int A_exp_::init_regular_fp_plus() {
-    if (this->stored_result_fp_plus > -1){
-        return this->stored_result_fp_plus;
-    } else {
-        return this->parent()->regular_fp_plus();
-    }
-}
-
-int AST_node_::init_result_fp_plus() {
-        return this->parent()->result_fp_plus();
-}
-
 int A_exp_::init_result_fp_plus() {
     int for_me = this->parent()->fp_plus_for_me(this);
 
@@ -209,8 +213,9 @@ int A_arithExp_::init_result_reg()  // generate unique numbers, starting from 1,
 int A_condExp_::init_result_reg()  // generate unique numbers, starting from 1, each time this is called
 {
     // for those who've taken CS355/356, this should be an atomic transaction, in a concurrent environment
-    if (_left->result_reg() == _right->result_reg()) return _left->result_reg()+1;
-    return std::max(_left->result_reg(), _right->result_reg());
+    int reg = _left->result_reg() == _right->result_reg() ? _left->result_reg()+1 : std::max(_left->result_reg(), _right->result_reg());
+    if (this->might_compare_strings()) return std::max(reg, 5);  // the strings, and three to compare them with (see HERA_code.cpp)
+    return reg;
 }
 
 //posible extra regs
@@ -312,7 +317,7 @@ string A_fundec_::init_label_skip(){
     return my_string;
 }
 
-int A_condExp_::init_labels()
+int A_condExp_::init_label_number()
 {
     int my_number = next_unique_if_cond_number;
     next_unique_if_cond_number = my_number + 1;
@@ -335,21 +340,28 @@ int A_varExp_::init_result_reg() {
 
 }
 
-int A_ifExp_::init_if_labels()
+int A_callExp_::init_label_number()
+{
+    int my_number = next_unique_call_number;
+    next_unique_call_number = my_number + 1;
+    return next_unique_call_number;
+}
+
+int A_ifExp_::init_label_number()
 {
     int my_number = next_unique_if_arith_number;
     next_unique_if_arith_number = my_number + 1;
     return next_unique_if_arith_number;
 }
 
-int A_whileExp_::init_labels()
+int A_whileExp_::init_label_number()
 {
     int my_number = next_unique_while_number;
     next_unique_while_number = my_number + 1;
     return next_unique_while_number;
 }
 
-int A_forExp_::init_labels()
+int A_forExp_::init_label_number()
 {
     int my_number = next_unique_for_number;
     next_unique_for_number = my_number + 1;
@@ -386,11 +398,12 @@ int A_simpleVar_::init_result_reg() {
     return 1;
 }
 
-int A_simpleVar_::get_offest() {
-    if(stored_offest == -1){
-        stored_offest = this->find_local_variables_fp(_sym, this->result_fp_plus());
-    }
-    return stored_offest;
+variable_binding A_simpleVar_::init_binding() {
+    return this->resolve_variable(_sym, this->result_fp_plus());
+}
+
+function_binding A_callExp_::init_binding() {
+    return this->resolve_function(_func);
 }
 
 local_variable_scope A_forExp_::init_local_variable(){
@@ -484,13 +497,8 @@ HaverfordCS::list<Ty_ty> A_fundec_::type_field_list(){
 }
 
 int A_fundec_::fp_plus_for_me(A_exp which_child) {
-    if (which_child == _body && _params != 0){
-        if (head(this->type_field_list()) == Ty_Void()) return _params->get_bottom_fp();
-        return _params->get_bottom_fp()+length(this->type_field_list());
-    } else {
-        if (head(this->type_field_list()) == Ty_Void()) return this->result_fp_plus();
-        return this->result_fp_plus()+length(this->type_field_list());
-    }
+    // the body's variables go after the parameters and the saved registers (see layout_frames.cpp)
+    return 2 + this->argument_slots() + this->saved_register_slots();
 }
 
 Ty_ty A_letExp_::implicit_type_init(Symbol name) {
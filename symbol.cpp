@@ -0,0 +1,77 @@
+/*
+ * The pool of interned Symbols (see symbol.h)
+ *
+ *  Symbol_ records are handed out of fixed-size chunks, so they never move once created
+ *  (the index below holds string_views into them). Nothing is ever freed.
+ */
+
+#include <new>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+#include "symbol.h"
+
+namespace {
+
+class Symbol_pool {
+public:
+	// Several threads may be compiling at once (tiger --batch -j), so lookups share a lock,
+	//  and only adding a new name needs the lock to itself.
+	Symbol intern(std::string_view s)
+	{
+		{
+			std::shared_lock<std::shared_mutex> reading(lock);
+			auto found = index.find(s);
+			if (found != index.end()) {
+				return found->second;
+			}
+		}
+		std::unique_lock<std::shared_mutex> writing(lock);
+		auto found = index.find(s);  // check again, in case another thread just added it
+		if (found != index.end()) {
+			return found->second;
+		}
+		Symbol_ *fresh = allocate(s, std::hash<std::string_view>{}(s));
+		index.emplace(std::string_view(fresh->name), fresh);
+		return fresh;
+	}
+	unsigned long size() const { std::shared_lock<std::shared_mutex> reading(lock); return index.size(); }
+
+private:
+	static const int chunk_size = 1024;  // Symbol_ records per chunk
+
+	Symbol_ *allocate(std::string_view s, size_t hash)
+	{
+		if (chunks.empty() || used_in_last_chunk == chunk_size) {
+			chunks.push_back(static_cast<Symbol_ *>(::operator new(chunk_size * sizeof(Symbol_))));
+			used_in_last_chunk = 0;
+		}
+		return new (chunks.back() + used_in_last_chunk++) Symbol_(s, hash);
+	}
+
+	std::vector<Symbol_ *> chunks;  // never freed; the pool lives until exit
+	int used_in_last_chunk = 0;
+	std::unordered_map<std::string_view, Symbol> index;
+	mutable std::shared_mutex lock;
+};
+
+// a function-local static, so it's ready even for Symbols created during static initialization
+//  (e.g. the standard library table in AST.cpp)
+Symbol_pool &the_pool()
+{
+	static Symbol_pool pool;
+	return pool;
+}
+
+}
+
+Symbol intern_Symbol(std::string_view s)
+{
+	return the_pool().intern(s);
+}
+
+unsigned long number_of_interned_Symbols()
+{
+	return the_pool().size();
+}
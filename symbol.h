@@ -1,36 +1,53 @@
 #if ! defined _SYMBOL_H
 #define _SYMBOL_H
 
+#include <string_view>
 #include "util.h"
 
-// this leaks memory all over the place,
-//   but avoids problems with calling constructor/destructor in unions
-//   in types.h and lexical scanner
+// Symbols are interned: every spelling is stored exactly once, in a pool (see symbol.cpp)
+//   that lives for the whole run and is never freed, so a Symbol is just a pointer
+//   into that pool. Two Symbols are equal iff they are the same pointer, and the
+//   hash of the name is computed once, when the name is first interned.
+// Note that Symbol is still a plain pointer, to avoid problems with calling
+//   constructor/destructor in unions in types.h and lexical scanner
 
-typedef const string *Symbol;
+struct Symbol_ {
+	Symbol_(std::string_view the_name, size_t the_hash) : name(the_name), hash(the_hash) {}
+	const string name;
+	const size_t hash;
+};
 
+typedef const Symbol_ *Symbol;
+
+Symbol intern_Symbol(std::string_view s);  // in symbol.cpp
+unsigned long number_of_interned_Symbols();
 
 static inline Symbol to_Symbol(const string &s)
 {
-	return new string(s);
+	return intern_Symbol(s);
 }
 
 static inline Symbol to_Symbol(const char *s)
 {
 	precondition(s != 0);
-	return new string(s);
+	return intern_Symbol(s);
 }
 
 static inline String Symbol_to_string(Symbol sym)
 {
-	return *sym;
+	return sym->name;
 }
 static inline String str(Symbol sym) { return Symbol_to_string(sym); }
 static inline String repr(Symbol sym) { return "to_Symbol(" + repr(Symbol_to_string(sym)) + ")"; }
 
+static inline size_t Symbol_hash(Symbol sym)
+{
+	return sym->hash;
+}
+
 static inline bool Symbols_are_equal(Symbol s1, Symbol s2)
 {
-	return Symbol_to_string(s1) == Symbol_to_string(s2);
+	return s1 == s2;  // interned, so same name <=> same pointer
 }
 
 #endif
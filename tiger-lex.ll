@@ -15,12 +15,10 @@
 
 
 
-// next line from https://www.gnu.org/software/bison/manual/html_node/Calc_002b_002b-Scanner.html#Calc_002b_002b-Scanner
-static yy::location loc;
-
-// allows to keep track of nested comments
-int comment_nesting = 0;
-std::string string_input = "";
+// The scanner is reentrant, so that several files can be scanned at once (in different threads);
+//  its state that used to be global here ("loc" for the current position, "comment_nesting"
+//  to keep track of nested comments, and "string_input" for the string being scanned)
+//  is now in the tigerParseDriver --- see the start of the rules section below.
 
 // The function below is somewhat overly verbose;
 //  it is designed to serve as an example of
@@ -111,25 +109,6 @@ static Ty_ty textToType(std::string the_text)
     }
 }
 
-// This uses some stuff created by flex, so it's easiest to just put it here.
-int tigerParseDriver::parse (const std::string &f)
-{
-	fileName = f;
-
-	if (fileName == "" || fileName == "-") {
-		yyin = stdin;
-	} else if (!(yyin = fopen (fileName.c_str (), "r"))) {
-		error ("cannot open " + fileName + ".");
-		exit (EXIT_FAILURE);
-	}
-
-	yy::tigerParser parser (*this);
-	int res = parser.parse ();  // sets this->AST_root
-
-	fclose (yyin);
-	return res;
-}
-
 %}
 
 /* In this second section of the lex file (after the %}),
@@ -139,6 +118,8 @@ int tigerParseDriver::parse (const std::string &f)
 
 /* options from the example */
 %option noyywrap nounput
+/* one scanner per tigerParseDriver, rather than one global one; see YY_DECL in tigerParseDriver.h */
+%option reentrant
 /* Not using these: batch debug noinput */
 
 
@@ -192,6 +173,9 @@ string \"(.|\s)+?\"
 /* Surrounding four lines, and other things involving "loc", are from
    https://www.gnu.org/software/bison/manual/html_node/Calc_002b_002b-Scanner.html#Calc_002b_002b-Scanner */
   // Code run each time yylex is called.
+  yy::location &loc = driver.loc;  // this scanner's state, kept in its driver
+  int &comment_nesting = driver.comment_nesting;
+  std::string &string_input = driver.string_input;
   loc.step();
 %}
 
@@ -285,3 +269,42 @@ function { return yy::tigerParser::make_FUNCTION(loc); }
 
 .	{ string it = "?"; it[0] = yytext[0]; EM_error("illegal token: " + it); }
 %%
+
+/* In this third section, code that needs the scanner's own definitions, such as yylex_init */
+
+// The parser calls yylex(driver); send that to the scanner that belongs to that driver
+yy::tigerParser::symbol_type yylex(tigerParseDriver &driver)
+{
+	return tiger_scan(driver, driver.scanner);
+}
+
+// This uses some stuff created by flex, so it's easiest to just put it here.
+int tigerParseDriver::parse (const std::string &f)
+{
+	fileName = f;
+
+	FILE *input;
+	if (fileName == "" || fileName == "-") {
+		input = stdin;
+	} else if (!(input = fopen (fileName.c_str (), "r"))) {
+		EM_error("cannot open " + fileName + ".", true);  // fatal
+	}
+	yylex_init(&scanner);
+	yyset_in(input, scanner);
+
+	yy::tigerParser parser (*this);
+	int res;
+	try {
+		res = parser.parse ();  // sets this->AST_root
+	} catch (const EM_fatal_error &) {
+		if (input != stdin) fclose (input);
+		yylex_destroy(scanner);
+		scanner = 0;
+		throw;
+	}
+
+	if (input != stdin) fclose (input);
+	yylex_destroy(scanner);
+	scanner = 0;
+	return res;
+}
@@ -1,6 +1,8 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 
 using std::cout;
 using std::cerr;
@@ -11,6 +13,8 @@ using std::endl;
 #include "ST.h"  /* to run ST_test */
 #include "tigerParseDriver.h"
 #include "typecheck.h"
+#include "compile.h"
+#include "phases.h"
 
 /* Turned this off while having trouble switching to C++ approach; this used to work in C version */
 #if defined COMPILE_LEX_TEST
@@ -108,33 +112,90 @@ void lex_test()
 int main(int argc, char **argv)
 {
   try {
-	bool debug = false, show_ast = false, crash_on_fatal;
+	compile_options options;
 #if defined COMPILE_LEX_TEST
 	bool just_do_lex_and_then_stop = false;
 #endif
 	String filename;
-	int arg_consumed = 0;
-  
-	if (argc>arg_consumed+1 && string(argv[1]).length()>= 2 && (argv[1][0] == '-' && argv[1][1] == 'd')) { // Debug option
-		arg_consumed++;
-		debug = true;
-		if (string(argv[1]).length()>= 3 && argv[1][2] == 'a')
-			show_ast = true;
-		else if (string(argv[1]).length()>= 3 && argv[1][2] == 'A')
-			print_ASTs_with_attributes = show_ast = true;
-		else if (string(argv[1]).length()>= 3 && argv[1][2] == 'c')
-			crash_on_fatal = true;
+	bool batch = false, server = false;
+
+	// The options come first, in any order, up to the first argument that isn't one (the file name,
+	//  or for --batch, the first of the files); "-" alone is a file name, for standard input
+	int arg = 1;
+	for (; arg < argc && argv[arg][0] == '-' && argv[arg][1] != 0; arg++) {
+		string option = argv[arg];
+		if (option == "--st-benchmark") { // compare the symbol table implementations, then stop
+			ST_benchmark();
+			return 0;
+		} else if (option == "--bench") { // tiger --bench [--update] [baseline file]
+			bool update = arg+1 < argc && string(argv[arg+1]) == "--update";
+			int file_arg = update ? arg+2 : arg+1;
+			return tiger_benchmark(file_arg < argc ? argv[file_arg] : "bench-baseline.txt", update);
+		} else if (option[1] == 'd') { // Debug option
+			options.debug = true;
+			if (option.length()>= 3 && option[2] == 'a')
+				options.show_ast = true;
+			else if (option.length()>= 3 && option[2] == 'A')
+				print_ASTs_with_attributes = options.show_ast = true;
+			else if (option.length()>= 3 && option[2] == 'c')
+				options.crash_on_fatal = true;
+			else if (option.length()>= 3 && option[2] == 'i')
+				options.show_ir = true;
+			else if (option.length()>= 3 && option[2] == 'p')
+				options.peephole_report = true;
+			else if (option.length()>= 3 && option[2] == 't')
+				options.trace_attributes = true;
 #if defined COMPILE_LEX_TEST
-		else if (string(argv[1]).length()>= 3 && argv[1][2] == 'l')
-			just_do_lex_and_then_stop = true;
+			else if (option.length()>= 3 && option[2] == 'l')
+				just_do_lex_and_then_stop = true;
 #endif
+		} else if (option == "--time-phases" || option == "--time-phases=json") {
+			// report on each phase of compiling each program
+			options.time_phases = option == "--time-phases" ? "text" : "json";
+		} else if (option == "--cost-report") {
+			// report what the code for each function and line of the program will cost
+			options.cost_report = true;
+		} else if (option == "--run" || option == "--interpret" || option == "--profile") {
+			// run the program (as x86-64 code, if it can), rather than printing its code;
+			//  --interpret always uses the HERA interpreter, and --profile also reports
+			//  where it spent its time (any of them also runs a .hera file)
+			options.run = option.substr(2);
+		} else if (option == "--static-links=cached" || option == "--static-links=walk") {
+			// have each function follow the static links to the outer frames it uses just once,
+			//  when it's called, rather than at each use (--static-links=walk, the default)
+			options.cache_static_links = option == "--static-links=cached";
+		} else if (option == "--cache-dir" && arg+1 < argc) {
+			// keep the code for each group of functions in DIR, to reuse next time
+			options.cache_dir = argv[++arg];
+		} else if (option == "--HERA-main" && arg+1 < argc) {
+			// also write the code as the HERA_main function of a HERA_main.cc, for HERA-C
+			options.HERA_main_file = argv[++arg];
+		} else if (option == "--batch" || option == "--server") {
+			// Many programs in one run, each to its own .hera file:
+			//   tiger --batch f1.tig f2.tig ...
+			//   tiger --batch -j 8 f1.tig f2.tig ...   (compile 8 at a time)
+			//   tiger --server     (then give it one file name per line on standard input)
+			batch = option == "--batch";
+			server = option == "--server";
+		} else if (option == "-j" && arg+1 < argc) { // tiger --batch -j 8 ..., or -j 0 for one per processor
+			options.jobs = atoi(argv[++arg]);
+		} else {
+			cerr << "Unknown option " << option << " (or it needs an argument after it)" << endl;
+			return 1;
+		}
 	}
 
+	if (batch || server) {
+		ST_test();  // internal consistency check, just once
+		if (server)
+			return compile_tiger_server(std::cin, cout, options);
+		std::vector<String> filenames(argv+arg, argv+argc);
+		return compile_tiger_batch(filenames, options);
+	}
 
-	if (argc>arg_consumed+1)
+	if (arg < argc)
 	{
-		arg_consumed++;
-		filename = argv[arg_consumed];
+		filename = argv[arg];
 	}
 	else
 	{
@@ -145,54 +206,59 @@ int main(int argc, char **argv)
 		filename = buf;
 	}
 
-	// open "filename" for reading by lexical scanner,
-	// give up after 8 errors,
-	// with compiler debugging ON if the "-d" flag was used when we started
-	EM_reset(filename, 8, debug, crash_on_fatal);
-
 	ST_test();  // internal consistency check
 
 #if defined COMPILE_LEX_TEST
 	if (just_do_lex_and_then_stop) {
+		EM_reset(filename, 8, options.debug, options.crash_on_fatal);
 		lex_test();
 		return 0;
 	} else
 #endif
 	{
-		tigerParseDriver driver;
-		int result = driver.parse(filename);
-		if (!EM_recorded_any_errors()) {
-			if (result != 0) {
-				EM_error("Strange result in tiger.cc: parser failed but EM module reported no errors",
-					 true, Position::undefined()); // true = fatal error
+		HERA_emitter code;
+		phase_timer phases;
+		if (options.time_phases != "") phase_timer::set_current(&phases);
+		if (options.run != "") {
+			int result = 0;
+			bool is_HERA = filename.length() > 5 && filename.substr(filename.length() - 5) == ".hera";
+			if (is_HERA) {
+				std::ifstream in(filename);
+				std::stringstream text;
+				text << in.rdbuf();
+				if (!in) {
+					cerr << "Could not read " << filename << endl;
+					return 1;
+				}
+				code << text.str();
+			} else {
+				result = compile_tiger_program(filename, code, options);
 			}
+			phase_start("run");
+			if (result == 0) result = run_HERA_program(code, is_HERA ? filename : HERA_file_name_for(filename), options);
+			report_phases(phases, filename, options);
+			return result;
+		}
+		int result = compile_tiger_program(filename, code, options);
+		phase_start("write");
+		if (result == 0) {
+			code.write_to(cout);
+			if (options.HERA_main_file != "") {
+				std::ofstream outfile(options.HERA_main_file);
 
-			EM_debug("Parsing Successful", driver.AST->pos());
-
-
-			// Could do static checks, e.g. type checking, here if we want to do them all before any code generation
-
-			if (show_ast) cerr << "Printing AST due to -da or -dA flag:" << endl << repr(driver.AST) << endl;
-
-			if (! EM_recorded_any_errors()) {
-                driver.AST->typecheck();
-				String code = driver.AST->HERA_code() + "\n\nHALT()\n#include \"Tiger-stdlib-stack.hera\"\n";
-				if (! EM_recorded_any_errors()) {
-					cout << code;
-                    std::ofstream outfile;
-                    outfile.open("/Users/john/Documents/haverford/classes/Archive/Comp/Algorithms-HERA/HERA_main.cc");
-
-                    // Write to the file
-                    outfile << "#include <HERA.h>\n #include <HERA-print.h>\n\n void HERA_main()\n {\n" << code << "\n}";
+				// Write to the file
+				outfile << "#include <HERA.h>\n #include <HERA-print.h>\n\n void HERA_main()\n {\n";
+				code.write_to(outfile);
+				outfile << "\n}";
 
-                    // Close the file
-                    outfile.close();
-					return 0; // no errors
+				if (!outfile) {
+					cerr << "Could not write " << options.HERA_main_file << endl;
+					result = 1;
 				}
 			}
 		}
-		EM_warning("Not generating HERA code due to above errors.");
-		return EM_recorded_any_errors(); // got errors somewhere, or would have returned 0 above
+		report_phases(phases, filename, options);
+		return result;
 	}
 
   } catch (const char *message) {
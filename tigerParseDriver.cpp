@@ -3,8 +3,16 @@
 
 #include "tigerParseDriver.h"
 
-tigerParseDriver::tigerParseDriver()
+tigerParseDriver::tigerParseDriver() : AST(0), scanner(0), comment_nesting(0), string_input("")
 {
+	previous_arena = ASTArena::current();
+	ASTArena::set_current(&arena);
+}
+
+tigerParseDriver::~tigerParseDriver()
+{
+	arena.release();
+	ASTArena::set_current(previous_arena);
 }
 
 #include <stdio.h>
@@ -14,11 +22,11 @@ tigerParseDriver::tigerParseDriver()
 void
 tigerParseDriver::error (const yy::location& l, const std::string& m)
 {
-	std::cerr << l << ": " << m << std::endl;
+	EM_output() << l << ": " << m << std::endl;
 }
 
 void
 tigerParseDriver::error (const std::string& m)
 {
-	std::cerr << m << std::endl;
+	EM_output() << m << std::endl;
 }
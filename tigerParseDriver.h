@@ -32,15 +32,26 @@ struct fieldListAttrs {
 
 #include "tiger-grammar.tab.hpp"
 
+// the type flex uses for a reentrant scanner, declared here the same way flex does
+#ifndef YY_TYPEDEF_YY_SCANNER_T
+#define YY_TYPEDEF_YY_SCANNER_T
+typedef void* yyscan_t;
+#endif
+
 
 // The tigerParseDriver class is closely based on the example from the documentation (i.e., copied and edited)
 // https://www.gnu.org/software/bison/manual/html_node/Calc_002b_002b-Parsing-Driver.html#Calc_002b_002b-Parsing-Driver
 class tigerParseDriver {
 public:
 	tigerParseDriver();
+	~tigerParseDriver();
 
 	A_root_ *AST;  // parsing will set this to the root of the AST, if it succeeds
 
+	// Everything in the AST (and the types made for it) is allocated here, from construction
+	//  of the driver until it is destroyed, at which point it's all released (so don't keep pointers into AST).
+	ASTArena arena;
+
 	// Run the parser on file f, return 0 on success.
 	int parse (const std::string& f);
 	// The name of the file being parsed.
@@ -50,13 +61,23 @@ public:
 	// Error handling.
 	void error (const yy::location& l, const std::string& m);
 	void error (const std::string& m);
+
+	// The state of this driver's (reentrant) lexical scanner; see tiger-lex.ll
+	yyscan_t scanner;
+	yy::location loc;
+	int comment_nesting;
+	std::string string_input;
+
+private:
+	ASTArena *previous_arena;
 };
 
 // Tell Flex the lexer's prototype ...
 # define YY_DECL \
-	yy::tigerParser::symbol_type yylex (tigerParseDriver &)
-// ... and declare it for the parser's sake.
+	yy::tigerParser::symbol_type tiger_scan (tigerParseDriver &driver, yyscan_t yyscanner)
+// ... and declare it, and the yylex that the parser calls, which uses driver.scanner
 YY_DECL;
+yy::tigerParser::symbol_type yylex (tigerParseDriver &driver);
 
 
 
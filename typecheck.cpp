@@ -28,38 +28,33 @@ void typecheck(AST_node_ *root)
 
 }
 
-Ty_ty AST_node_::typecheck()
+Ty_ty AST_node_::init_typecheck()
 {
     EM_warning("Using generic node method", false);
     return Ty_Error();
 }
 
-Ty_ty AST_node_::init_my_type(){
-    EM_warning("Error, my_type not implemented here", false);
-    return Ty_Error();
-}
-
-Ty_ty A_root_::typecheck()
+Ty_ty A_root_::init_typecheck()
 {
     return main_expr->typecheck();
 }
 
-Ty_ty A_intExp_::typecheck()
+Ty_ty A_intExp_::init_typecheck()
 {
     return Ty_Int();
 }
 
-Ty_ty A_stringExp_::typecheck()
+Ty_ty A_stringExp_::init_typecheck()
 {
     return Ty_String();
 }
 
-Ty_ty A_boolExp_::typecheck()
+Ty_ty A_boolExp_::init_typecheck()
 {
     return Ty_Bool();
 }
 
-Ty_ty A_expList_::typecheck()
+Ty_ty A_expList_::init_typecheck()
 {
     A_expList my_pointer = _tail;
     A_exp my_node = _head;
@@ -76,7 +71,7 @@ Ty_ty A_expList_::typecheck()
     return my_node->typecheck();
 }
 
-Ty_ty A_seqExp_::typecheck()
+Ty_ty A_seqExp_::init_typecheck()
 {
     A_expList my_pointer = _seq;
     A_exp my_node;
@@ -93,7 +88,7 @@ Ty_ty A_seqExp_::typecheck()
     return my_node->typecheck();
 }
 
-Ty_ty A_arithExp_::typecheck()
+Ty_ty A_arithExp_::init_typecheck()
 {
     if (_left->typecheck() != Ty_Int() || _right->typecheck() != Ty_Int()) {
         EM_error("Oops silly goose, math operation expects two INTs as parameter types", true);
@@ -103,7 +98,7 @@ Ty_ty A_arithExp_::typecheck()
     }
 }
 
-Ty_ty A_condExp_::typecheck()
+Ty_ty A_condExp_::init_typecheck()
 {
     // Fix inputs
     if (_right->typecheck() != _left->typecheck()) {
@@ -114,7 +109,7 @@ Ty_ty A_condExp_::typecheck()
     }
 }
 
-Ty_ty A_ifExp_::typecheck()
+Ty_ty A_ifExp_::init_typecheck()
 {
     Ty_ty my_type = Ty_Void();
     if (_test->typecheck() != Ty_Bool()) {
@@ -138,7 +133,7 @@ Ty_ty A_ifExp_::typecheck()
     }
 }
 
-Ty_ty A_whileExp_::typecheck() {
+Ty_ty A_whileExp_::init_typecheck() {
     if (_cond->typecheck() != Ty_Bool()){
         EM_error("Oops silly goose, while cond requires boolean", true);
         return Ty_Error();
@@ -147,10 +142,10 @@ Ty_ty A_whileExp_::typecheck() {
     return Ty_Void();
 }
 
-Ty_ty A_callExp_::typecheck()
+Ty_ty A_callExp_::init_typecheck()
 {
     try {
-        function_type_info my_func = this->find_local_functions(_func);
+        function_type_info my_func = this->binding().info;
 
         // check num of args
         int total_func_args = 0;
@@ -200,7 +195,7 @@ Ty_ty A_callExp_::typecheck()
     }
 }
 
-Ty_ty A_forExp_::typecheck() {
+Ty_ty A_forExp_::init_typecheck() {
 
     if (_hi->typecheck() != Ty_Int() || _lo->typecheck() != Ty_Int()){
         EM_error("Oops silly goose, for requires bounds to be type int", true);
@@ -213,29 +208,29 @@ Ty_ty A_forExp_::typecheck() {
 
 }
 
-Ty_ty A_varExp_::typecheck() {
+Ty_ty A_varExp_::init_typecheck() {
     return _var->typecheck();
 }
 
-Ty_ty A_simpleVar_::typecheck() {
-    Ty_ty my_type = this->find_local_variables(_sym).type;
+Ty_ty A_simpleVar_::init_typecheck() {
+    Ty_ty my_type = this->binding().info.type;
 
     if (my_type == Ty_Nil()) return this->implicit_type_init(_sym);
     return my_type;
 }
 
-Ty_ty A_functionDec_::typecheck() {
+Ty_ty A_functionDec_::init_typecheck() {
     return theFunctions->typecheck();
 }
 
-Ty_ty A_fundecList_::typecheck() {
+Ty_ty A_fundecList_::init_typecheck() {
     _head->typecheck();
 
     if (_tail != 0) return _tail->typecheck();
     return Ty_Void();
 }
 
-Ty_ty A_decList_::typecheck() {
+Ty_ty A_decList_::init_typecheck() {
 
     _head->typecheck();
 
@@ -243,19 +238,19 @@ Ty_ty A_decList_::typecheck() {
     return Ty_Void();
 }
 
-Ty_ty A_letExp_::typecheck(){
+Ty_ty A_letExp_::init_typecheck(){
     _decs->typecheck();
     return _body->typecheck();
 }
 
-Ty_ty A_varDec_::typecheck() {
+Ty_ty A_varDec_::init_typecheck() {
     Ty_ty my_type = _init->typecheck();
     if (from_String(str(_typ)) != my_type && from_String(str(_typ)) != Ty_Nil()) {EM_error("Oops silly goose, the declared type does not match variable type for "+str(_var), true); return Ty_Error();}
     if (from_String(str(_typ)) != my_type) _typ = to_Symbol(from_Type(my_type));
     return my_type;
 }
 
-Ty_ty A_assignExp_::typecheck() {
+Ty_ty A_assignExp_::init_typecheck() {
 
     if (str(this->my_for_loop()) == str(this->my_var_from_var())) {
         EM_error("Oops, you are not allowed to reassign the iterator variable", true);
@@ -264,7 +259,7 @@ Ty_ty A_assignExp_::typecheck() {
     return Ty_Void();
 }
 
-Ty_ty A_fundec_::typecheck() {
+Ty_ty A_fundec_::init_typecheck() {
     return Ty_Nil();
 }
 // The bodies of other type checking functions,
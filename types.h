@@ -9,6 +9,7 @@
  */
 
 #include "symbol.h"
+#include "ASTArena.h"
 
 /* These typedefs have to come first in C-style programming  */
 typedef struct Ty_ty_        *Ty_ty;
@@ -83,11 +84,24 @@ struct Ty_ty_ {
 
 	string __repr__();
 	string __str__()  { return this->__repr__(); }
+
+	// like AST nodes, types live in the current ASTArena, if there is one (none of these need destructors)
+	static void *operator new(size_t size) { return ASTArena::allocate_in_current(size); }
+	static void operator delete(void *p)   { ASTArena::deallocate(p); }
 };
 
-struct Ty_tyList_ {Ty_ty head; Ty_tyList tail; string __str__();};
-struct Ty_field_  {Symbol name; Ty_ty ty;};
-struct Ty_fieldList_ {Ty_field head; Ty_fieldList tail; string __str__();};
+struct Ty_tyList_ {Ty_ty head; Ty_tyList tail; string __str__();
+	static void *operator new(size_t size) { return ASTArena::allocate_in_current(size); }
+	static void operator delete(void *p)   { ASTArena::deallocate(p); }
+};
+struct Ty_field_  {Symbol name; Ty_ty ty;
+	static void *operator new(size_t size) { return ASTArena::allocate_in_current(size); }
+	static void operator delete(void *p)   { ASTArena::deallocate(p); }
+};
+struct Ty_fieldList_ {Ty_field head; Ty_fieldList tail; string __str__();
+	static void *operator new(size_t size) { return ASTArena::allocate_in_current(size); }
+	static void operator delete(void *p)   { ASTArena::deallocate(p); }
+};
 
 /* the following are like repr(), but allow a null pointer, which is important for lists */
 string to_String(Ty_ty t);